@@ -95,5 +95,25 @@ static inline int thread_state_asked( THREAD_STATE *state )
 	return state->_set;
 }
 
+//
+// thread events: a waiter takes the sequence before it checks its condition,
+// then waits until a signal moved it, so a signal in between is not lost
+//
+typedef struct THREAD_EVENT {
+	pthread_mutex_t	_mutex;
+	pthread_cond_t	_cond;
+	volatile unsigned _seq;
+} THREAD_EVENT;
+
+void thread_event_init( THREAD_EVENT *ev );
+void thread_event_destroy( THREAD_EVENT *ev );
+void thread_event_signal( THREAD_EVENT *ev );
+int  thread_event_wait( THREAD_EVENT *ev, unsigned seq, int timeout );
+
+static inline unsigned thread_event_seq( THREAD_EVENT *ev )
+{
+	return ev->_seq;
+}
+
 
 #endif
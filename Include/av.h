@@ -617,6 +617,7 @@ typedef struct _audio_props {
 					// 0 == no downmix
 	UINT64  codec_delay;
 	UINT64  seek_preroll;
+	void	*data_ref;		// AVBufferRef holding the data passed to decode(), NULL for a private copy
 } AUDIO_PROPERTIES;
 
 typedef struct _video_props {
@@ -798,6 +799,7 @@ typedef struct vfr_str {
 
 	int		index;		// for 4vl
 	struct vfr_str	*next;		// for queueing
+	unsigned	queued;		// FRAME_Q generation we are in, 0 if none
 	int		locked;
 	int		epoch;
 
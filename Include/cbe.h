@@ -23,6 +23,7 @@ typedef struct CBE
 	unsigned int 		size;
 	unsigned int 		overlap;
 	unsigned int		dma;
+	unsigned int		mirror;
 	volatile unsigned int	write;
 	volatile unsigned int	read;
 } CBE;
@@ -17,4 +17,6 @@
 #ifndef INCLUDE_CODEC_DEINTERLACING
 #define INCLUDE_CODEC_DEINTERLACING
 void RenderX( unsigned char *p_outpic, unsigned char *p_pic, int width, int height,  int dst_linesize, int src_linesize );
+// one 8 line band of RenderX(), p_outpic and p_pic point to the first line of the band
+void RenderXBand( unsigned char *p_outpic, unsigned char *p_pic, int width, int height, int band, int dst_linesize, int src_linesize );
 #endif
\ No newline at end of file
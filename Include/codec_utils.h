@@ -43,8 +43,21 @@ static inline int avimage2pixfmt(int avimage)
 	}
 }
 
+// per decoder scratch memory for the converters (deinterlace bands),
+// resize at open and on resolution change, it only grows
+typedef struct CODEC_SCRATCH {
+	unsigned char	*data;
+	int		size;
+} CODEC_SCRATCH;
+
+int  codec_scratch_resize( CODEC_SCRATCH *scratch, int width );
+void codec_scratch_free  ( CODEC_SCRATCH *scratch );
+
 int color_conversion_supported(int colorspace, int pixfmt);
 void codec_convert_pixel_format( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, VIDEO_FRAME *frame );
+void codec_convert_pixel_format2( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, VIDEO_FRAME *frame, CODEC_SCRATCH *scratch );
+// downscaling conversion into dst->window: YUV_422, BGRA_32, RGBX_32
+int  codec_convert_scaled( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, IMAGE *dst );
 
 void *codec_convert_mt_init( int work_num );
 void  codec_convert_mt     ( void *ctx, int pixfmt, unsigned char *data[], int linesize[], int width, int height, VIDEO_FRAME *frame );
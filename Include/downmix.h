@@ -31,9 +31,24 @@ enum {
 	CH_SR
 };
 
+// source sample formats for pcm_convert_S16(), bits as in downmix()
+enum {
+	PCM_FMT_NONE = 0,	// converts to silence
+	PCM_FMT_U8,		// taken as is, not centered
+	PCM_FMT_S16,
+	PCM_FMT_S24,
+	PCM_FMT_S32,
+	PCM_FMT_FLT,
+	PCM_FMT_DBL,
+};
+
+// stereo S16 out, the channels are summed as mapped by map
 void downmix             ( uint16_t *pcm, uint8_t *src,   int samples, int channels, int bits, int *map );
 void downmix_planar      ( uint16_t *pcm, uint8_t *src[], int samples, int channels, int bits, int *map );
 void downmix_float       ( uint16_t *pcm, uint8_t *src,   int samples, int channels, int bits, int *map );
 void downmix_float_planar( uint16_t *pcm, uint8_t *src[], int samples, int channels, int bits, int *map );
 
+// S16 with dst_channels interleaved, extra channels are silent
+void pcm_convert_S16( int16_t *dst, int dst_channels, uint8_t *src[], int planar, int samples, int channels, int fmt );
+
 #endif
@@ -23,6 +23,9 @@
 typedef struct FRAME_Q {
 	char tag[16];
 	VIDEO_FRAME *head;
+	VIDEO_FRAME *tail;
+	int count;
+	unsigned gen;	// new on every init and flush, frame->queued of the frames in here
 } FRAME_Q;
 
 int  frame_q_init ( FRAME_Q *q, char *tag );
@@ -29,6 +29,10 @@
 	#define CONFIG_NEON
 #endif
 
+#if ( defined( __x86_64__ ) || defined( __i386__ ) ) && defined( __GNUC__ )
+	#define CONFIG_X86_SIMD			// runtime dispatched SSE2/AVX2 pixel kernels
+#endif
+
 // ************************************************************************************************
 // SPECIAL Compilation options to be set or not
 //
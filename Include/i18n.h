@@ -28,7 +28,7 @@ int  I18N_codepage_to_unicode( const unsigned char *t, wchar *uc );
 void I18N_codepage_to_utf8( char *utf8, const char *cp, int max );
 
 void *I18N_check_encoding_init ( void );
-void I18N_check_encoding_update( void *ctx, const unsigned char *text, int size );
+int  I18N_check_encoding_update( void *ctx, const unsigned char *text, int size );
 void I18N_check_encoding_finish( void *ctx, int *utf8 );
 
 #endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MEDIA_CACHE_H_
+#define _MEDIA_CACHE_H_
+
+/*
+	on-disk cache of small blobs that describe a media file
+	(probe results, indexes...)
+
+	an entry is keyed by kind, path, size and mtime of the file,
+	it is silently dropped when the file changed.
+	only local paths can be cached, the rest always misses.
+
+	the entries live in a directory private to the user ($XDG_CACHE_HOME
+	or ~/.cache, /avos, 0700), entries that another user owns or could
+	write are ignored. the directory is kept under a size limit, the
+	least recently used entries are removed first.
+
+	media_cache_load() returns 0 on a hit, the data has to be afree()d.
+*/
+void media_cache_set_dir( const char *dir );
+int  media_cache_load   ( const char *kind, const char *path, void **data, int *size );
+int  media_cache_store  ( const char *kind, const char *path, const void *data, int size );
+void media_cache_remove ( const char *kind, const char *path );
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SLICE_POOL_H_
+#define _SLICE_POOL_H_
+
+/*
+	persistent worker pool for per line image work (pixel conversion,
+	deinterlacing, subtitle blending...)
+
+	slice_pool_run() cuts height lines into stripes of stripe lines,
+	the workers and the calling thread take stripes from a shared counter
+	until all are gone, it returns when every stripe is done.
+	func gets the first line and the line count of its stripe.
+	stripes are handed out in any order and on any thread.
+*/
+#define SLICE_POOL_MAX_WORKERS	16
+
+typedef void (*SLICE_FUNC)( void *arg, int start, int height );
+
+typedef struct SLICE_POOL SLICE_POOL;
+
+SLICE_POOL *slice_pool_init( int workers, const char *name );
+void        slice_pool_run ( SLICE_POOL *pool, SLICE_FUNC func, void *arg, int height, int stripe );
+int         slice_pool_exit( SLICE_POOL *pool );
+
+#endif
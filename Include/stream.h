@@ -35,6 +35,7 @@ struct STREAM;
 
 #include "stream_io.h"
 #include "stream_buffer.h"
+#include "stream_stats.h"
 
 #include <pthread.h>
 
@@ -148,6 +149,13 @@ typedef struct STREAM_CDATA
 	UINT64 		pos;
 	
 	AV_PROPERTIES	*changed;
+
+	// set when the parser lends its own chunk instead of copying it into the buffer passed in,
+	// release( ref ) once data is consumed
+	UCHAR		*data;
+	void		*ref;
+	void		(*release)( void *ref );
+	void		*data_ref;	// AVBufferRef holding data, see AUDIO_PROPERTIES
 } STREAM_CDATA;
 
 // forward declare CBE
@@ -534,6 +542,11 @@ typedef struct STREAM {
 	pthread_t 	audio_thread_handle;
 	THREAD_STATE	audio_tstate;
 	int		audio_yield;
+
+	THREAD_EVENT	chunk_event;	// the parser read a packet or reached the end
+	THREAD_EVENT	space_event;	// a chunk was taken out of the parser queues
+	THREAD_EVENT	sync_event;	// the audio or video sync time moved
+	THREAD_EVENT	frame_event;	// a sink gave a frame back or the decoder finished one
 	
 	VCODEC_CTRL	vcodec;
 
@@ -562,6 +575,7 @@ typedef struct STREAM {
 	int		audio_parse_end;	// parser has parsed complete file
 	int		video_parse_end;	// parser has parsed complete file
 	int		video_end;		// video is at the end of file
+	int		video_drain;		// 1: decoder gets empty chunks, 2: it has nothing left
 	int		stream_end;		// stream is at it's end
 	
 	STREAM_CHUNK_STORE aud;
@@ -657,6 +671,10 @@ typedef struct STREAM {
 	// current audio chunk size and read offset
 	int 		audio_buffer_size;
 	unsigned char 	*audio_buffer;
+	// parser owned chunk behind audio_buffer, see stream_audio_release()
+	void		*audio_ref;
+	void		(*audio_release)( void *ref );
+	void		*audio_data_ref;
 	
 	char 		*sub_url[SUB_TRACK_MAX + 1 + 1];  // current path in slot "0"
 	VIDEO_FRAME 	*subtitle_frame; 
@@ -714,6 +732,8 @@ typedef struct STREAM {
 	int 		fps_start;
 	int		fps_count;
 	void		*surface_handle;
+
+	STREAM_STATS	stats;
 } STREAM;
 
 #define STREAM_POS_MAX 1000
@@ -825,6 +845,7 @@ void    stream_set_start_time( STREAM *s, int time );
 void    stream_set_stop_time ( STREAM *s, int time );
 void    stream_set_video_sink( STREAM *s, STREAM_SINK_VIDEO *sink );
 void    stream_set_audio_sink( STREAM *s, STREAM_SINK_AUDIO *sink );
+void    stream_set_headless( int headless );
 STREAM_SINK_VIDEO *stream_get_video_sink( STREAM *s );
 STREAM_SINK_AUDIO *stream_get_audio_sink( STREAM *s );
 
@@ -858,6 +879,7 @@ void 	stream_show_rc( STREAM_RC *rc );
 void 	*stream_audio_dec_thread( void *data );
 
 void 	stream_audio_flush( STREAM *s );
+void 	stream_audio_release( STREAM *s );
 
 int	stream_sync_video( STREAM *s, int video_time );
 int	stream_sync_audio( STREAM *s, int audio_time );
@@ -877,6 +899,8 @@ int 	stream_abort( STREAM *s );
 void 	stream_CDATA_from_SC( STREAM_CDATA *cdata, STREAM_CHUNK *sc );
 void 	stream_yield( void );
 void 	stream_yield_RT( void );
+void 	stream_wait_event( THREAD_EVENT *ev, unsigned seq );
+void 	stream_frame_released( STREAM *s );
 int  	stream_add_chapter( STREAM *s, UINT64 start, UINT64 end, const char *title );
 void    stream_set_audio_name( AUDIO_PROPERTIES *audio, int track_num );
 void    stream_set_subtitle_name( SUB_PROPERTIES *subtitle, int track_num );
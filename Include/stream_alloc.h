@@ -39,6 +39,11 @@ void stream_free_dma_cached( unsigned char **ptr, size_t size );
 int stream_alloc_frames( VIDEO_FRAME *(*frames)[], int width, int height, int colorspace, int mem_type, int *count );
 int stream_free_frames ( VIDEO_FRAME *(*frames)[], int count );
 
+// frame_free() keeps the buffers for the next frame of the same size,
+// colorspace and mem_type, trim releases what has been idle too long
+void stream_frame_pool_trim ( void );
+void stream_frame_pool_flush( void );
+
 static inline int stream_get_mem_type( void ) 
 {
 	return STREAM_MEM_DMA;
@@ -31,6 +31,7 @@ struct STREAM;
 #define STREAM_BUFFER_NO_YIELD			0x10
 #define STREAM_BUFFER_MMAP			0x20
 #define STREAM_BUFFER_MMAP_FILE			0x40
+#define STREAM_BUFFER_MIRROR			0x80
 
 //
 // STREAM_BUFFER
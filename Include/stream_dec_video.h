@@ -71,6 +71,7 @@ typedef struct STREAM_DEC_VIDEO {
 	int		is_open;
 	int 		async;
 	int 		no_extra;
+	int		drain;		// takes empty chunks at the end and returns the frames it still holds
 	int		cpu;
 	void		*ctx;
 	void		*priv;
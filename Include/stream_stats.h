@@ -0,0 +1,104 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _STREAM_STATS_H_
+#define _STREAM_STATS_H_
+
+#include "types.h"
+
+struct STREAM;
+
+/*
+	always-on telemetry of one STREAM, also in release builds.
+
+	every stage and counter is written by one thread, the adds are atomic
+	so nothing ever takes a lock. readers take a snapshot, it may mix
+	values of two updates that happen at the same time.
+
+	times of the stages are in 1/10 ms, the unit of time_update_time(),
+	the histogram bucket i counts times below (1 << i) * 100us, the
+	last bucket everything above.
+*/
+
+enum {
+	STREAM_STAGE_PARSE,		// parser thread: read and demux
+	STREAM_STAGE_VDECODE,		// decoder thread: one video packet, with its convert
+	STREAM_STAGE_CONVERT,		// pixel format conversion into the frame
+	STREAM_STAGE_ADECODE,		// audio thread: one audio packet
+	STREAM_STAGE_SINK,		// player thread: hand a frame to the video sink
+	STREAM_STAGE_MAX
+};
+
+#define STREAM_STATS_BUCKETS	12	// 0.1ms .. 204.8ms
+
+typedef struct STREAM_STAGE_STATS {
+	UINT32		count;
+	UINT32		last;
+	UINT32		max;
+	UINT64		total;
+	UINT32		hist[STREAM_STATS_BUCKETS];
+} STREAM_STAGE_STATS;
+
+typedef struct STREAM_STATS {
+	int		start;		// atime() of stream_open
+
+	STREAM_STAGE_STATS stage[STREAM_STAGE_MAX];
+
+	// queue depths, sampled by the player thread
+	int		sample_time;
+	int		audio_chunks;	// packets waiting in the parser
+	int		video_chunks;
+	int		sub_chunks;
+	int		buffer_fill;	// % of the stream buffer
+	int		decode_q;	// free frames for the decoder
+	int		disp_q;		// decoded frames waiting for display
+	int		sink_q;		// frames owned by the video sink
+
+	// sync, ms
+	int		av_drift;	// audio to video delay
+	int		av_drift_max;	// largest absolute drift
+	int		sink_delay;	// last frame, due time - time it was shown
+
+	// player thread
+	int		video_shown;
+	int		video_dropped;	// late frames dropped
+	int		video_doubled;
+	int		video_B_dropped;	// not even decoded
+	int		video_starved;	// times the parser ran out of video packets
+	int		video_empty;
+	UINT64		video_bytes;	// demuxed packets taken from the parser
+	// decoder thread
+	int		video_errors;
+	// audio thread
+	int		audio_starved;	// times the parser ran out of audio packets
+	int		audio_empty;
+	UINT64		audio_bytes;	// demuxed packets taken from the parser
+} STREAM_STATS;
+
+void stream_stats_reset    ( STREAM_STATS *st );
+void stream_stats_add      ( STREAM_STATS *st, int stage, int time );
+void stream_stats_count    ( int *counter );
+void stream_stats_sample   ( struct STREAM *s );
+
+STREAM_STATS *stream_stats_get( struct STREAM *s, STREAM_STATS *stats );
+int  stream_stats_print    ( struct STREAM *s, char *buf, int size );
+
+// the streams stream_stats_print_all() reports on
+void stream_stats_register  ( struct STREAM *s );
+void stream_stats_unregister( struct STREAM *s );
+int  stream_stats_print_all ( char *buf, int size );
+
+#endif
@@ -50,7 +50,8 @@ typedef struct subt_orig_t
  	char  ext[4];
  	char lang[4];
         int utf8;
-        int delete;
+        unsigned char *data;	// transcoded UTF-8 text, parsed instead of filename if set
+        int size;
 
         unsigned int lan_count;
         char *language_name;
@@ -105,6 +106,7 @@ typedef struct converted_subs_t
         int cnt;
 } converted_subs;
 
+FILE *subtitle_open( subt_orig *subs );
 char *subtitle_clean_formatter( char *line, int clean_tags );
 void subtitle_clean_error(uni_sub* subs);
 
@@ -62,9 +62,11 @@ extern int threadcom_destroy(threadcom_link_t* comlink);
  *	threadcom_post_event
  *
  *	Posts an event from a thread context to the main event loop.
- *	Any data can be posted, however keep in mind that this function
- *	is only non-blocking up to length = 4096. 'data' and 'length' 
- *	may not be 0.
+ *	Any data can be posted, it is copied into a ring in the link,
+ *	this blocks only while the ring is full (about 56 kB of events
+ *	the receiver did not get yet) and fails for larger events.
+ *	Posting never locks and only makes a syscall when the ring was
+ *	empty. 'data' and 'length' may not be 0.
  *
  *	On success, 0 is returned.
  *	On error, 1 is returned.
@@ -77,8 +79,11 @@ extern int threadcom_post_event(threadcom_link_t* comlink, const void *data, ssi
  *	Retrieves data posted with threadcom_post_event from a thread.
  *	Use this call from within the threadcom_event_t callback.
  *	You _MUST_ use threadcom_get_event after an event was posted to
- *	clear the communication pipe, even if you discard the data
- *	afterwards.
+ *	clear it from the link, even if you discard the data
+ *	afterwards. It may be called repeatedly to drain all pending
+ *	events, that costs no syscalls until the link is empty. The
+ *	callback may rarely find nothing to get, check the return.
+ *	Only one thread at a time may get from a link.
  *
  *	'data' and 'length' may not be 0, and the poster and the receiver
  *	must agree on the size of the data being exchanged.
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _THUMB_ENGINE_H
+#define _THUMB_ENGINE_H
+
+#include "image.h"
+
+/*
+	thumbnails without a STREAM: lavf seeks to the keyframe at or before
+	the requested time, that single frame is decoded and downscaled while
+	it is converted. only local files, everything else fails and has to
+	go through thumb_get_image_from_url().
+
+	thumb_engine_run() spreads a list of jobs over worker threads,
+	the decoders that are open at the same time stay within max_mem MB.
+
+	thumb_engine_strip() puts count evenly spaced keyframes of one file
+	into the tiles of a single image, with one open and one pass through
+	the file. tiles are filled row by row, columns per row.
+*/
+typedef struct THUMB_JOB {
+	// in
+	const char	*url;
+	int		time;		// ms, -1 for the default position
+	int		colorspace;	// AV_IMAGE_YUV_422, AV_IMAGE_BGRA_32 or AV_IMAGE_RGBX_32
+	int		max_width;	// the frame is downscaled to fit, 0 for no limit
+	int		max_height;
+	int		fixed_width;	// narrower frames are scaled up to max_width as well
+
+	// out
+	IMAGE		*img;		// image_free() it
+	int		time_out;	// ms of the decoded keyframe
+	int		duration;
+	int		rotation;
+	int		error;		// VIDEO_ERROR
+} THUMB_JOB;
+
+typedef struct THUMB_STRIP {
+	// in
+	const char	*url;
+	int		count;		// tiles
+	int		columns;	// tiles per row, 0 for a single row
+	int		colorspace;	// AV_IMAGE_YUV_422, AV_IMAGE_BGRA_32 or AV_IMAGE_RGBX_32
+
+	// in/out: the limits in, the size of every tile out
+	int		tile_width;
+	int		tile_height;
+
+	// out
+	IMAGE		*img;		// image_free() it
+	int		*times;		// ms of each tile, -1 if empty, afree() it
+	int		rows;
+	int		filled;		// tiles with a picture, the rest are black
+	int		duration;
+	int		rotation;
+	int		error;		// VIDEO_ERROR
+} THUMB_STRIP;
+
+int thumb_engine_get( THUMB_JOB *job );
+int thumb_engine_strip( THUMB_STRIP *strip );
+int thumb_engine_run( THUMB_JOB *jobs, int count, int threads, int max_mem );
+
+#endif	// _THUMB_ENGINE_H
@@ -106,14 +106,18 @@ typedef struct Timer_str {
 	void *ctx;
 	void (*callback_ctx)(void *ctx);
 	char caller[128 + 1];
-	struct Timer_str *next;
+	struct Timer_str *next;		// free list
+	int pos;			// index in heap
+	unsigned stamp;			// insert order, the latest fires first on equal timeouts
 } Timer;
 
 struct Timers_str {
 	pthread_mutex_t mutex;
 	Timer *data;
-	Timer dummy;
+	Timer **heap;			// size entries, earliest timeout first
+	Timer *free;
 	int size, cnt;
+	unsigned seq, stamp;
 };
 
 #ifdef __cplusplus
@@ -74,4 +74,7 @@ void sec_to_hms( int *hour, int *min, int *sec );
 
 int adjust_oom(pid_t pid, int value);
 
+void *amalloc_mirror( int size, const char *name );
+void afree_mirror( void *ptr, int size );
+
 #endif
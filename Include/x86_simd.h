@@ -0,0 +1,51 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _X86_SIMD_H_
+#define _X86_SIMD_H_
+
+#include <stdint.h>
+
+/*
+	x86 counterparts of the neon_* pixel kernels, SSE2 or AVX2 picked at runtime.
+
+	all kernels work on whole vectors only and return the number of pixels
+	(or samples) they have done, the caller finishes the rest with its scalar
+	loop, results are bit exact to the scalar code in codec_utils.c
+
+	x86_yuv420_to_BGRA32
+	x86_yuv420_to_RGBX32	two lines of 420P, dst and dst + linesize (in pixel)
+	x86_nv12_to_BGRA32
+	x86_nv12_to_RGBX32	two lines of NV12, dst and dst + linesize (in pixel)
+	x86_interleave_uv	U/V planes to NV12 UV, count UV pairs
+	x86_scale_420P10b_Y	10 bit Y to 8 bit video range, same as SCALE() for 10 bit input
+	x86_copy_pack_shift	10 bit U/V planes to 8 bit NV12 UV, count UV pairs
+*/
+#define X86_SIMD_NONE	0
+#define X86_SIMD_SSE2	1
+#define X86_SIMD_AVX2	2
+
+int x86_simd_level( void );
+
+int x86_yuv420_to_BGRA32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *u, const uint8_t *v, int width, int linesize );
+int x86_yuv420_to_RGBX32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *u, const uint8_t *v, int width, int linesize );
+int x86_nv12_to_BGRA32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *uv, int width, int linesize );
+int x86_nv12_to_RGBX32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *uv, int width, int linesize );
+int x86_interleave_uv( uint8_t *dst, const uint8_t *u, const uint8_t *v, int count );
+int x86_scale_420P10b_Y( uint8_t *dst, const uint16_t *src, int count );
+int x86_copy_pack_shift( uint16_t *dst, const uint16_t *srcV, const uint16_t *srcU, int count );
+
+#endif
@@ -268,6 +268,69 @@ DBG2 serprintf("idl %s  %08X\r\n", state->tag );
 	pthread_mutex_unlock(&state->_mutex);
 }
 
+// *****************************************************************************
+//
+//	thread_event_init
+//
+// *****************************************************************************
+void thread_event_init( THREAD_EVENT *ev )
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init( &attr );
+	pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+
+	pthread_mutex_init( &ev->_mutex, NULL );
+	pthread_cond_init( &ev->_cond, &attr );
+	pthread_condattr_destroy( &attr );
+	ev->_seq = 0;
+}
+
+void thread_event_destroy( THREAD_EVENT *ev )
+{
+	pthread_cond_destroy( &ev->_cond );
+	pthread_mutex_destroy( &ev->_mutex );
+}
+
+// *****************************************************************************
+//
+//	thread_event_signal
+//
+// *****************************************************************************
+void thread_event_signal( THREAD_EVENT *ev )
+{
+	pthread_mutex_lock( &ev->_mutex );
+	ev->_seq ++;
+	pthread_cond_broadcast( &ev->_cond );
+	pthread_mutex_unlock( &ev->_mutex );
+}
+
+// *****************************************************************************
+//
+//	thread_event_wait
+//
+//	wait up to timeout ms for a signal after seq, returns 1 on timeout
+//
+// *****************************************************************************
+int thread_event_wait( THREAD_EVENT *ev, unsigned seq, int timeout )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	ts.tv_sec  += timeout / 1000;
+	ts.tv_nsec += (timeout % 1000) * 1000000;
+	if( ts.tv_nsec >= 1000000000 ) {
+		ts.tv_nsec -= 1000000000;
+		ts.tv_sec  += 1;
+	}
+
+	int ret = 0;
+	pthread_mutex_lock( &ev->_mutex );
+	while( ev->_seq == seq && !ret ) {
+		ret = pthread_cond_timedwait( &ev->_cond, &ev->_mutex, &ts ) == ETIMEDOUT;
+	}
+	pthread_mutex_unlock( &ev->_mutex );
+	return ret;
+}
+
 #ifdef DEBUG_MSG
 static volatile int 	test_thread_kill;
 static pthread_t	test_thread_handle;
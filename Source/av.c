@@ -817,9 +817,14 @@ void video_frame_copy_props( VIDEO_FRAME *dst, VIDEO_FRAME *src )
 	int		dst_index   = dst->index;
 	int		dst_size    = dst->size;
 	void		(*dst_destroy)(VIDEO_FRAME *) = dst->destroy;
+	VIDEO_FRAME	*dst_next   = dst->next;
+	unsigned	dst_queued  = dst->queued;
 	memcpy( dst, src, sizeof(VIDEO_FRAME));
 	dst->data[0]    = dst_data;
 	dst->index      = dst_index;
 	dst->size       = dst_size;
 	dst->destroy    = dst_destroy;
+	// the queue links belong to the queue dst is in
+	dst->next       = dst_next;
+	dst->queued     = dst_queued;
 }
@@ -0,0 +1,282 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "global.h"
+#include "types.h"
+#include "debug.h"
+#include "util.h"
+#include "atime.h"
+#include "astdlib.h"
+#include "avos_lifetime.h"
+#include "file_type.h"
+#include "stream.h"
+#include "stream_stats.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/*
+	avbench: plays files as fast as the machine can, through parser,
+	decoder and converter into the fake sinks, without A/V sync, and
+	writes what it measured as JSON.
+
+	avbench [-o out.json] [-t timeout_s] [-c "debug command"]... file...
+
+	-c runs a debug command before the first file, e.g. "fftc 4" for
+	the decoder threads or "ffrc 2" for the convert threads, so runs
+	with different settings can be compared.
+*/
+
+#define BENCH_TIMEOUT	600	// s per file
+#define BENCH_MAX_CMDS	32
+
+void device_config_init( void );
+
+static const char *stage_names[STREAM_STAGE_MAX] = {
+	"parse", "vdecode", "convert", "adecode", "sink"
+};
+
+static volatile int stopped;
+
+static void _stop_handler( STREAM *s )
+{
+	stopped = 1;
+}
+
+// ************************************************************
+//
+//	_thread_cpu
+//
+// ************************************************************
+// ms of CPU the thread used so far, the thread must still be running
+static int _thread_cpu( pthread_t thread )
+{
+	clockid_t clock;
+	struct timespec ts;
+
+	if( !thread || pthread_getcpuclockid( thread, &clock ) || clock_gettime( clock, &ts ) ) {
+		return -1;
+	}
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int _process_cpu( void )
+{
+	struct rusage ru;
+	getrusage( RUSAGE_SELF, &ru );
+	return ru.ru_utime.tv_sec * 1000 + ru.ru_utime.tv_usec / 1000 + ru.ru_stime.tv_sec * 1000 + ru.ru_stime.tv_usec / 1000;
+}
+
+static long _peak_rss( void )
+{
+	struct rusage ru;
+	getrusage( RUSAGE_SELF, &ru );
+	return ru.ru_maxrss;	// kB
+}
+
+static void _print_string( FILE *out, const char *str )
+{
+	fputc( '"', out );
+	for( ; *str; str++ ) {
+		if( *str == '"' || *str == '\\' ) {
+			fputc( '\\', out );
+		}
+		if( (unsigned char)*str < 0x20 ) {
+			fprintf( out, "\\u%04x", *str );
+		} else {
+			fputc( *str, out );
+		}
+	}
+	fputc( '"', out );
+}
+
+// ************************************************************
+//
+//	_bench_file
+//
+// ************************************************************
+static int _bench_file( FILE *out, const char *url, int timeout, int first )
+{
+	STREAM_STATS st;
+	int type = TYPE_VID, etype = 0;
+	int i;
+
+	STREAM *s = stream_new();
+	if( !s ) {
+		return 1;
+	}
+	get_file_type( url, &type, &etype );
+	stream_set_stop_handler( s, _stop_handler );
+	stream_set_max_video_dimensions( s, VIDEO_MAX_WIDTH, VIDEO_MAX_HEIGHT );
+	stream_set_video_sink( s, stream_get_default_video_sink( s ) );
+
+	STREAM_URL src;
+	stream_url_cpy_url( &src, url );
+
+	stopped = 0;
+	int cpu   = _process_cpu();
+	int start = atime();
+	int error = VE_NO_ERROR;
+	if( stream_open( s, &src, etype, STREAM_PAUSED ) || stream_start( s ) ) {
+		error = s->video_error != VE_NO_ERROR ? s->video_error : VE_ERROR;
+		// stream_start() may have failed after stream_open() started the threads
+		stream_stop( s );
+		stream_delete( &s );
+	} else {
+		stream_un_pause( s, 0 );
+		while( !stopped && s->video_error == VE_NO_ERROR && atime() - start < timeout * 1000 ) {
+			msec_sleep( 10 );
+		}
+		error = s->video_error;
+	}
+	int took = MAX( atime() - start, 1 );
+
+	fprintf( out, "%s\n    {\n      \"file\": ", first ? "" : "," );
+	_print_string( out, url );
+	fprintf( out, ",\n      \"error\": %d,\n", error );
+	if( !s ) {
+		fprintf( out, "      \"wall_ms\": %d\n    }", took );
+		return 1;
+	}
+
+	// the threads are still there, stream_stop() joins them
+	int cpu_parser  = _thread_cpu( s->parser_thread_handle );
+	int cpu_decoder = _thread_cpu( s->codec_thread_handle );
+	int cpu_audio   = s->audio->valid ? _thread_cpu( s->audio_thread_handle ) : 0;
+	int cpu_player  = _thread_cpu( s->engine_thread_handle );
+	stream_stats_get( s, &st );
+
+	int duration = s->duration;
+	int width    = s->video->valid ? s->video->width : 0;
+	int height   = s->video->valid ? s->video->height : 0;
+
+	stream_stop( s );
+	stream_delete( &s );
+
+	UINT64 bytes = st.video_bytes + st.audio_bytes;
+	fprintf( out, "      \"completed\": %s,\n", stopped ? "true" : "false" );
+	fprintf( out, "      \"duration_ms\": %d,\n", duration );
+	fprintf( out, "      \"width\": %d,\n      \"height\": %d,\n", width, height );
+	fprintf( out, "      \"wall_ms\": %d,\n", took );
+	fprintf( out, "      \"frames\": %d,\n", st.video_shown );
+	fprintf( out, "      \"fps\": %.2f,\n", (double)st.video_shown * 1000 / took );
+	fprintf( out, "      \"realtime\": %.2f,\n", (double)duration / took );
+	fprintf( out, "      \"demuxed_bytes\": %llu,\n", (unsigned long long)bytes );
+	fprintf( out, "      \"demux_mb_s\": %.2f,\n", (double)bytes * 1000 / took / (1024 * 1024) );
+	fprintf( out, "      \"dropped\": %d,\n      \"decode_errors\": %d,\n", st.video_dropped + st.video_B_dropped, st.video_errors );
+	fprintf( out, "      \"cpu_ms\": { \"process\": %d, \"parser\": %d, \"decoder\": %d, \"audio\": %d, \"player\": %d },\n",
+		_process_cpu() - cpu, cpu_parser, cpu_decoder, cpu_audio, cpu_player );
+	fprintf( out, "      \"stages\": {" );
+	for( i = 0; i < STREAM_STAGE_MAX; i++ ) {
+		STREAM_STAGE_STATS *sg = &st.stage[i];
+		// stage times are in 1/10 ms
+		fprintf( out, "%s\n        \"%s\": { \"count\": %u, \"total_ms\": %.1f, \"avg_ms\": %.2f, \"max_ms\": %.1f }",
+			i ? "," : "", stage_names[i], sg->count, sg->total / 10.0,
+			sg->count ? (double)sg->total / sg->count / 10 : 0.0, sg->max / 10.0 );
+	}
+	fprintf( out, "\n      },\n" );
+	fprintf( out, "      \"peak_rss_kb\": %ld\n    }", _peak_rss() );
+
+	return error != VE_NO_ERROR || !stopped;
+}
+
+// ************************************************************
+//
+//	main
+//
+// ************************************************************
+int main( int argc, char *argv[] )
+{
+	const char *cmds[BENCH_MAX_CMDS];
+	const char *out_name = NULL;
+	int timeout = BENCH_TIMEOUT;
+	int num_cmds = 0;
+	int opt, i;
+
+	while( (opt = getopt( argc, argv, "o:t:c:" )) != -1 ) {
+		switch( opt ) {
+		case 'o':
+			out_name = optarg;
+			break;
+		case 't':
+			timeout = atoi( optarg );
+			break;
+		case 'c':
+			if( num_cmds < BENCH_MAX_CMDS ) {
+				cmds[num_cmds++] = optarg;
+			}
+			break;
+		default:
+			optind = argc + 1;
+			break;
+		}
+	}
+	if( optind >= argc ) {
+		fprintf( stderr, "usage: %s [-o out.json] [-t timeout_s] [-c \"debug command\"]... file...\n", argv[0] );
+		return 2;
+	}
+
+	FILE *out = out_name ? fopen( out_name, "w" ) : stdout;
+	if( !out ) {
+		perror( out_name );
+		return 2;
+	}
+
+	LOG_open();
+	avos_init( AVOS_RUNLEVEL_PLATFORM );
+	time_init_time();
+	device_config_init();
+	avos_init( AVOS_RUNLEVEL_BC );
+
+	stream_set_headless( 1 );
+#ifdef DEBUG_MSG
+	for( i = 0; i < num_cmds; i++ ) {
+		debug_do_cmd( (const unsigned char*)cmds[i] );
+	}
+#else
+	if( num_cmds ) {
+		fprintf( stderr, "%s: no debug commands in release builds\n", argv[0] );
+	}
+#endif
+
+	fprintf( out, "{\n  \"commands\": [" );
+	for( i = 0; i < num_cmds; i++ ) {
+		fprintf( out, "%s", i ? ", " : "" );
+		_print_string( out, cmds[i] );
+	}
+	fprintf( out, "],\n  \"cpus\": %ld,\n  \"files\": [", sysconf( _SC_NPROCESSORS_ONLN ) );
+
+	int failed = 0;
+	for( i = optind; i < argc; i++ ) {
+		failed += _bench_file( out, argv[i], timeout, i == optind );
+		fflush( out );
+	}
+	fprintf( out, "\n  ],\n  \"failed\": %d,\n  \"peak_rss_kb\": %ld\n}\n", failed, _peak_rss() );
+
+	if( out != stdout ) {
+		fclose( out );
+	}
+	avos_exit( AVOS_RUNLEVEL_BC );
+	avos_exit( AVOS_RUNLEVEL_PLATFORM );
+	LOG_close();
+
+	return failed ? 1 : 0;
+}
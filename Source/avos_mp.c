@@ -109,6 +109,7 @@ int avos_mp_video_setsubtitleratio(avos_mp_t *mp, avos_mp_video_t *video, uint32
 int avos_mp_video_setaudiofilter(avos_mp_t *mp, avos_mp_video_t *video, int n, int night_on);
 int avos_mp_video_setavdelay(avos_mp_t *mp, avos_mp_video_t *video, int delay);
 int avos_mp_video_setavspeed(avos_mp_t *mp, avos_mp_video_t *video, float speed);
+int avos_mp_video_getstats(avos_mp_t *mp, avos_mp_video_t *video, char *buf, int size);
 
 int avos_mp_audio_abort(avos_mp_t *mp, avos_mp_audio_t *audio);
 int avos_mp_audio_start(avos_mp_t *mp, avos_mp_audio_t *audio);
@@ -856,6 +857,17 @@ static int avos_mp_setavspeed(avos_mp_t *mp, float speed)
 	return AVOS_ERR_OK;
 }
 
+static int avos_mp_getstats(avos_mp_t *mp, char *buf, int size)
+{
+	if (size > 0)
+		buf[0] = 0;
+	// the stream may be replaced meanwhile
+	if (async_cmd_is_running(mp))
+		return AVOS_ERR_OK;
+	AVOS_MP_VIDEO(getstats, mp, buf, size);
+	return AVOS_ERR_OK;
+}
+
 static int avos_mp_setnextrack(avos_mp_t *mp, const char *path)
 {
 #ifdef UPNP_FUSE_TO_HTTP
@@ -900,6 +912,7 @@ static const avos_mp_handle_t avos_mp_handle = {
 	.setaudiofilter = avos_mp_setaudiofilter,
 	.setavdelay = avos_mp_setavdelay,
 	.setavspeed = avos_mp_setavspeed,
+	.getstats = avos_mp_getstats,
 	.setnextrack = avos_mp_setnextrack,
 };
 
@@ -482,6 +482,12 @@ int avos_mp_video_setavdelay(avos_mp_t *mp, avos_mp_video_t *video, int delay)
 	return AVOS_ERR_OK;
 }
 
+int avos_mp_video_getstats(avos_mp_t *mp, avos_mp_video_t *video, char *buf, int size)
+{
+	stream_stats_print(video->s, buf, size);
+	return AVOS_ERR_OK;
+}
+
 int avos_mp_video_setavspeed(avos_mp_t *mp, avos_mp_video_t *video, float speed)
 {
 	stream_set_av_speed(video->s, speed);
@@ -28,6 +28,7 @@
 #include "file_info.h"
 #include "thumb.h"
 #include "thumb_stream.h"
+#include "thumb_engine.h"
 #include "athread.h"
 #include "stream_config.h"
 
@@ -48,6 +49,8 @@ struct avos_mr {
 	APIC			apic;
 	int			info_valid;
 	thumb_stream_t		*thumb_stream;
+	IMAGE			*thumb_img;	// last frame of the thumb engine
+	IMAGE			*strip_img;	// last sprite sheet of the thumb engine
 
 	metadata_buffer_t *metadata_buffer;
 };
@@ -71,6 +74,10 @@ static int avos_mr_destroy(avos_mr_t *mr)
 		avos_metadata_destroy(&mr->metadata_buffer);
 	if (mr->thumb_stream)
 		thumb_stream_destroy(mr->thumb_stream);
+	if (mr->thumb_img)
+		image_free(mr->thumb_img);
+	if (mr->strip_img)
+		image_free(mr->strip_img);
 	if (mr->apic.buffer)
 		free(mr->apic.buffer);
 	if (mr->fd != -1)
@@ -92,6 +99,14 @@ static int avos_mr_setdatasource_common(avos_mr_t *mr)
 		thumb_stream_destroy(mr->thumb_stream);
 		mr->thumb_stream = NULL;
 	}
+	if (mr->thumb_img) {
+		image_free(mr->thumb_img);
+		mr->thumb_img = NULL;
+	}
+	if (mr->strip_img) {
+		image_free(mr->strip_img);
+		mr->strip_img = NULL;
+	}
 	mr->apic.buffer_size = APIC_MAX_SIZE;
 	get_url_type_and_mime(&mr->src, &mr->type, &mr->etype, &mr->mimetype);
 
@@ -350,13 +365,24 @@ static int avos_mr_getframe(avos_mr_t *mr, int time_ms, avos_bgra_bitmap_t **pbi
 	if (!pbitmap)
 		return AVOS_ERR;
 
-	if (!mr->thumb_stream)
-		mr->thumb_stream = thumb_stream_create();
-	if (!mr->thumb_stream) {
-		*pbitmap = NULL;
-		return AVOS_ERR_OK;
+	if (mr->thumb_img) {
+		image_free(mr->thumb_img);
+		mr->thumb_img = NULL;
+	}
+	// one keyframe without a STREAM, local files only
+	THUMB_JOB job = { .url = mr->src.url, .time = time_ms, .colorspace = AV_IMAGE_BGRA_32 };
+	if (!thumb_engine_get(&job)) {
+		img = mr->thumb_img = job.img;
+		rotation = job.rotation;
+	} else {
+		if (!mr->thumb_stream)
+			mr->thumb_stream = thumb_stream_create();
+		if (!mr->thumb_stream) {
+			*pbitmap = NULL;
+			return AVOS_ERR_OK;
+		}
+		img = thumb_stream_get_frame(mr->thumb_stream, &mr->src, mr->etype, time_ms, AV_IMAGE_BGRA_32, &rotation);
 	}
-	img = thumb_stream_get_frame(mr->thumb_stream, &mr->src, mr->etype, time_ms, AV_IMAGE_BGRA_32, &rotation);
 	if (!img) {
 		*pbitmap = NULL;
 		return AVOS_ERR_OK;
@@ -384,6 +410,57 @@ static int avos_mr_getframe(avos_mr_t *mr, int time_ms, avos_bgra_bitmap_t **pbi
 	return AVOS_ERR_OK;
 }
 
+static int avos_mr_getframes(avos_mr_t *mr, int count, int tile_width, int tile_height, int columns, avos_thumb_strip_t **pstrip)
+{
+	avos_thumb_strip_t *strip;
+	int i;
+
+	MRLOGV("%d %dx%d", count, tile_width, tile_height);
+
+	if (!pstrip || count <= 0)
+		return AVOS_ERR;
+	*pstrip = NULL;
+
+	if (mr->strip_img) {
+		image_free(mr->strip_img);
+		mr->strip_img = NULL;
+	}
+	// count keyframes in a single pass, local files only
+	THUMB_STRIP job = {
+		.url = mr->src.url,
+		.count = count,
+		.columns = columns,
+		.colorspace = AV_IMAGE_BGRA_32,
+		.tile_width = tile_width,
+		.tile_height = tile_height,
+	};
+	if (thumb_engine_strip(&job))
+		return AVOS_ERR_OK; // not critical, strip is NULL
+	mr->strip_img = job.img;
+
+	strip = (avos_thumb_strip_t *)calloc(1, sizeof(avos_thumb_strip_t) + count * sizeof(int32_t));
+	if (!strip) {
+		afree(job.times);
+		return AVOS_ERR;
+	}
+	strip->bitmap.width = job.img->width;
+	strip->bitmap.height = job.img->height;
+	strip->bitmap.linestep = job.img->linestep[0];
+	strip->bitmap.rotation = job.rotation;
+	strip->bitmap.data_size = job.img->size;
+	strip->bitmap.data = job.img->data[0];
+	strip->tile_width = job.tile_width;
+	strip->tile_height = job.tile_height;
+	strip->columns = job.columns;
+	strip->count = count;
+	for (i = 0; i < count; i++)
+		strip->times[i] = job.times[i];
+	afree(job.times);
+
+	*pstrip = strip;
+	return AVOS_ERR_OK;
+}
+
 static int avos_mr_getapic(avos_mr_t *mr, avos_apic_t **papic)
 {
 	avos_apic_t *apic;
@@ -410,6 +487,7 @@ static const avos_mr_handle_t avos_mr_handle = {
 	.extractmetadata = avos_mr_extractmetadata,
 	.getframe = avos_mr_getframe,
 	.getapic = avos_mr_getapic,
+	.getframes = avos_mr_getframes,
 };
 
 const avos_mr_handle_t *avos_mr_get_handle()
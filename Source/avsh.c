@@ -18,6 +18,7 @@
 #include "global.h"
 #include "debug.h"
 #include "dataevent.h"
+#include "stream_stats.h"
 
 #include <stddef.h>
 #include <stdio.h>
@@ -87,6 +88,17 @@ static void socket_callback(void *p)
 		serprintf( "avsh: error recfrom\r\n" );
 	} else {
 serprintf( "avsh: %s\r\n", message );
+		// the only command of release builds
+		if( !strncmp( message, "stats", 5 ) ) {
+			char stats[4096];
+			stream_stats_print_all( stats, sizeof( stats ) );
+			// serprintf() is gone in release builds, the client gets the answer
+			if( size > offsetof( struct sockaddr_un, sun_path ) &&
+			    sendto( socket_data_event->fd, stats, strlen( stats ) + 1, 0, ( struct sockaddr * ) &name, size ) < 0 ) {
+				perror( "avsh: sendto" );
+			}
+			return;
+		}
 #ifdef DEBUG_MSG
 		debug_do_cmd( message );
 #endif
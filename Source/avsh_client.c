@@ -21,6 +21,8 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <stddef.h>
+#include <string.h>
+#include <sys/time.h>
 
 #ifdef CONFIG_MEDIACENTER
 #define SERVER  "/data/data/com.archos.mediacenter.videoti/files/avsh.sock"
@@ -69,6 +71,25 @@ int make_named_socket( const char *filename )
 	return sock;
 }
 
+// commands that answer, the reply is printed as it comes
+static void wait_reply( int sock, const char *msg )
+{
+	if( strncmp( msg, "stats", 5 ) )
+		return;
+
+	struct timeval tv = { 1, 0 };
+	setsockopt( sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+
+	char reply[4096 + 1];
+	int nbytes = recv( sock, reply, sizeof( reply ) - 1, 0 );
+	if( nbytes < 0 ) {
+		fprintf(stderr, "error: no reply\n");
+		return;
+	}
+	reply[nbytes] = '\0';
+	fputs( reply, stdout );
+}
+
 static void handle_error()
 {
 	if (errno == ENOENT) {
@@ -121,6 +142,7 @@ printf("Sending: [%s]\n", line );
 		if ( nbytes < 0 ) {
 			handle_error();
 		}
+		wait_reply( sock, line );
 	} else {
 		while( 1 ) {
 			char *msg = NULL;
@@ -154,6 +176,7 @@ printf("Sending: [%s]\n", msg);
 				if ( nbytes < 0 ) {
 					handle_error();
 				}
+				wait_reply( sock, msg );
 			}
 			free( msg );
 		}
@@ -23,6 +23,12 @@
 
 #include <string.h>
 
+int cbe_use_mirror = 1;
+
+#ifdef DEBUG_MSG
+DECLARE_DEBUG_TOGGLE("cbem", cbe_use_mirror );
+#endif
+
 // *********************************************************************
 // create, destroy
 // *********************************************************************
@@ -37,8 +43,21 @@ CBE *cbe_new( int size, int overlap, int dma )
 	cbe->size    = size;
 	cbe->overlap = overlap;
 	cbe->dma     = dma;
+	cbe->mirror  = 0;
 	
-	if( cbe->dma ) {
+	if( !cbe->dma && cbe_use_mirror && overlap <= size ) {
+		// map the buffer twice, the second view is a full size overlap
+		// that never needs to be copied or patched
+		int mirror_size = ALIGN( size, sysconf( _SC_PAGESIZE ) );
+		if( ( cbe->data = amalloc_mirror( mirror_size, "cbe" ) ) ) {
+			cbe->size    = mirror_size;
+			cbe->overlap = mirror_size;
+			cbe->mirror  = 1;
+		}
+	}
+	if( cbe->mirror ) {
+		// done
+	} else if( cbe->dma ) {
 		cbe->data = stream_malloc_dma( size + overlap );
 	} else {
 		cbe->data = amalloc( size + overlap );
@@ -55,7 +74,9 @@ CBE *cbe_new( int size, int overlap, int dma )
 void cbe_delete( CBE **cbe )
 {
 	if( *cbe ) {
-		if( (*cbe)->dma ) {
+		if( (*cbe)->mirror ) {
+			afree_mirror( (*cbe)->data, (*cbe)->size );
+		} else if( (*cbe)->dma ) {
 			stream_free_dma( &(*cbe)->data, (*cbe)->size + (*cbe)->overlap );
 		} else {
 			afree( (*cbe)->data );
@@ -164,7 +185,13 @@ static int _cbe_copy( CBE *cbe, unsigned int *write, const unsigned char *buffer
 {
 	int rest = cbe->size - *write;
 //serprintf("cbe write: %d  %d\r\n", cbe->write, count );
-	if( rest >= count ) {
+	if( cbe->mirror ) {
+		// the second view takes whatever runs over the end
+		memcpy( cbe->data + *write, buffer, count );
+		*write += count;
+		if( *write >= cbe->size )
+			*write -= cbe->size;
+	} else if( rest >= count ) {
 		_cbe_copy_nowrap( cbe, write, buffer, count );
 	} else {
 		_cbe_copy_nowrap( cbe, write, buffer, rest );
@@ -180,7 +207,7 @@ int cbe_write( CBE *cbe, const unsigned char *buffer, int count )
 
 unsigned char *cbe_get_patch_p( CBE *cbe, int size, unsigned char **copy_p, int *copy_size )
 {
-	if( cbe->write < cbe->overlap ) {
+	if( cbe->write < cbe->overlap && !cbe->mirror ) {
 		int copy = MIN( size, cbe->overlap - cbe->write ); 
 		if( copy_size )
 			*copy_size = copy;
@@ -202,7 +229,7 @@ int cbe_patch( CBE *cbe, unsigned char *patch_p, int size )
 	if( write < 0 || write >= cbe->size )
 		return 1;
 	
-	if( write < cbe->overlap ) {
+	if( write < cbe->overlap && !cbe->mirror ) {
 		int copy = MIN( size, cbe->overlap - write ); 
 //serprintf("copy:  %d\r\n", copy );
 		memcpy( cbe->data + cbe->size + write, cbe->data + write, copy );
@@ -43,7 +43,8 @@ static void 		*notify_ctx;
 static void link_callback(threadcom_link_t* comlink)
 {
         int dummy;
-	threadcom_get_event(comlink, (char*)&dummy, sizeof(int));
+	if( threadcom_get_event(comlink, (char*)&dummy, sizeof(int)) )
+		return;
 	
 DBG serprintf("link_callback: DONE\r\n");
 	AV_stop();
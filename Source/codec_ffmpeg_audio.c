@@ -506,38 +506,26 @@ static int convert_to_stereo( PRIV *p, AVFrame *frame, UCHAR **pcm_data, int *ou
 	return samples * 2 * 2;
 }
 
-static inline int16_t convert_to_S16(uint8_t *src, int bits, int shift, int fmt) {
-	int16_t res = 0;
-	int32_t resi = 0;
-	switch( fmt ) {
-		case AV_SAMPLE_FMT_FLT:
-		case AV_SAMPLE_FMT_FLTP:
-			res = clamp(lrintf( *(float*)src * (1 << 15)));
-			break;
-		case AV_SAMPLE_FMT_DBL:
-		case AV_SAMPLE_FMT_DBLP:
-			res = clamp(lrintf( *(double*)src * (1 << 15)));
-			break;
-		case AV_SAMPLE_FMT_U8:
-		case AV_SAMPLE_FMT_U8P:
-			res = get8(src);
-			break;
-		case AV_SAMPLE_FMT_S16:
-		case AV_SAMPLE_FMT_S16P:
-			res = getS16LE(src);
-			break;
-		case AV_SAMPLE_FMT_S32:
-		case AV_SAMPLE_FMT_S32P:
-			if( bits == 16 )
-				resi = getS16LE( src );
-			else if ( bits == 24 )
-				resi = getS24LE( src );
-			else if ( bits == 32 )
-				resi = getS32LE(src);
-			res = clamp( resi >> shift );
-			break;
+static int pcm_fmt( int sample_fmt )
+{
+	switch( sample_fmt ) {
+	case AV_SAMPLE_FMT_FLT:
+	case AV_SAMPLE_FMT_FLTP:
+		return PCM_FMT_FLT;
+	case AV_SAMPLE_FMT_DBL:
+	case AV_SAMPLE_FMT_DBLP:
+		return PCM_FMT_DBL;
+	case AV_SAMPLE_FMT_U8:
+	case AV_SAMPLE_FMT_U8P:
+		return PCM_FMT_U8;
+	case AV_SAMPLE_FMT_S16:
+	case AV_SAMPLE_FMT_S16P:
+		return PCM_FMT_S16;
+	case AV_SAMPLE_FMT_S32:
+	case AV_SAMPLE_FMT_S32P:
+		return PCM_FMT_S32;
 	}
-	return res;
+	return PCM_FMT_NONE;
 }
 
 static int convert( PRIV *p, AVFrame *frame, UCHAR **out_data, int *out_channels, int *out_bits)
@@ -547,67 +535,14 @@ static int convert( PRIV *p, AVFrame *frame, UCHAR **out_data, int *out_channels
 	if (p->request_channels == 2) {
 		out_size = convert_to_stereo(p, frame, out_data, out_channels, out_bits);
 	} else {
-		int bytes_per_samples = av_get_bytes_per_sample(p->actx->sample_fmt);
-		int bits  = bytes_per_samples * 8;
-		int shift = (bits == 32) ? 16 : (bits == 24 ) ? 8 : 0;
-		uint8_t *dest = (uint8_t*) p->bsamples;
-
 		if( p->actx->channels < p->request_channels ) {
 serprintf("upmix %d -> %d\n", p->actx->channels, p->request_channels);
-			if (av_sample_fmt_is_planar(p->actx->sample_fmt)) {
-				int i, j;
-serprintf("planar %d / %d\n", p->actx->channels, p->request_channels);
-				for (i = 0; i < frame->nb_samples; ++i) {
-					for (j = 0; j < p->actx->channels; ++j) {
-						uint8_t *src = frame->data[j] + i * bytes_per_samples;
-						int16_t res = convert_to_S16(src, bits, shift, p->actx->sample_fmt);
-						memcpy(dest, &res, 2);
-						dest += 2;
-					}
-					for (j = 0; j < (p->request_channels - p->actx->channels); ++j) {
-						memset(dest, 0, 2);
-						dest += 2;
-					}
-				}
-			} else {
-				int i, j;
-				uint8_t *src = frame->data[0];
-				for (i = 0; i < frame->nb_samples; i++) {
-					for( j = 0; j < p->actx->channels; j++) {
-						int16_t res = convert_to_S16(src, bits, shift, p->actx->sample_fmt);
-						memcpy(dest, &res, 2);
-						dest += 2;
-						src += bytes_per_samples;
-					}
-					for (j = 0; j < (p->request_channels - p->actx->channels); j++) {
-						memset(dest, 0, 2);
-						dest += 2;
-					}
-				}
-			}
 			*out_channels = p->request_channels;
 		} else {
-			if (av_sample_fmt_is_planar(p->actx->sample_fmt)) {
-				int i, j;
-//serprintf("planar %d / %d\n", p->actx->channels, p->request_channels);
-				for (i = 0; i < frame->nb_samples; ++i) {
-					for (j = 0; j < p->actx->channels; ++j) {
-						uint8_t *src = frame->data[j] + i * bytes_per_samples;
-						int16_t res = convert_to_S16(src, bits, shift, p->actx->sample_fmt);
-						memcpy(dest, &res, 2);
-						dest += 2;
-					}
-				}
-			} else {
-				int i;
-				for (i = 0; i < frame->nb_samples *  p->actx->channels; ++i) {
-					int16_t res = convert_to_S16(frame->data[0] + i * bytes_per_samples, bits, shift, p->actx->sample_fmt);
-					memcpy(dest, &res, 2);
-					dest += 2;
-				}
-			}
 			*out_channels = p->actx->channels;
 		}
+		pcm_convert_S16( p->bsamples, *out_channels, frame->data, av_sample_fmt_is_planar(p->actx->sample_fmt),
+				 frame->nb_samples, p->actx->channels, pcm_fmt( p->actx->sample_fmt ) );
 
 		out_size  = frame->nb_samples * 2 * *out_channels;
 		*out_bits = 16; //we force output to 16 bits
@@ -654,6 +589,12 @@ Dump( data, size );
 	AVPacket avpkt = { .data = data, .size = size };
 	av_init_packet(&avpkt);
 
+	AVBufferRef *buf = audio->data_ref;
+	if( buf && data >= buf->data && data + size <= buf->data + buf->size ) {
+		// the data lives in the demuxer packet, lavc only takes a reference instead of a copy
+		avpkt.buf = buf;
+	}
+
 	int t1 = time_update_time();
 	av_frame_unref(p->aframe);
 	int ret_send = avcodec_send_packet(p->actx, &avpkt);
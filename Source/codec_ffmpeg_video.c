@@ -149,14 +149,87 @@ DECLARE_DEBUG_COMMAND_VOID( "ffsf", show_formats );
 void av_log_cb(void*, int, const char*, va_list);
 #endif
 
+// frames received from the decoder but not yet handed out,
+// a packet can produce more than one frame (frame threading, field pairs...)
+#define PENDING_MAX	16
+
 typedef struct PRIV {
 	AVCodecContext 	*vctx;
 	const AVCodec 	*vcodec;
 	AVFrame		*vframe;
 	void		*mt_ctx;
 	int		reorder_pts;
+	AVFrame		*pending[PENDING_MAX];
+	int		pending_read;
+	int		pending_count;
+	int		eof;		// the decoder got the end of stream packet
+	CODEC_SCRATCH	scratch;
 } PRIV;
 
+// ************************************************************
+//
+//	_pending_*
+//
+// ************************************************************
+static int _pending_alloc( PRIV *p )
+{
+	int i;
+	for( i = 0; i < PENDING_MAX; i++ ) {
+		if( !(p->pending[i] = av_frame_alloc()) )
+			return 1;
+	}
+	p->pending_read  = 0;
+	p->pending_count = 0;
+	return 0;
+}
+
+static void _pending_free( PRIV *p )
+{
+	int i;
+	for( i = 0; i < PENDING_MAX; i++ ) {
+		av_frame_free( &p->pending[i] );
+	}
+	p->pending_read  = 0;
+	p->pending_count = 0;
+}
+
+static void _pending_clear( PRIV *p )
+{
+	while( p->pending_count ) {
+		av_frame_unref( p->pending[p->pending_read] );
+		p->pending_read = (p->pending_read + 1) % PENDING_MAX;
+		p->pending_count--;
+	}
+	p->pending_read = 0;
+}
+
+// pull every frame the decoder has ready into the pending queue
+static int _pending_receive( PRIV *p )
+{
+	while( p->pending_count < PENDING_MAX ) {
+		AVFrame *f = p->pending[(p->pending_read + p->pending_count) % PENDING_MAX];
+		int ret = avcodec_receive_frame( p->vctx, f );
+		if( ret == AVERROR(EAGAIN) || ret == AVERROR_EOF )
+			return 0;
+		if( ret < 0 )
+			return ret;
+		p->pending_count++;
+	}
+	return 0;
+}
+
+// move the oldest pending frame into dst
+static int _pending_get( PRIV *p, AVFrame *dst )
+{
+	if( !p->pending_count )
+		return 0;
+	av_frame_unref( dst );
+	av_frame_move_ref( dst, p->pending[p->pending_read] );
+	p->pending_read = (p->pending_read + 1) % PENDING_MAX;
+	p->pending_count--;
+	return 1;
+}
+
 //
 // VIDEO
 //
@@ -335,6 +408,12 @@ serprintf("cannot open codec\r\n");
 
 DBGS serprintf("name %s  type %d  id %d  extra %d  threads %d\r\n", vcodec->name, vcodec->type, vcodec->id, vctx->extradata_size, vctx->thread_count);
 	p->vframe = av_frame_alloc();
+	if( !p->vframe || _pending_alloc( p ) ) {
+serprintf("cannot alloc frames\r\n");
+		_pending_free( p );
+		av_frame_free( &p->vframe );
+		goto ErrorExit;
+	}
 	
 	dec->is_open = 1;
 
@@ -357,6 +436,7 @@ DBGS serprintf("FFMPEG: drop extra\r\n");
 	if( _ff_render_count ) {
 		p->mt_ctx = codec_convert_mt_init( _ff_render_count );
 	}
+	codec_scratch_resize( &p->scratch, dec->video->width );
 	
 	return 0;
 	
@@ -389,11 +469,13 @@ serprintf("ffvd not open!\r\n");
 	PRIV *p = (PRIV*)dec->priv;
 
  	// free the YUV frame
-	av_free( p->vframe );
+	av_frame_free( &p->vframe );
+	_pending_free( p );
 
 	if( p->mt_ctx ) {
 		codec_convert_mt_exit( p->mt_ctx );
 	}
+	codec_scratch_free( &p->scratch );
 
 	STREAM *s = dec->ctx;
 	if( s && s->ro_ctx) {
@@ -504,7 +586,8 @@ DBGCV2 serprintf("\r\nFFM: %2d  siz %6d/%c  tim %8d  ", avos_frame->index, size,
 	
 	avos_frame->valid = 0;
 	
-	switch( dec->video->format ) {
+	// the empty drain chunk at the end has no headers to look at
+	switch( size ? dec->video->format : -1 ) {
 	case VIDEO_FORMAT_MPEG: {
 		int fake_size = _fake_dsp_mpeg2( data, size );
 		if( fake_size > 0 )
@@ -558,28 +641,45 @@ DBGCV2 serprintf("<");
 	int start = time_update_time();
 	int ret = 0;
 	if( !_ff_fake ) {
-        ret = avcodec_send_packet(vctx, &avpkt);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-             //try again later -- ignore error silently
-             ret = 0;
-        }
-        else if (ret < 0) {
-            serprintf("FFM: avcodec_send_packet failed\r\n");
-        }
-        else
-            decoded += size;
-
-        ret = avcodec_receive_frame(vctx, vframe);
-        if (ret == AVERROR(EAGAIN) ) {
-             //try again later -- ignore error silently
-             ret = 0;
-        }
-        else if (ret < 0) {
-            serprintf("FFM: avcodec_receive_frame error\r\n");
-        }
-        else
-            got_picture = 1;
-
+		// frames still queued go out first and the packet stays with the caller (decoded = 0),
+		// so the queue never grows beyond what one packet produced
+		if( !size && !p->pending_count ) {
+			// end of stream: tell the decoder once, then take out what it still holds
+			if( !p->eof ) {
+				p->eof = 1;
+				avcodec_send_packet( vctx, NULL );
+			}
+			ret = _pending_receive( p );
+			if( ret < 0 ) {
+				ret = 0;
+			}
+		} else if( !p->pending_count ) {
+			// send the packet, if the decoder is full take out what it has ready,
+			// if that gave us frames they go out first and the packet is sent on a later call
+			ret = avcodec_send_packet( vctx, &avpkt );
+			if( ret == AVERROR(EAGAIN) ) {
+				ret = _pending_receive( p );
+				if( ret >= 0 && !p->pending_count ) {
+					ret = avcodec_send_packet( vctx, &avpkt );
+				} else if( ret >= 0 ) {
+					ret = AVERROR(EAGAIN);
+				}
+			}
+			if( ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ) {
+				ret = 0;
+			} else if( ret < 0 ) {
+				serprintf("FFM: avcodec_send_packet failed\r\n");
+			} else {
+				decoded += size;
+				// drain everything this packet produced, hand out one frame per call
+				ret = _pending_receive( p );
+				if( ret < 0 ) {
+					serprintf("FFM: avcodec_receive_frame error\r\n");
+				}
+			}
+		}
+		got_picture = _pending_get( p, vframe );
+DBGCV2 serprintf("pend %2d  ", p->pending_count );
 	} else {
 		got_picture = 1;
 		vframe->reordered_opaque = vctx->reordered_opaque;
@@ -630,13 +730,18 @@ DBGCV2 serprintf("[");
 				avos_frame->priv = (void*)av_frame_clone(vframe);
 			} else {
 				avos_frame->dec = NULL;
-				if( p->mt_ctx ) {
+				if( p->mt_ctx && !avos_frame->deinterlace ) {
 					codec_convert_mt( p->mt_ctx, map_pixfmt( vctx->pix_fmt ), vframe->data, vframe->linesize, vctx->width, vctx->height, avos_frame );
 				} else {	
-					codec_convert_pixel_format( map_pixfmt( vctx->pix_fmt ), vframe->data, vframe->linesize, vctx->width, vctx->height, avos_frame);
+					// no-op unless the resolution changed
+					codec_scratch_resize( &p->scratch, vctx->width );
+					codec_convert_pixel_format2( map_pixfmt( vctx->pix_fmt ), vframe->data, vframe->linesize, vctx->width, vctx->height, avos_frame, &p->scratch );
 				}
 			}
 			start = time_update_time() - start;
+			if( !avos_frame->dec && dec->ctx ) {
+				stream_stats_add( &((STREAM*)dec->ctx)->stats, STREAM_STAGE_CONVERT, start );
+			}
 DBGCV2 serprintf("yuv %3d]", start); 
 		}
 	} else {
@@ -691,10 +796,15 @@ static int ffmpeg_video_codec_render( STREAM_DEC_VIDEO *dec, VIDEO_FRAME *dst, V
 	AVFrame	*avframe = (AVFrame*)src->priv;
 DBGCV3 serprintf("ffrender %2d %08X %08X %08X\n", src->index, avframe->data, avframe->data[0], dst ? dst->data[0] : 0 );
 	if( dst ) {
-		if( p->mt_ctx ) {
+		int start = time_update_time();
+		if( p->mt_ctx && !dst->deinterlace ) {
 			codec_convert_mt( p->mt_ctx, map_pixfmt( vctx->pix_fmt ), avframe->data, avframe->linesize, vctx->width, vctx->height, dst);
 		} else {	
-			codec_convert_pixel_format( map_pixfmt( vctx->pix_fmt ), avframe->data, avframe->linesize, vctx->width, vctx->height, dst);
+			codec_scratch_resize( &p->scratch, vctx->width );
+			codec_convert_pixel_format2( map_pixfmt( vctx->pix_fmt ), avframe->data, avframe->linesize, vctx->width, vctx->height, dst, &p->scratch );
+		}
+		if( dec->ctx ) {
+			stream_stats_add( &((STREAM*)dec->ctx)->stats, STREAM_STAGE_CONVERT, time_update_time() - start );
 		}
 	}
 	av_frame_free((AVFrame**)&src->priv);
@@ -705,8 +815,11 @@ DBGCV3 serprintf("ffrender %2d %08X %08X %08X\n", src->index, avframe->data, avf
 static int ffmpeg_video_codec_flush( STREAM_DEC_VIDEO *dec  )
 {
 	PRIV *p = (PRIV*)dec->priv;
-	if( p->vctx )
+	_pending_clear( p );
+	p->eof = 0;
+	if( p->vctx ) {
 		avcodec_flush_buffers( p->vctx );
+	}
 	return 0;
 }
 
@@ -769,6 +882,7 @@ static STREAM_DEC_VIDEO *_new( void )
 	dec->flush   = ffmpeg_video_codec_flush;
 	dec->get_rc  = ffmpeg_video_codec_get_rc;
 	dec->render  = ffmpeg_video_codec_render;
+	dec->drain   = 1;
 	
 	if( !(dec->priv = acalloc( 1, sizeof( PRIV ) ) ) ) {
 serprintf("FFM: cannot alloc priv\n");
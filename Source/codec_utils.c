@@ -20,7 +20,10 @@
 #include "util.h"
 #include "stream.h"
 #include "codec_utils.h"
+#include "slice_pool.h"
 #include "av.h"
+#include "image.h"
+#include "astdlib.h"
 
 #ifdef CONFIG_LIBYUV
 #include "libyuv.h"
@@ -29,6 +32,7 @@
 #define DBG if(0)
 
 extern void RenderX( unsigned char *p_outpic, unsigned char *p_pic, int width, int height, int dst_linesize, int src_linesize );
+extern void RenderXBand( unsigned char *p_outpic, unsigned char *p_pic, int width, int height, int band, int dst_linesize, int src_linesize );
 
 #ifdef CONFIG_NEON
 #include "neon.h"
@@ -38,6 +42,12 @@ static int neon_swap = 0;
 DECLARE_DEBUG_TOGGLE("neons", neon_swap );
 #endif
 
+#ifdef CONFIG_X86_SIMD
+#include "x86_simd.h"
+static int use_x86_simd = 1;
+DECLARE_DEBUG_TOGGLE("x86", use_x86_simd );
+#endif
+
 #ifdef DEBUG_MSG
 static int deinterlace_perf = 0;
 static int total_time = 0;
@@ -122,49 +132,41 @@ static int convertYUV10btoRGBX32( int y, int u, int v )
 	return ( b << 16 ) | ( g << 8 ) | r;
 }
 
-__attribute__((unused))
-static void convert_420P_to_RGB( int colorspace, unsigned char *src_data[], int src_linesize[], int width, int height, int start, unsigned char *data, int linesize, int deinterlace )
-{
-	if( !src_data[0] || !src_data[1] || !src_data[2] || (colorspace != AV_IMAGE_BGRA_32 && colorspace != AV_IMAGE_RGBX_32) )
-		return;	  
-
-	int perf_time = 0;
+// ************************************************************
+//
+//	scratch
+//
+// ************************************************************
+// the fused deinterlace+convert works on bands of 16 picture lines:
+// 16 lines Y, 8 lines U and V
+#define DEINT_BAND_LINES	16
 
-	unsigned char* inBufferY = src_data[0];
-	int inStrideY = src_linesize[0];
+static int _scratch_size( int width )
+{
+	return DEINT_BAND_LINES * width + 2 * (DEINT_BAND_LINES / 2) * ((width + 1) / 2);
+}
 
-	unsigned char* inBufferU = src_data[1];
-	int inStrideU = src_linesize[1];
+int codec_scratch_resize( CODEC_SCRATCH *scratch, int width )
+{
+	int size = _scratch_size( width );
+	if( scratch->data && scratch->size >= size )
+		return 0;
+
+	afree( scratch->data );
+	scratch->data = amalloc( size );
+	scratch->size = scratch->data ? size : 0;
+	return !scratch->data;
+}
 
-	unsigned char* inBufferV = src_data[2];
-	int inStrideV = src_linesize[2];
+void codec_scratch_free( CODEC_SCRATCH *scratch )
+{
+	afree( scratch->data );
+	scratch->data = NULL;
+	scratch->size = 0;
+}
 
-	if (deinterlace) {
-		inBufferY = (unsigned char *)malloc(width*height);
-		inBufferU = (unsigned char *)malloc(width*height/4);
-		inBufferV = (unsigned char *)malloc(width*height/4);
-		inStrideY = width;
-		inStrideU = width/2;
-		inStrideV = width/2;
-#ifdef DEBUG_MSG
-		if (deinterlace_perf) {
-			total_byte += (width * height) * 3 / 2;
-			perf_time = get_time();
-		}
-#endif
-		RenderX(inBufferY, src_data[0], width, height, width, src_linesize[0]);
-		RenderX(inBufferU, src_data[1], width/2, height/2, width/2, src_linesize[1]);
-		RenderX(inBufferV, src_data[2], width/2, height/2, width/2, src_linesize[2]);
-#ifdef DEBUG_MSG
-		if (deinterlace_perf) {
-			total_time += get_time()-perf_time;
-			if (total_byte >= (40 << 20)) {
-				serprintf("Deint %f MB/s\n", ((float)total_byte*1000.0)/(1024.0*1024.0*(float)total_time));
-				total_time = total_byte = 0;
-			}
-		}
-#endif
-	}
+static void _420P_to_RGB( int colorspace, unsigned char *inBufferY, int inStrideY, unsigned char *inBufferU, int inStrideU, unsigned char *inBufferV, int inStrideV, int width, int height, int start, unsigned char *data, int linesize )
+{
 #ifdef CONFIG_NEON
 	if( use_neon ) {
 		void (*convert)(uint32_t *, uint8_t *, uint8_t *, uint8_t *, uint8_t *, int, int) = colorspace == AV_IMAGE_BGRA_32 ? neon_yuv420_to_BGRA32 : neon_yuv420_to_RGBX32;
@@ -186,9 +188,22 @@ static void convert_420P_to_RGB( int colorspace, unsigned char *src_data[], int
 		int (*convert)(int, int, int) = colorspace == AV_IMAGE_BGRA_32 ? convertYUVtoBGRA32 : convertYUVtoRGBX32;
 		int y;
 		for( y = start ; y < start + height; y += 2 ) {
-			int x;
-
-			for( x = 0; x < width; x++ ) {
+			int x = 0;
+#ifdef CONFIG_X86_SIMD
+			if( use_x86_simd ) {
+				// vector part, the loop below does the remaining pixels
+				unsigned char *Y1 = inBufferY + y      * inStrideY;
+				unsigned char *Y2 = inBufferY +(y + 1) * inStrideY;
+				unsigned char *U  = inBufferU + y / 2  * inStrideU;
+				unsigned char *V  = inBufferV + y / 2  * inStrideV;
+				UINT32 *dst = (UINT32*)data + y  * linesize;
+				if( colorspace == AV_IMAGE_BGRA_32 )
+					x = x86_yuv420_to_BGRA32( dst, Y1, Y2, U, V, width, linesize );
+				else
+					x = x86_yuv420_to_RGBX32( dst, Y1, Y2, U, V, width, linesize );
+			}
+#endif
+			for( ; x < width; x++ ) {
 				unsigned char *Y1 = inBufferY + y      * inStrideY + x;
 				unsigned char *Y2 = inBufferY +(y + 1) * inStrideY + x;
 				unsigned char *U  = inBufferU + y / 2  * inStrideU + x / 2;
@@ -199,11 +214,76 @@ static void convert_420P_to_RGB( int colorspace, unsigned char *src_data[], int
 			}
 		}
 	}
+}
+
+// deinterlace a band of 16 lines into the scratch and convert it while it is still in the cache,
+// same output as deinterlacing the whole picture first, without the picture sized temporary planes
+static void _deinterlace_420P_to_RGB( int colorspace, unsigned char *src_data[], int src_linesize[], int width, int height, unsigned char *data, int linesize, CODEC_SCRATCH *scratch )
+{
+	int perf_time = 0;
+	int cwidth  = width / 2;
+	int cheight = height / 2;
+	int cstride = (width + 1) / 2;
+
+	unsigned char *band = NULL;
+	if( scratch && !codec_scratch_resize( scratch, width ) )
+		band = scratch->data;
+	else
+		band = amalloc( _scratch_size( width ) );
+	if( !band )
+		return;
+
+	unsigned char *bandY = band;
+	unsigned char *bandU = bandY + DEINT_BAND_LINES * width;
+	unsigned char *bandV = bandU + DEINT_BAND_LINES / 2 * cstride;
+
+#ifdef DEBUG_MSG
+	if (deinterlace_perf) {
+		total_byte += (width * height) * 3 / 2;
+		perf_time = get_time();
+	}
+#endif
+	int y;
+	for( y = 0; y < height; y += DEINT_BAND_LINES ) {
+		// RenderX bands are 8 lines
+		int b = y / 8;
+		int c = y / 2;
+		RenderXBand( bandY, src_data[0] + y * src_linesize[0], width, height, b, width, src_linesize[0] );
+		if( y + 8 < height )
+			RenderXBand( bandY + 8 * width, src_data[0] + (y + 8) * src_linesize[0], width, height, b + 1, width, src_linesize[0] );
+		if( c < cheight ) {
+			RenderXBand( bandU, src_data[1] + c * src_linesize[1], cwidth, cheight, b / 2, cstride, src_linesize[1] );
+			RenderXBand( bandV, src_data[2] + c * src_linesize[2], cwidth, cheight, b / 2, cstride, src_linesize[2] );
+		}
+
+		int lines = height - y < DEINT_BAND_LINES ? height - y : DEINT_BAND_LINES;
+		_420P_to_RGB( colorspace, bandY, width, bandU, cstride, bandV, cstride, width, lines, 0, (unsigned char*)((UINT32*)data + y * linesize), linesize );
+	}
+#ifdef DEBUG_MSG
+	if (deinterlace_perf) {
+		total_time += get_time()-perf_time;
+		if (total_byte >= (40 << 20)) {
+			serprintf("Deint %f MB/s\n", ((float)total_byte*1000.0)/(1024.0*1024.0*(float)total_time));
+			total_time = total_byte = 0;
+		}
+	}
+#endif
+	if( !scratch || band != scratch->data )
+		afree( band );
+}
+
+__attribute__((unused))
+static void convert_420P_to_RGB( int colorspace, unsigned char *src_data[], int src_linesize[], int width, int height, int start, unsigned char *data, int linesize, int deinterlace, CODEC_SCRATCH *scratch )
+{
+	if( !src_data[0] || !src_data[1] || !src_data[2] || (colorspace != AV_IMAGE_BGRA_32 && colorspace != AV_IMAGE_RGBX_32) )
+		return;	  
+
 	if (deinterlace) {
-		free(inBufferY);
-		free(inBufferU);
-		free(inBufferV);
+		// whole picture only, like the deinterlacer
+		_deinterlace_420P_to_RGB( colorspace, src_data, src_linesize, width, height, data, linesize, scratch );
+		return;
 	}
+	_420P_to_RGB( colorspace, src_data[0], src_linesize[0], src_data[1], src_linesize[1], src_data[2], src_linesize[2], width, height, start, data, linesize );
 }
 
 static void convert_420P10b_to_RGB( int colorspace, unsigned char *src_data[], int src_linesize[], int width, int height, int start, unsigned char *data, int linesize )
@@ -354,7 +434,20 @@ static void convert_NV12_to_RGB( int colorspace, unsigned char *src_data[], int
 			unsigned char *UV = src_data[1] + y / 2  * src_linesize[1];
 			UINT32 *dst = (UINT32*)data + y * linesize;
 
-			for( x = 0; x < width; x+= 2 ) {
+			x = 0;
+#ifdef CONFIG_X86_SIMD
+			if( use_x86_simd ) {
+				if( colorspace == AV_IMAGE_BGRA_32 )
+					x = x86_nv12_to_BGRA32( dst, Y1, Y2, UV, width, linesize );
+				else
+					x = x86_nv12_to_RGBX32( dst, Y1, Y2, UV, width, linesize );
+				Y1  += x;
+				Y2  += x;
+				UV  += x;
+				dst += x;
+			}
+#endif
+			for( ; x < width; x+= 2 ) {
 				unsigned char U = *UV++;
 				unsigned char V = *UV++;
 
@@ -569,7 +662,12 @@ static void convert_420P10b_to_NV12( unsigned char *src_data[], int src_linesize
 		} else
 #endif
 		{
-			for (x = 0; x < width; x++)
+			x = 0;
+#ifdef CONFIG_X86_SIMD
+			if( use_x86_simd )
+				x = x86_scale_420P10b_Y(dst_y, src_y, width);
+#endif
+			for (; x < width; x++)
 				  dst_y[x] = SCALE(src_y[x]);
 		}
 		src_y += src_linesize[0]/2;
@@ -582,7 +680,12 @@ static void convert_420P10b_to_NV12( unsigned char *src_data[], int src_linesize
 		} else
 #endif
 		{
-			for (x = 0; x < (width + 1) / 2; x++) {
+			x = 0;
+#ifdef CONFIG_X86_SIMD
+			if( use_x86_simd )
+				x = x86_copy_pack_shift(dst_uv, src_v, src_u, (width + 1) / 2);
+#endif
+			for (; x < (width + 1) / 2; x++) {
 				dst_uv[x] = ((src_v[x]>>2) << 8) | src_u[x]>>2; 
 			}
 		}
@@ -616,8 +719,17 @@ static void convert_420P_to_NV12( unsigned char *src_data[], int src_linesize[],
 		memcpy( dstY1, Y1, linesizeY );
 		memcpy( dstY2, Y2, linesizeY );
 
-		int x;
-		for( x = 0; x < width; x += 2 ) {
+		int x = 0;
+#ifdef CONFIG_X86_SIMD
+		if( use_x86_simd ) {
+			int done = x86_interleave_uv( (unsigned char*)dstUV, U, V, (width + 1) / 2 );
+			dstUV += done;
+			U     += done;
+			V     += done;
+			x      = done * 2;
+		}
+#endif
+		for( ; x < width; x += 2 ) {
 			*dstUV++ = (*V++ << 8) | *U++;
 		}
 	}
@@ -695,7 +807,12 @@ static void convert_420P10b_to_YV12( unsigned char *src_data[], int src_linesize
 		} else
 #endif
 		{
-			for (x = 0; x < width; x++)
+			x = 0;
+#ifdef CONFIG_X86_SIMD
+			if( use_x86_simd )
+				x = x86_scale_420P10b_Y(dst_y, src_y, width);
+#endif
+			for (; x < width; x++)
 				  dst_y[x] = SCALE(src_y[x]);
 		}
 		src_y += src_linesize[0]/2;
@@ -734,32 +851,18 @@ static void convert_420P_to_YV12( unsigned char *src_data[], int src_linesize[],
 	uint8_t *dst_u = dst_data[2] + (start + 1)/2 * dst_linesize[2];
 	int y;
 	int perf_time = 0;
-	
-	unsigned char* inBufferY = src_y;
-	int inStrideY = src_linesize[0];
-
-	unsigned char* inBufferU = src_u;
-	int inStrideU = src_linesize[1];
-
-	unsigned char* inBufferV = src_v;
-	int inStrideV = src_linesize[2];
 
 	if (deinterlace) {
-		inBufferY = (unsigned char *)malloc(width*height);
-		inBufferU = (unsigned char *)malloc((width + 1)/2*(height+1)/2);
-		inBufferV = (unsigned char *)malloc((width + 1)/2*(height+1)/2);
-		inStrideY = width;
-		inStrideU = (width + 1)/2;
-		inStrideV = (width + 1)/2;
+		// the copy is all the conversion there is, so let the deinterlacer write the destination
 #ifdef DEBUG_MSG
 		if (deinterlace_perf) {
 			total_byte += (width * height) * 3 / 2;
 			perf_time = get_time();
 		}
 #endif
-		RenderX(inBufferY, src_y, width, height, inStrideY, src_linesize[0]);
-		RenderX(inBufferU, src_u, width/2, (height + 1)/2, inStrideU, src_linesize[1]);
-		RenderX(inBufferV, src_v, width/2, (height + 1)/2, inStrideV, src_linesize[2]);
+		RenderX(dst_y, src_y, width, height, dst_linesize[0], src_linesize[0]);
+		RenderX(dst_u, src_u, width/2, (height + 1)/2, dst_linesize[2], src_linesize[1]);
+		RenderX(dst_v, src_v, width/2, (height + 1)/2, dst_linesize[1], src_linesize[2]);
 #ifdef DEBUG_MSG
 		if (deinterlace_perf) {
 			total_time += get_time()-perf_time;
@@ -769,26 +872,21 @@ static void convert_420P_to_YV12( unsigned char *src_data[], int src_linesize[],
 			}
 		}
 #endif
+		return;
 	}
 
 	for (y = 0; y < height; y++) {
-		memcpy(dst_y, inBufferY + y * inStrideY, width);
+		memcpy(dst_y, src_y + y * src_linesize[0], width);
 		dst_y += dst_linesize[0];
 	}
 
 	for (y = 0; y < (height + 1) / 2; y++) {
-		memcpy(dst_u, inBufferU + y * inStrideU, (width + 1) / 2);
-		memcpy(dst_v, inBufferV + y * inStrideV, (width + 1) / 2);
+		memcpy(dst_u, src_u + y * src_linesize[1], (width + 1) / 2);
+		memcpy(dst_v, src_v + y * src_linesize[2], (width + 1) / 2);
 
 		dst_v += dst_linesize[1];
 		dst_u += dst_linesize[2];
 	}
-
-	if (deinterlace) {
-		free(inBufferY);
-		free(inBufferU);
-		free(inBufferV);
-	}
 }
 
 
@@ -1049,12 +1147,13 @@ int color_conversion_supported(int colorspace, int pixfmt)
 	return 0;
 }
 
-static void _convert( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, int start, int total_height, VIDEO_FRAME *frame)
+static void _convert( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, int start, int total_height, VIDEO_FRAME *frame, CODEC_SCRATCH *scratch )
 {
 
 #ifndef CONFIG_NEON
-	//Deactivate deinterlacing on non Neon SoC
-	frame->deinterlace = 0;
+	//Deactivate deinterlacing on non Neon SoC (no store when already off, stripes share the frame)
+	if( frame->deinterlace )
+		frame->deinterlace = 0;
 #endif
 
 #ifdef CONFIG_LIBYUV
@@ -1205,7 +1304,7 @@ static void _convert( int pixfmt, unsigned char *src_data[], int src_linesize[],
 	case AV_IMAGE_RGBX_32:
 		switch( pixfmt ) {
 		case PIXFMT_YUV420P:
-			convert_420P_to_RGB( frame->colorspace, src_data, src_linesize, width, height, start, frame->data[0], frame->linestep[0], frame->deinterlace);
+			convert_420P_to_RGB( frame->colorspace, src_data, src_linesize, width, height, start, frame->data[0], frame->linestep[0], frame->deinterlace, scratch );
 			break;
 		case PIXFMT_YUV422P:
 			convert_422P_to_RGB( frame->colorspace, src_data, src_linesize, width, height, start, frame->data[0], frame->linestep[0]);
@@ -1230,106 +1329,147 @@ static void _convert( int pixfmt, unsigned char *src_data[], int src_linesize[],
 
 void codec_convert_pixel_format( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, VIDEO_FRAME *frame )
 {
-	_convert( pixfmt, src_data, src_linesize, width, height, 0, height, frame );
+	_convert( pixfmt, src_data, src_linesize, width, height, 0, height, frame, NULL );
+}
+
+void codec_convert_pixel_format2( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, VIDEO_FRAME *frame, CODEC_SCRATCH *scratch )
+{
+	_convert( pixfmt, src_data, src_linesize, width, height, 0, height, frame, scratch );
+}
+
+// ************************************************************
+//
+//	codec_convert_scaled
+//
+// ************************************************************
+// converts straight into the smaller dst->window, every destination pixel
+// is the average of up to 4x4 samples of its source area.
+// for thumbnails, the full size picture is never converted
+#define SCALED_TAPS	4
+
+static inline int _sample( const unsigned char *line, int x, int wide )
+{
+	return wide ? ((const uint16_t*)line)[x] >> 2 : line[x];
 }
 
-#include <pthread.h>
+int codec_convert_scaled( int pixfmt, unsigned char *src_data[], int src_linesize[], int width, int height, IMAGE *dst )
+{
+	int shift_x = 1, shift_y = 1, wide = 0, nv12 = 0;
+
+	switch( pixfmt ) {
+	case PIXFMT_YUV420P:	break;
+	case PIXFMT_YUV420P10LE:wide = 1; break;
+	case PIXFMT_YUV422P:	shift_y = 0; break;
+	case PIXFMT_YUV444P:	shift_x = shift_y = 0; break;
+	case PIXFMT_NV12:	nv12 = 1; break;
+	default:
+		return 1;
+	}
+	if( dst->colorspace != AV_IMAGE_YUV_422 && dst->colorspace != AV_IMAGE_BGRA_32 && dst->colorspace != AV_IMAGE_RGBX_32 ) {
+		return 1;
+	}
+
+	int out_w = dst->window.width;
+	int out_h = dst->window.height;
+	if( out_w <= 0 || out_h <= 0 || width <= 0 || height <= 0 ) {
+		return 1;
+	}
+	// source columns of every destination column: first sample and step
+	int *cols = amalloc( 2 * out_w * sizeof( int ) );
+	if( !cols ) {
+		return 1;
+	}
+	int ox, oy, i, j;
+	for( ox = 0; ox < out_w; ox++ ) {
+		int x0 = (INT64)ox * width / out_w;
+		int x1 = (INT64)(ox + 1) * width / out_w;
+		cols[2 * ox]     = x0;
+		cols[2 * ox + 1] = x1 - x0 > SCALED_TAPS ? (x1 - x0) / SCALED_TAPS : 1;
+	}
+	int (*convert)(int, int, int) = dst->colorspace == AV_IMAGE_BGRA_32 ? convertYUVtoBGRA32 : convertYUVtoRGBX32;
+
+	for( oy = 0; oy < out_h; oy++ ) {
+		int y0 = (INT64)oy * height / out_h;
+		int y1 = (INT64)(oy + 1) * height / out_h;
+		int ny = y1 - y0 > SCALED_TAPS ? SCALED_TAPS : MAX( y1 - y0, 1 );
+		int sy = y1 - y0 > SCALED_TAPS ? (y1 - y0) / SCALED_TAPS : 1;
+		unsigned char *out = PIXELPTR( dst, dst->window.x, dst->window.y + oy );
+
+		for( ox = 0; ox < out_w; ox++ ) {
+			int x0 = cols[2 * ox];
+			int sx = cols[2 * ox + 1];
+			int nx = sx > 1 ? SCALED_TAPS : MIN( MAX( (INT64)(ox + 1) * width / out_w - x0, 1 ), SCALED_TAPS );
+			int sum_y = 0, sum_u = 0, sum_v = 0;
+
+			for( j = 0; j < ny; j++ ) {
+				int y = y0 + j * sy;
+				const unsigned char *Y = src_data[0] + y * src_linesize[0];
+				const unsigned char *U = src_data[1] + (y >> shift_y) * src_linesize[1];
+				const unsigned char *V = nv12 ? U : src_data[2] + (y >> shift_y) * src_linesize[2];
+				for( i = 0; i < nx; i++ ) {
+					int x = x0 + i * sx;
+					sum_y += _sample( Y, x, wide );
+					if( nv12 ) {
+						sum_u += U[(x >> 1) * 2];
+						sum_v += V[(x >> 1) * 2 + 1];
+					} else {
+						sum_u += _sample( U, x >> shift_x, wide );
+						sum_v += _sample( V, x >> shift_x, wide );
+					}
+				}
+			}
+			int n = nx * ny;
+			int y = sum_y / n, u = sum_u / n, v = sum_v / n;
+
+			if( dst->colorspace == AV_IMAGE_YUV_422 ) {
+				((USHORT*)out)[ox] = (y << 8) | ((ox & 1) ? v : u);
+			} else {
+				((UINT32*)out)[ox] = convert( y - 16, u - 128, v - 128 );
+			}
+		}
+	}
+	afree( cols );
+	return 0;
+}
 
 #define MAX_WORKERS 8
 
-typedef struct work {
-	int    index;
-	
-	pthread_mutex_t	work_mutex;
-	pthread_cond_t  work_cond;
-	int             work_stop;
-	
-	pthread_mutex_t	done_mutex;
-	pthread_cond_t  done_cond;
-	
+// lines per stripe handed to the workers, keep it a multiple of 16 (tiled NV12, 420 line pairs)
+static int convert_stripe = 16;
+DECLARE_DEBUG_PARAM("cvst", convert_stripe );
+
+typedef struct convert_job {
 	int    pixfmt; 
 	unsigned char **data;
 	int    *linestep;
 	int    width;
-	int    height;
-	int    start;
 	int    total_height;
 	VIDEO_FRAME *frame;
-} work_t;
+} convert_job_t;
 
-typedef struct convert {
-	int    		work_num;
-	pthread_t	work_thread_handle[MAX_WORKERS];
-	work_t		work[MAX_WORKERS];
-} convert_t;
-
-static void *work_thread(void *ctx)
+static void _convert_stripe( void *arg, int start, int height )
 {
-	work_t *w = (work_t*)ctx;
-	
-DBG serprintf("work_thread %d started!\n", w->index);
-	while (!w->work_stop) {
-		pthread_mutex_lock(&w->work_mutex);
-		while (!w->work_stop && !w->frame) {
-//serprintf("<<<");
-			pthread_cond_wait(&w->work_cond, &w->work_mutex);
-//serprintf(">>>");
-		}
-		pthread_mutex_unlock(&w->work_mutex);
-		if( w->work_stop ) {
-			break;
-		}
-		int start = time_update_time();
-		_convert( w->pixfmt, w->data, w->linestep, w->width, w->height, w->start, w->total_height, w->frame );
-DBG serprintf("work %d/%2d/%2d\n", w->index, w->frame->index, time_update_time() - start );
-		w->frame = NULL;
-
-		pthread_mutex_lock(&w->done_mutex);
-		pthread_cond_signal(&w->done_cond);
-		pthread_mutex_unlock(&w->done_mutex);
-	}
-DBG serprintf("work_thread %d stopped!\n", w->index);
-	return NULL;
+	convert_job_t *j = (convert_job_t*)arg;
+	_convert( j->pixfmt, j->data, j->linestep, j->width, height, start, j->total_height, j->frame, NULL );
 }
 
 void codec_convert_mt( void *ctx, int pixfmt, unsigned char *data[], int linesize[], int width, int height, VIDEO_FRAME *frame )
 {
-	convert_t *c = (convert_t*)ctx;
-	
-	int start = time_update_time();
-	// start the workers
-	int i;
-	int pos   = 0;
-	int slice = (height / (c->work_num + 0)) & ~0x0f;
-	for( i = 0; i < c->work_num; i++ ) {
-		int h = (i == c->work_num - 1) ? height - pos : slice;
-//DBG 
-serprintf("pos %d  %4d/%4d\n", i, pos, h);
-		pthread_mutex_lock(&c->work[i].work_mutex);
-		c->work[i].data     = data;
-		c->work[i].linestep = linesize;
-		c->work[i].pixfmt   = pixfmt;
-		c->work[i].width    = width;
-		c->work[i].height   = h;
-		c->work[i].start    = pos;
-		c->work[i].total_height = height;
-		c->work[i].frame    = frame;
-
-		pthread_cond_signal(&c->work[i].work_cond);
-		pthread_mutex_unlock(&c->work[i].work_mutex);
-
-		pos += h;
-	}
-	// wait for workers, since we need them all it does
-	// not matter in which order...
-	for( i = 0; i < c->work_num; i++ ) {
-		pthread_mutex_lock(&c->work[i].done_mutex);
-		while ( c->work[i].frame) {
-			pthread_cond_wait(&c->work[i].done_cond, &c->work[i].done_mutex);
-		}
-		pthread_mutex_unlock(&c->work[i].done_mutex);
-DBG serprintf("stop %d  %d\n", i, time_update_time() - start);
+	SLICE_POOL *pool = (SLICE_POOL*)ctx;
+	convert_job_t job = { .pixfmt = pixfmt, .data = data, .linestep = linesize, .width = width, .total_height = height, .frame = frame };
+
+	if( frame->deinterlace ) {
+		// the deinterlacer works on the whole picture
+		_convert( pixfmt, data, linesize, width, height, 0, height, frame, NULL );
+		return;
 	}
+
+	int stripe = convert_stripe & ~0x0f;
+	if( stripe < 16 )
+		stripe = 16;
+	int start = time_update_time();
+	slice_pool_run( pool, _convert_stripe, &job, height, stripe );
+DBG serprintf("convert_mt %4d lines  %d\n", height, time_update_time() - start);
 }
 
 void *codec_convert_mt_init( int work_num )
@@ -1338,44 +1478,10 @@ void *codec_convert_mt_init( int work_num )
 serprintf("cannot create convert_mt for %d\n", work_num );
 		return NULL;
 	}	
-	
-	convert_t *c = acalloc( 1, sizeof( struct convert ) );
-	
-	c->work_num = work_num;
-
-	int i;
-	for( i = 0; i < c->work_num; i++ ) {
-		c->work[i].index = i;
-		pthread_mutex_init(&c->work[i].work_mutex, NULL);
-		pthread_cond_init (&c->work[i].work_cond,  NULL);
-		pthread_mutex_init(&c->work[i].done_mutex, NULL);
-		pthread_cond_init (&c->work[i].done_cond,  NULL);
-
-		pthread_create(&c->work_thread_handle[i], 0, work_thread, (void*)&c->work[i]);
-	}
-
-	return c;
+	return slice_pool_init( work_num, "convert_mt" );
 }
 
 int codec_convert_mt_exit( void *ctx )
 {
-	convert_t *c = (convert_t*)ctx;
-	
-	if( !c )
-		return 1;
-		
-	int i;
-	for( i = 0; i < c->work_num; i++ ) {
-DBG serprintf("stop WORK %d\n", i );
-		pthread_mutex_lock(&c->work[i].work_mutex);
-		c->work[i].work_stop = 1;
-		pthread_cond_signal(&c->work[i].work_cond);
-		pthread_mutex_unlock(&c->work[i].work_mutex);
-		pthread_join(c->work_thread_handle[i], NULL);
-DBG serprintf("stop WORK %d done\n", i );
-	}
-	
-	afree( c );
-	
-	return 0;
+	return slice_pool_exit( (SLICE_POOL*)ctx );
 }
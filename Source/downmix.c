@@ -19,8 +19,10 @@
 #include "debug.h"
 #include "downmix.h"
 #include "get.h"
+#include "util.h"
 
 #include <math.h>
+#include <string.h>
 
 #define DBGCA3 	if(Debug[DBG_CA] > 2 )
 
@@ -36,6 +38,276 @@ static inline int clamp( int v )
 
 static int no_downmix = 0;
 
+/*
+	the sample format is looked at once per call, not per sample:
+	every block of DMIX_BLOCK samples is first brought into one int32 row
+	per source channel (_stage), then the rows of each side are summed,
+	shifted, clamped and interleaved into stereo S16 (_mix).
+	float samples are clamped to 16 bit per channel while staging,
+	the integer ones are shifted after summing, exactly as the per sample
+	code did before, the SSE2 kernels give the same bits as the C loops.
+*/
+#define DMIX_BLOCK	256
+
+// source channels summed into the left and right output
+typedef struct DMIX_PLAN {
+	int	count[2];
+	int	src[2][5];
+} DMIX_PLAN;
+
+static int _bytes( int fmt )
+{
+	switch( fmt ) {
+	case PCM_FMT_U8:	return 1;
+	case PCM_FMT_S16:	return 2;
+	case PCM_FMT_S24:	return 3;
+	case PCM_FMT_S32:	return 4;
+	case PCM_FMT_FLT:	return 4;
+	case PCM_FMT_DBL:	return 8;
+	}
+	return 0;
+}
+
+static int _shift( int fmt )
+{
+	return (fmt == PCM_FMT_S32) ? 16 : (fmt == PCM_FMT_S24) ? 8 : 0;
+}
+
+// ******************************************
+//
+//	_plan
+//
+//	a channel mapped to a slot that is already taken replaces
+//	the earlier one, mono plays CH_FL on both sides
+//
+// ******************************************
+static void _plan( DMIX_PLAN *plan, int channels, int *map )
+{
+	static const int slots[2][5] = {
+		{ CH_FL, CH_CTR, CH_SUB, CH_BL, CH_SL },
+		{ CH_FR, CH_CTR, CH_SUB, CH_BR, CH_SR },
+	};
+	int owner[CH_SR + 1];
+	int c, i, side;
+
+	for( i = 0; i <= CH_SR; i++ ) {
+		owner[i] = -1;
+	}
+	for( c = 0; c < channels; c++ ) {
+		owner[map[c]] = c;
+	}
+	for( side = 0; side < 2; side++ ) {
+		plan->count[side] = 0;
+		for( i = 0; i < (channels == 1 ? 1 : 5); i++ ) {
+			int slot = channels == 1 ? CH_FL : slots[side][i];
+			if( owner[slot] >= 0 ) {
+				plan->src[side][plan->count[side]++] = owner[slot];
+			}
+		}
+	}
+}
+
+#ifdef CONFIG_X86_SIMD
+
+#include "x86_simd.h"
+#include <emmintrin.h>
+
+#define TARGET_SSE2	__attribute__((target("sse2")))
+
+static int use_simd = 1;
+
+// ******************************************
+//
+//	_sse2_stage_flt
+//
+//	planar float to 16 bit range, stops at the first vector with a lane
+//	lrintf() does not simply round (NaN, |v| >= 2^31), the C loop goes on
+//
+// ******************************************
+TARGET_SSE2 static int _sse2_stage_flt( int32_t *row, const float *src, int n )
+{
+	const __m128 scale = _mm_set1_ps( 1 << 15 );
+	const __m128 limit = _mm_set1_ps( 2147483648.f );
+	const __m128 abs   = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+	int i;
+	for( i = 0; i + 8 <= n; i += 8 ) {
+		__m128 a = _mm_mul_ps( _mm_loadu_ps( src + i ), scale );
+		__m128 b = _mm_mul_ps( _mm_loadu_ps( src + i + 4 ), scale );
+		__m128 ok = _mm_and_ps( _mm_cmplt_ps( _mm_and_ps( a, abs ), limit ),
+		                        _mm_cmplt_ps( _mm_and_ps( b, abs ), limit ) );
+		if( _mm_movemask_ps( ok ) != 0xf ) {
+			break;
+		}
+		__m128i p = _mm_packs_epi32( _mm_cvtps_epi32( a ), _mm_cvtps_epi32( b ) );
+		_mm_storeu_si128( (__m128i*)(row + i),     _mm_srai_epi32( _mm_unpacklo_epi16( p, p ), 16 ) );
+		_mm_storeu_si128( (__m128i*)(row + i + 4), _mm_srai_epi32( _mm_unpackhi_epi16( p, p ), 16 ) );
+	}
+	return i;
+}
+
+// ******************************************
+//
+//	_sse2_mix
+//
+// ******************************************
+TARGET_SSE2 static int _sse2_mix( uint16_t *pcm, int32_t *rows[2][5], const int count[2], int shift, int n )
+{
+	const __m128i sh = _mm_cvtsi32_si128( shift );
+	int i, k;
+	for( i = 0; i + 8 <= n; i += 8 ) {
+		__m128i l0 = _mm_setzero_si128(), l1 = l0, r0 = l0, r1 = l0;
+		for( k = 0; k < count[0]; k++ ) {
+			l0 = _mm_add_epi32( l0, _mm_loadu_si128( (__m128i*)(rows[0][k] + i) ) );
+			l1 = _mm_add_epi32( l1, _mm_loadu_si128( (__m128i*)(rows[0][k] + i + 4) ) );
+		}
+		for( k = 0; k < count[1]; k++ ) {
+			r0 = _mm_add_epi32( r0, _mm_loadu_si128( (__m128i*)(rows[1][k] + i) ) );
+			r1 = _mm_add_epi32( r1, _mm_loadu_si128( (__m128i*)(rows[1][k] + i + 4) ) );
+		}
+		// the saturating pack is the clamp()
+		__m128i l = _mm_packs_epi32( _mm_sra_epi32( l0, sh ), _mm_sra_epi32( l1, sh ) );
+		__m128i r = _mm_packs_epi32( _mm_sra_epi32( r0, sh ), _mm_sra_epi32( r1, sh ) );
+		_mm_storeu_si128( (__m128i*)(pcm + 2 * i),     _mm_unpacklo_epi16( l, r ) );
+		_mm_storeu_si128( (__m128i*)(pcm + 2 * i + 8), _mm_unpackhi_epi16( l, r ) );
+	}
+	return i;
+}
+
+static int _simd( void )
+{
+	return use_simd && x86_simd_level() >= X86_SIMD_SSE2;
+}
+
+DECLARE_DEBUG_TOGGLE("dmsimd", use_simd );
+#endif
+
+// ******************************************
+//
+//	_stage
+//
+//	n samples of one channel into row, stride is in bytes
+//
+// ******************************************
+static void _stage( int32_t *row, const uint8_t *src, int stride, int n, int fmt )
+{
+	int i = 0;
+	switch( fmt ) {
+	case PCM_FMT_U8:
+		for( ; i < n; i++, src += stride )
+			row[i] = get8( src );
+		break;
+	case PCM_FMT_S16:
+		for( ; i < n; i++, src += stride )
+			row[i] = getS16LE( src );
+		break;
+	case PCM_FMT_S24:
+		for( ; i < n; i++, src += stride )
+			row[i] = getS24LE( src );
+		break;
+	case PCM_FMT_S32:
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		if( stride == 4 ) {
+			memcpy( row, src, n * 4 );
+			break;
+		}
+#endif
+		for( ; i < n; i++, src += stride )
+			row[i] = getS32LE( src );
+		break;
+	case PCM_FMT_FLT:
+#ifdef CONFIG_X86_SIMD
+		if( stride == 4 && _simd() ) {
+			i = _sse2_stage_flt( row, (const float*)src, n );
+			src += i * stride;
+		}
+#endif
+		for( ; i < n; i++, src += stride )
+			row[i] = clamp( lrintf( *(float*)src * (1 << 15)));
+		break;
+	case PCM_FMT_DBL:
+		for( ; i < n; i++, src += stride )
+			row[i] = clamp( lrintf( *(double*)src * (1 << 15)));
+		break;
+	default:
+		memset( row, 0, n * sizeof( int32_t ) );
+		break;
+	}
+}
+
+// ******************************************
+//
+//	_mix
+//
+// ******************************************
+static void _mix( uint16_t *pcm, int32_t *rows[2][5], const int count[2], int shift, int n )
+{
+	int i = 0, k;
+#ifdef CONFIG_X86_SIMD
+	if( _simd() ) {
+		i = _sse2_mix( pcm, rows, count, shift, n );
+		pcm += 2 * i;
+	}
+#endif
+	for( ; i < n; i++ ) {
+		// sum modulo 2^32 like the SIMD adds
+		uint32_t l = 0, r = 0;
+		for( k = 0; k < count[0]; k++ )
+			l += rows[0][k][i];
+		for( k = 0; k < count[1]; k++ )
+			r += rows[1][k][i];
+		*pcm++ = clamp( (int32_t)l >> shift );
+		*pcm++ = clamp( (int32_t)r >> shift );
+	}
+}
+
+// ******************************************
+//
+//	_downmix
+//
+// ******************************************
+static void _downmix( uint16_t *pcm, uint8_t *src[], int planar, int samples, int channels, int fmt, int *map )
+{
+	int32_t  buf[8][DMIX_BLOCK];
+	int32_t *rows[2][5];
+	int      used[8] = { 0 };
+	DMIX_PLAN plan;
+	int c, k, side, done, n;
+
+	_plan( &plan, channels, map );
+	for( side = 0; side < 2; side++ ) {
+		for( k = 0; k < plan.count[side]; k++ ) {
+			c = plan.src[side][k];
+			rows[side][k] = buf[c];
+			used[c] = 1;
+		}
+	}
+
+	int bytes  = _bytes( fmt );
+	int shift  = _shift( fmt );
+	int stride = planar ? bytes : bytes * channels;
+
+	for( done = 0; done < samples; done += n ) {
+		n = MIN( DMIX_BLOCK, samples - done );
+		for( c = 0; c < channels; c++ ) {
+			if( used[c] ) {
+				const uint8_t *p = planar ? src[c] + done * bytes : src[0] + (done * channels + c) * bytes;
+				_stage( buf[c], p, stride, n, fmt );
+			}
+		}
+		_mix( pcm + 2 * done, rows, plan.count, shift, n );
+	}
+}
+
+static int _int_fmt( int bits )
+{
+	return (bits == 16) ? PCM_FMT_S16 : (bits == 24) ? PCM_FMT_S24 : (bits == 32) ? PCM_FMT_S32 : PCM_FMT_NONE;
+}
+
+static int _float_fmt( int bits )
+{
+	return (bits == 32) ? PCM_FMT_FLT : (bits == 64) ? PCM_FMT_DBL : PCM_FMT_NONE;
+}
+
 // ******************************************
 //
 //	downmix
@@ -47,36 +319,7 @@ DBGCA3 serprintf("dmix: num %5d  ch %d  bits %d\r\n", samples, channels, bits );
 	if ( no_downmix || !pcm || !src || channels > 8 ) {
 		return;
 	}
-	
-	int shift = (bits == 32) ? 16 : (bits == 24 ) ? 8 : 0;
-	int i;
-	for( i = 0; i < samples; i ++ ) {
-		int32_t ch[9] = { 0 };
-		if( channels == 1 ) {
-			if( bits == 16 ) {
-				ch[map[0]] = getS16LE( src ); src += 2;
-			} else if( bits == 24 ) {
-				ch[map[0]] = getS24LE( src ); src += 3;
-			} else if( bits == 32 ) {
-				ch[map[0]] = getS32LE( src ); src += 4;
-			} 
-			*pcm++ = clamp( ch[CH_FL] >> shift );
-			*pcm++ = clamp( ch[CH_FL] >> shift );
-		} else {
-			int c;
-			for( c = 0; c < channels; c++ ) {
-				if( bits == 16 ) {
-					ch[map[c]] = getS16LE( src ); src += 2;
-				} else if( bits == 24 ) {
-					ch[map[c]] = getS24LE( src ); src += 3;
-				} else if( bits == 32 ) {
-					ch[map[c]] = getS32LE( src ); src += 4;
-				}
-			}
-			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) >> shift ); // left
-			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) >> shift ); // right
-		}
-	}
+	_downmix( pcm, &src, 0, samples, channels, _int_fmt( bits ), map );
 }
 
 // ******************************************
@@ -90,43 +333,7 @@ DBGCA3 serprintf("dmixP: num %5d  ch %d  bits %d\r\n", samples, channels, bits )
 	if ( no_downmix || !pcm || !_src || channels > 8 ) {
 		return;
 	}
-	
-	uint8_t *src[8];
-	int c;
-	for( c = 0; c < channels; c++ ) {
-		src[c] = _src[c];
-	}
-
-	int shift = (bits == 32) ? 16 : (bits == 24 ) ? 8 : 0;
-	int i;
-
-	for( i = 0; i < samples; i ++ ) {
-		int32_t ch[9] = { 0 };
-		if( channels == 1 ) {
-			if( bits == 16 ) {
-				ch[map[0]] = getS16LE( src[0] ); src[0] += 2;
-			} else if( bits == 24 ) {
-				ch[map[0]] = getS24LE( src[0] ); src[0] += 3;
-			} else if( bits == 32 ) {
-				ch[map[0]] = getS32LE( src[0] ); src[0] += 4;
-			} 
-			*pcm++ = clamp( ch[CH_FL] >> shift );
-			*pcm++ = clamp( ch[CH_FL] >> shift );
-		} else {
-			int c;
-			for( c = 0; c < channels; c++ ) {
-				if( bits == 16 ) {
-					ch[map[c]] = getS16LE( src[c] ); src[c] += 2;
-				} else if( bits == 24 ) {
-					ch[map[c]] = getS24LE( src[c] ); src[c] += 3;
-				} else if( bits == 32 ) {
-					ch[map[c]] = getS32LE( src[c] ); src[c] += 4;
-				}
-			}
-			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) >> shift ); // left
-			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) >> shift ); // right
-		}
-	}
+	_downmix( pcm, _src, 1, samples, channels, _int_fmt( bits ), map );
 }
 
 void downmix_float( uint16_t *pcm, uint8_t *src, int samples, int channels, int bits, int *map )
@@ -135,31 +342,7 @@ DBGCA3 serprintf("dmix_flt: num %5d  ch %d  bits %d\r\n", samples, channels, bit
 	if ( no_downmix || !pcm || !src || channels > 8 ) {
 		return;
 	}
-	
-	int i;
-	for( i = 0; i < samples; i ++ ) {
-		int32_t ch[9] = { 0 };
-		if( channels == 1 ) {
-			if( bits == 32 ) {
-				ch[map[0]] = clamp( lrintf( *(float*)src * (1 << 15))); src += 4;
-			} else if ( bits == 64 ) {
-				ch[map[0]] = clamp( lrintf( *(double*)src * (1 << 15))); src += 8;
-			}
-			*pcm++ = clamp( ch[CH_FL] );
-			*pcm++ = clamp( ch[CH_FL] );
-		} else {
-			int c;
-			for( c = 0; c < channels; c++ ) {
-				if( bits == 32 ) {
-					ch[map[c]] = clamp( lrintf( *(float*)src * (1 << 15))); src += 4;
-				} else if( bits == 64 ) {
-					ch[map[c]] = clamp( lrintf( *(double*)src * (1 << 15))); src += 8;
-				}  
-			}
-			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) ); // left
-			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) ); // right
-		}
-	}
+	_downmix( pcm, &src, 0, samples, channels, _float_fmt( bits ), map );
 }
 
 void downmix_float_planar( uint16_t *pcm, uint8_t *_src[], int samples, int channels, int bits, int *map )
@@ -168,40 +351,51 @@ DBGCA3 serprintf("dmix_fltP: num %5d  ch %d  bits %d\r\n", samples, channels, bi
 	if ( no_downmix || !pcm || !_src || channels > 8 ) {
 		return;
 	}
-	
-	uint8_t *src[8];
-	int c;
-	for( c = 0; c < channels; c++ ) {
-		src[c] = _src[c];
-	}
+	_downmix( pcm, _src, 1, samples, channels, _float_fmt( bits ), map );
+}
 
-	int i;
-	for( i = 0; i < samples; i ++ ) {
-		int32_t ch[9] = { 0 };
-		if( channels == 1 ) {
-			if( bits == 32 ) {
-				ch[map[0]] = clamp( lrintf( *(float*)src[0] * (1 << 15))); src[0] += 4;
-			} else if ( bits == 64 ) {
-				ch[map[0]] = clamp( lrintf( *(double*)src[0] * (1 << 15))); src[0] += 8;
+// ******************************************
+//
+//	pcm_convert_S16
+//
+// ******************************************
+void pcm_convert_S16( int16_t *dst, int dst_channels, uint8_t *src[], int planar, int samples, int channels, int fmt )
+{
+	int32_t buf[2][DMIX_BLOCK];
+	int bytes  = _bytes( fmt );
+	int shift  = _shift( fmt );
+	int stride = planar ? bytes : bytes * channels;
+	int c, i, done, n;
+
+	for( done = 0; done < samples; done += n ) {
+		n = MIN( DMIX_BLOCK, samples - done );
+		int16_t *out = dst + done * dst_channels;
+
+		if( channels == 2 && dst_channels == 2 ) {
+			// plain interleave, one row per side
+			int32_t *rows[2][5] = { { buf[0] }, { buf[1] } };
+			static const int count[2] = { 1, 1 };
+			for( c = 0; c < 2; c++ ) {
+				_stage( buf[c], planar ? src[c] + done * bytes : src[0] + (done * 2 + c) * bytes, stride, n, fmt );
 			}
-			*pcm++ = clamp( ch[CH_FL] );
-			*pcm++ = clamp( ch[CH_FL] );
-		} else {
-			int c;
-			for( c = 0; c < channels; c++ ) {
-				if( bits == 32 ) {
-					ch[map[c]] = clamp( lrintf( *(float*)src[c] * (1 << 15))); src[c] += 4; 
-				} else if( bits == 64 ) {
-					ch[map[c]] = clamp( lrintf( *(double*)src[c] * (1 << 15))); src[c] += 8;
-				}  
+			_mix( (uint16_t*)out, rows, count, shift, n );
+			continue;
+		}
+
+		for( c = 0; c < dst_channels; c++ ) {
+			int16_t *o = out + c;
+			if( c < channels ) {
+				_stage( buf[0], planar ? src[c] + done * bytes : src[0] + (done * channels + c) * bytes, stride, n, fmt );
+				for( i = 0; i < n; i++, o += dst_channels )
+					*o = clamp( buf[0][i] >> shift );
+			} else {
+				for( i = 0; i < n; i++, o += dst_channels )
+					*o = 0;
 			}
-			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) ); // left
-			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) ); // right
 		}
 	}
 }
 
-
 #ifdef DEBUG_MSG
 static void _no_downmix( void )
 {
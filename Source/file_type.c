@@ -25,6 +25,7 @@
 #include "stream_config.h"
 
 #include <ctype.h>
+#include <pthread.h>
 
 #define DBG if(Debug[DBG_FILE])
 
@@ -441,7 +442,169 @@ static struct file_icon_str file_icon[] =
 
 #endif
 
+// ************************************************************
+//
+//	extension and mime type hashes
+//
+// ************************************************************
+/*
+	the media scanner classifies every path through these lookups.
+	file_type[] depends on the CONFIG_ flags, so the hashes are built
+	from the compiled table on first use: the seed is searched until
+	every distinct key has a slot of its own, a lookup is one hash and
+	one compare. entries with the same extension are chained in table
+	order for the is_allowed fallthrough, a mime type maps to the first
+	entry listing it.
+*/
+#define FILE_TYPES	( sizeof( file_type ) / sizeof( FILE_TYPE ) )
+#define FT_HASH_MAX	1024
+#define FT_HASH_SEEDS	1000
+
+typedef struct {
+	const char	*key;
+	short		index;		// into file_type[]
+} FT_SLOT;
+
+typedef struct {
+	unsigned	seed;
+	unsigned	mask;		// 0 if not built, lookups scan the table
+	int		nocase;
+	FT_SLOT		slot[FT_HASH_MAX];
+} FT_HASH;
+
+static FT_HASH		ext_hash;
+static FT_HASH		mime_hash;
+static short		ext_next[FILE_TYPES];	// next entry with the same extension, -1 for none
+static pthread_once_t	hash_once = PTHREAD_ONCE_INIT;
+
+static unsigned _hash( const char *s, unsigned seed, int nocase )
+{
+	unsigned h = 2166136261u ^ seed;
+	while( *s ) {
+		unsigned char c = *s++;
+		h = ( h ^ ( nocase ? toupper( c ) : c ) ) * 16777619u;
+	}
+	return h ^ ( h >> 15 );
+}
+
+static int _hash_try( FT_HASH *h, FT_SLOT *keys, int n )
+{
+	int i;
+	memset( h->slot, 0, sizeof( h->slot ) );
+	for( i = 0; i < n; i++ ) {
+		FT_SLOT *slot = h->slot + ( _hash( keys[i].key, h->seed, h->nocase ) & h->mask );
+		if( slot->key )
+			return 1;
+		*slot = keys[i];
+	}
+	return 0;
+}
+
+// keys must be distinct
+static void _hash_build( FT_HASH *h, FT_SLOT *keys, int n, int nocase )
+{
+	unsigned size;
+
+	h->nocase = nocase;
+	for( size = 16; size < 2 * n; size *= 2 )
+		;
+	for( ; size <= FT_HASH_MAX; size *= 2 ) {
+		h->mask = size - 1;
+		for( h->seed = 0; h->seed < FT_HASH_SEEDS; h->seed++ ) {
+			if( !_hash_try( h, keys, n ) ) {
+DBG serprintf("file_type: %d keys in %d slots, seed %d\r\n", n, size, h->seed );
+				return;
+			}
+		}
+	}
+serprintf("file_type: no perfect hash for %d keys\r\n", n );
+	h->mask = 0;
+}
+
+static void _hash_init( void )
+{
+	static FT_SLOT keys[FT_HASH_MAX];
+	short last[FILE_TYPES];
+	int i, j, k, n;
+
+	// extensions, case insensitive
+	n = 0;
+	for( i = 0; i < FILE_TYPES; i++ ) {
+		ext_next[i] = -1;
+		for( k = 0; k < n; k++ ) {
+			if( !strcmpNC( file_type[i].ext, keys[k].key ) )
+				break;
+		}
+		if( k < n ) {
+			ext_next[last[k]] = i;
+			last[k] = i;
+		} else if( n < FT_HASH_MAX ) {
+			keys[n].key   = file_type[i].ext;
+			keys[n].index = i;
+			last[n++] = i;
+		}
+	}
+	_hash_build( &ext_hash, keys, n, 1 );
+
+	// mime types, the first entry wins
+	n = 0;
+	for( i = 0; i < FILE_TYPES; i++ ) {
+		for( j = 0; file_type[i].mime_type && file_type[i].mime_type[j]; j++ ) {
+			for( k = 0; k < n; k++ ) {
+				if( !strcmp( file_type[i].mime_type[j], keys[k].key ) )
+					break;
+			}
+			if( k == n && n < FT_HASH_MAX ) {
+				keys[n].key   = file_type[i].mime_type[j];
+				keys[n].index = i;
+				n++;
+			}
+		}
+	}
+	_hash_build( &mime_hash, keys, n, 0 );
+}
+
+// first entry with this extension, -1 if none
+static int _ext_index( const char *ext )
+{
+	pthread_once( &hash_once, _hash_init );
+
+	if( ext_hash.mask ) {
+		FT_SLOT *slot = ext_hash.slot + ( _hash( ext, ext_hash.seed, 1 ) & ext_hash.mask );
+		return slot->key && !strcmpNC( ext, slot->key ) ? slot->index : -1;
+	}
+
+	int i;
+	for( i = 0; i < FILE_TYPES; i++ ) {
+		if( !strcmpNC( ext, file_type[i].ext ) )
+			return i;
+	}
+	return -1;
+}
+
+// first entry listing this mime type, -1 if none
+static int _mime_index( const char *mime_type )
+{
+	pthread_once( &hash_once, _hash_init );
+
+	if( mime_hash.mask ) {
+		FT_SLOT *slot = mime_hash.slot + ( _hash( mime_type, mime_hash.seed, 0 ) & mime_hash.mask );
+		return slot->key && !strcmp( mime_type, slot->key ) ? slot->index : -1;
+	}
+
+	int i, j;
+	for( i = 0; i < FILE_TYPES; i++ ) {
+		for( j = 0; file_type[i].mime_type && file_type[i].mime_type[j]; j++ ) {
+			if( !strcmp( mime_type, file_type[i].mime_type[j] ) )
+				return i;
+		}
+	}
+	return -1;
+}
+
 static FILETYPE_REG *_filetype_reg = NULL;
+// the first registration of each type, the list is only walked for types out of range
+static FILETYPE_REG *_filetype_reg_by_type[TYPE_ANY + 1];
 
 // ************************************************************
 //
@@ -460,6 +623,8 @@ int filetype_register( FILETYPE_REG *reg )
 		head->next = reg;
 	}
 	reg->next = NULL;
+	if( reg->type >= 0 && reg->type <= TYPE_ANY && !_filetype_reg_by_type[reg->type] )
+		_filetype_reg_by_type[reg->type] = reg;
 	return 0;
 }
 
@@ -471,6 +636,9 @@ int filetype_register( FILETYPE_REG *reg )
 FILETYPE_REG* filetype_get_reg( int type )
 {
 DBG serprintf("filetype_get_reg( type %d )\r\n", type ); 
+	if( type >= 0 && type <= TYPE_ANY )
+		return _filetype_reg_by_type[type];
+
 	FILETYPE_REG *p = _filetype_reg;
 	while( p ) {
 		if( type == p->type ) {
@@ -547,27 +715,25 @@ int get_file_type_from_ext( const char *ext, int *_type, int *_etype, const char
 		return 1;
 		
 	int i;
-	for( i = 0; i < sizeof( file_type ) / sizeof( FILE_TYPE ); i++ ) {
-		if( !strcmpNC( ext, file_type[i].ext ) ) {
-			// is this type allowed?
-			if( file_type[i].is_allowed && !file_type[i].is_allowed( file_type[i].type, file_type[i].etype ) ) {
-				continue;
-			}
-			if( _type )
-				*_type = file_type[i].type;
-			if( _etype )
-				*_etype = file_type[i].etype;
-			if( _mime ) {
-				if( file_type[i].mime_type && file_type[i].mime_type[0] )
-					*_mime = file_type[i].mime_type[0];
-				else
-					*_mime = "";
-			}
-			if( _probe )
-				*_probe = file_type[i].probe;
-DBG serprintf("%s: detected file as %s\n", __FUNCTION__, file_type[i].name);
-			return 0;
+	for( i = _ext_index( ext ); i >= 0; i = ext_next[i] ) {
+		// is this type allowed?
+		if( file_type[i].is_allowed && !file_type[i].is_allowed( file_type[i].type, file_type[i].etype ) ) {
+			continue;
 		}
+		if( _type )
+			*_type = file_type[i].type;
+		if( _etype )
+			*_etype = file_type[i].etype;
+		if( _mime ) {
+			if( file_type[i].mime_type && file_type[i].mime_type[0] )
+				*_mime = file_type[i].mime_type[0];
+			else
+				*_mime = "";
+		}
+		if( _probe )
+			*_probe = file_type[i].probe;
+DBG serprintf("%s: detected file as %s\n", __FUNCTION__, file_type[i].name);
+		return 0;
 	}
 	return 1;
 }
@@ -708,22 +874,16 @@ int get_file_type_from_mime_type(const char *mime_type, int *type, int *etype)
 	if (mime_type == NULL)
 		return 1;
 	
-	int i;
-	for( i = 0; i < sizeof( file_type ) / sizeof( FILE_TYPE ); i++ ) {
-		int j = 0;
-		while ( file_type[i].mime_type && file_type[i].mime_type[j] ) {
-			if ( !strcmp(mime_type, file_type[i].mime_type[j]) ) {
-				if ( type ) {
-					*type = file_type[i].type;
-				}
-				if ( etype ) {
-					*etype = file_type[i].etype;
-				}
-DBG serprintf("%s: detected file as type/etype %d/%d  ext %s  name %s\n", __FUNCTION__, file_type[i].type, file_type[i].etype, file_type[i].ext, file_type[i].name);
-				return 0;
-			}
-			++j;
+	int i = _mime_index( mime_type );
+	if( i >= 0 ) {
+		if ( type ) {
+			*type = file_type[i].type;
+		}
+		if ( etype ) {
+			*etype = file_type[i].etype;
 		}
+DBG serprintf("%s: detected file as type/etype %d/%d  ext %s  name %s\n", __FUNCTION__, file_type[i].type, file_type[i].etype, file_type[i].ext, file_type[i].name);
+		return 0;
 	}
 	
 	if( type )
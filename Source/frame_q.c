@@ -34,16 +34,38 @@ int frame_q_init( FRAME_Q *q, char *tag )
 	return 0;
 }
 
+/*
+	head/tail list with a count, only taking a frame out of the middle
+	(get_unlocked, get_index) walks it.
+	a frame carries the generation of the queue it is in, flush just starts
+	a new one: the frames still linked are not touched, they may be gone
+*/
+static unsigned _gen;
+
+static unsigned _new_gen( void )
+{
+	unsigned gen;
+	while( !(gen = __sync_add_and_fetch( &_gen, 1 )) )
+		;
+	return gen;
+}
+
 int frame_q_count( FRAME_Q *q )
 {
-	VIDEO_FRAME *frame = q->head;
-	
-	int count = 0;
-	while( frame ) {
-		count ++;
-		frame = frame->next;
-	}
-	return count;
+	return q->count;
+}
+
+// unlink frame, prev is the one before it or NULL for the head
+static void _unlink( FRAME_Q *q, VIDEO_FRAME *prev, VIDEO_FRAME *frame )
+{
+	if( prev )
+		prev->next = frame->next;
+	else
+		q->head = frame->next;
+	if( q->tail == frame )
+		q->tail = prev;
+	frame->queued = 0;
+	q->count --;
 }
 
 VIDEO_FRAME *frame_q_get( FRAME_Q *q )
@@ -52,7 +74,7 @@ VIDEO_FRAME *frame_q_get( FRAME_Q *q )
 	
 	if( frame ) {
 DBGQ serprintf(" GET( %s %2d ) ", q->tag, frame->index ); 
-		q->head = frame->next;
+		_unlink( q, NULL, frame );
 	}
 	
 	return frame;
@@ -60,19 +82,15 @@ DBGQ serprintf(" GET( %s %2d ) ", q->tag, frame->index );
 
 VIDEO_FRAME *frame_q_get_unlocked( FRAME_Q *q )
 {
-	VIDEO_FRAME **prev = NULL;
+	VIDEO_FRAME *prev = NULL;
 	VIDEO_FRAME *frame = q->head;
 	
 	while( frame ) {
 		if( !(frame->locked) ) {
-			if( prev )
-				*prev = frame->next;
-			else
-				q->head = frame->next;
-				
+			_unlink( q, prev, frame );
 			return frame;
 		}
-		prev = &frame->next;
+		prev = frame;
 		frame = frame->next;
 	}
 	return NULL;
@@ -80,19 +98,15 @@ VIDEO_FRAME *frame_q_get_unlocked( FRAME_Q *q )
 
 VIDEO_FRAME *frame_q_get_index( FRAME_Q *q, int index )
 {
-	VIDEO_FRAME **prev = NULL;
+	VIDEO_FRAME *prev = NULL;
 	VIDEO_FRAME *frame = q->head;
 	
 	while( frame ) {
 		if( frame->index == index ) {
-			if( prev )
-				*prev = frame->next;
-			else
-				q->head = frame->next;
-				
+			_unlink( q, prev, frame );
 			return frame;
 		}
-		prev = &frame->next;
+		prev = frame;
 		frame = frame->next;
 	}
 	return NULL;
@@ -115,29 +129,20 @@ int frame_q_put( FRAME_Q *q, VIDEO_FRAME *frame )
 	if( !frame )
 		return 1;
 		
-	if( !q->head ) {
-		q->head = frame;
-		frame->next = NULL;
 DBGQ serprintf(" PUT( %s %2d ) ", q->tag, frame->index ); 
-		return 0;
-	}
-DBGQ serprintf(" PUT( %s %2d ) ", q->tag, frame->index ); 
-
-	VIDEO_FRAME *now = q->head;
-	
-	if( now == frame ) {
+	if( frame->queued == q->gen ) {
 serprintf("frame_q_put: FATAL ERROR: %d already in [%s]\r\n", frame->index, q->tag );
 		return 1;
 	}
-	while( now->next ) {
-		now = now->next;	
-		if( now == frame ) {
-serprintf("frame_q_put: FATAL ERROR: %d already in [%s]\r\n", frame->index, q->tag );
-			return 1;
-		}
-	}
-	now->next   = frame;
-	frame->next = NULL;
+
+	if( q->tail )
+		q->tail->next = frame;
+	else
+		q->head = frame;
+	q->tail = frame;
+	frame->next   = NULL;
+	frame->queued = q->gen;
+	q->count ++;
 	
 	return 0;
 }
@@ -147,23 +152,22 @@ void frame_q_put_head( FRAME_Q *q, VIDEO_FRAME *frame )
 	if( !frame )
 		return;
 		
-	if( !q->head ) {
-		q->head = frame;
-		frame->next = NULL;
 DBGQ serprintf(" PUT1( %s %2d ) ", q->tag, frame->index ); 
-		return;
-	}
-DBGQ serprintf(" PUT1( %s %2d ) ", q->tag, frame->index ); 
-
-	VIDEO_FRAME *now = q->head;
+	frame->next   = q->head;
+	frame->queued = q->gen;
 	q->head = frame;
-	frame->next = now;
+	if( !q->tail )
+		q->tail = frame;
+	q->count ++;
 }
 
 void frame_q_flush( FRAME_Q *q )
 {
 DBGQ serprintf("FLUSH( %s )\r\n", q->tag ); 
-	q->head = NULL;
+	q->gen   = _new_gen();
+	q->head  = NULL;
+	q->tail  = NULL;
+	q->count = 0;
 }
 
 void frame_q_dump( FRAME_Q *q )
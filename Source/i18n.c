@@ -22,6 +22,14 @@
 #include "file.h"
 #include "astdlib.h"
 
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #ifdef CONFIG_I18N
 #define CONFIG_ALL_FONTS
 
@@ -701,9 +709,9 @@ serprintf("I18N_unload\r\n");
 }
 
 struct enc_ctx {
-	int count;
-	int score;
-	int utf8;
+	int count;	// continuation bytes seen of the current sequence
+	int score;	// continuation bytes expected for the current sequence
+	int error;
 	int total;
 };
 
@@ -721,66 +729,102 @@ void *I18N_check_encoding_init( void )
 //	U-00200000 - U-03FFFFFF:  111110xx 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx  
 //	U-04000000 - U-7FFFFFFF:  1111110x 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx  
 
-void I18N_check_encoding_update( void *ctx, const unsigned char *text, int size ) 
+// continuation bytes following a lead byte, -1 for bytes that cannot start a sequence
+static const signed char utf8_follow[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x00
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x20
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x40
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x60
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,	// 0x80
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,	// 0xA0
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	// 0xC0
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5,-1,-1,	// 0xE0
+};
+
+// ************************************************
+//
+//	_ascii_span
+//
+// ************************************************
+// length of the leading run of 16 byte blocks without any byte >= 0x80
+static int _ascii_span( const unsigned char *text, int size )
+{
+	int i = 0;
+#if defined(__SSE2__)
+	for( ; i + 16 <= size; i += 16 ) {
+		if( _mm_movemask_epi8( _mm_loadu_si128( (const __m128i*)(text + i) ) ) )
+			break;
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	for( ; i + 16 <= size; i += 16 ) {
+		if( vmaxvq_u8( vld1q_u8( text + i ) ) & 0x80 )
+			break;
+	}
+#else
+	for( ; i + 16 <= size; i += 16 ) {
+		uint64_t a, b;
+		memcpy( &a, text + i, 8 );
+		memcpy( &b, text + i + 8, 8 );
+		if( (a | b) & 0x8080808080808080ULL )
+			break;
+	}
+#endif
+	return i;
+}
+
+// returns -1 as soon as the text is known not to be UTF-8, 
+// the caller can stop feeding more data then
+int I18N_check_encoding_update( void *ctx, const unsigned char *text, int size ) 
 {
 	struct enc_ctx *c = ctx;
+	const unsigned char *end;
 	
+	if( c->error )
+		return -1;
 	if( !text )
-		return;
+		return 0;
 	
-	while( size ) {
-		unsigned char t = *text;
-		c->total ++;
-//serprintf("%02X ", t );
+	end = text + size;
+	c->total += size;
+	while( text < end ) {
 		if( c->score == 0 ) {
-			c->count = 0;
-			if( t < 0x80 ) {
-//serprintf("ascii\n");
-				c->utf8++;
-			} else if ( (t & 0xFE) == 0xFC ) {
-				c->score = 5;
-			} else if ( (t & 0xFC) == 0xF8 ) {
-				c->score = 4;
-			} else if ( (t & 0xF8) == 0xF0 ) {
-				c->score = 3;
-			} else if ( (t & 0xF0) == 0xE0 ) {
-				c->score = 2;
-			} else if ( (t & 0xE0) == 0xC0 ) {
-				c->score = 1;
-			} else {
-//serprintf("  err\n");
-				// error
+			text += _ascii_span( text, end - text );
+			if( text == end )
+				break;
+
+			int n = utf8_follow[*text++];
+			if( n < 0 ) {
+				c->error = 1;
+				return -1;
 			}
-		} else {
-//serprintf("  %d/%d", c->count, c->score);
-			if( (t & 0xC0) == 0x80 ) {
-				c->count++;
-				if( c->count == c->score ) {
-//serprintf("  utf8\n");
-					c->utf8 += c->score + 1;
-					c->score = 0;
-				} else {
-//serprintf("\n");
-				}
-			} else {
-//serprintf("  err\n");
-				// error
-				c->score = 0;
+			if( n == 0 )
+				continue;
+			c->score = n;
+			c->count = 0;
+		}
+		// continuation bytes, possibly carried over from the previous block
+		while( c->count < c->score ) {
+			if( text == end )
+				return 0;
+			if( (*text++ & 0xC0) != 0x80 ) {
+				c->error = 1;
+				return -1;
 			}
+			c->count++;
 		}
-		text ++;
-		size --;
+		c->score = 0;
 	}
 	
-	return;
+	return 0;
 }
 
 void I18N_check_encoding_finish( void *ctx, int *utf8 )
 {
 	struct enc_ctx *c = ctx;
-serprintf("total: %d  utf %d  ", c->total, c->utf8 );
+serprintf("total: %d  error %d  ", c->total, c->error );
 	// do not allow any error, all chars must conform to UTF-8!
-	if( c->utf8 == c->total ) {
+	// a sequence cut at the end of the text is an error as well
+	if( !c->error && !c->score ) {
 serprintf("UTF8!\n");		
 		*utf8 = 1;
 	} else {
@@ -15,6 +15,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "global.h"
 #include "log.h"
@@ -33,6 +34,7 @@
 
 #ifdef CONFIG_ANDROID
 #include "jni.h"
+#include "androidndk_utils.h"
 
 JavaVM *myVm = NULL;
 jobject myClassLoader;
@@ -105,8 +107,32 @@ void libavos_debug_exit()
 	avos_clean_files();
 }
 
+// serprintf() is gone in release builds, answers go to logcat or stdout
+static void libavos_avsh_output(const char *text)
+{
+#ifdef CONFIG_ANDROID
+	while (*text) {
+		int len = strcspn(text, "\n");
+		android_log_print(ANDROID_LOG_INFO, "avos", "%.*s", len, text);
+		text += len;
+		if (*text)
+			text++;
+	}
+#else
+	fputs(text, stdout);
+	fflush(stdout);
+#endif
+}
+
 void libavos_avsh(const char *cmd)
 {
+	// the only command of release builds
+	if (!strncmp(cmd, "stats", 5)) {
+		char stats[4096];
+		stream_stats_print_all(stats, sizeof(stats));
+		libavos_avsh_output(stats);
+		return;
+	}
 #ifdef DEBUG_MSG
 	serprintf("\n-------------------------------------------------------\n");
 	debug_do_cmd(cmd);
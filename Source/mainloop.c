@@ -25,11 +25,12 @@
 #define MAX_TIMERS 32
 
 static Timer gui_timer_data[MAX_TIMERS];
+static Timer *gui_timer_heap[MAX_TIMERS];
 
 Timers gui_timers = {
 	.mutex = PTHREAD_MUTEX_INITIALIZER,
 	.data  = gui_timer_data,
-	.dummy = { 0, 0, 0, NULL, "" },
+	.heap  = gui_timer_heap,
 	.size  = MAX_TIMERS,
 	.cnt   = 0
 };
@@ -0,0 +1,353 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "global.h"
+#include "types.h"
+#include "debug.h"
+#include "util.h"
+#include "astdlib.h"
+#include "device_config.h"
+#include "media_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#define DBG if(0)
+
+#define MEDIA_CACHE_MAGIC	0x434D5641	// "AVMC"
+#define MEDIA_CACHE_VERSION	1
+#define MEDIA_CACHE_MAX_DATA	(16 * 1024 * 1024)
+#define MEDIA_CACHE_MAX_PATH	1024
+
+typedef struct MEDIA_CACHE_HEADER {
+	UINT32	magic;
+	UINT32	version;
+	UINT64	file_size;
+	INT64	file_mtime;
+	UINT32	path_len;
+	UINT32	data_size;
+} MEDIA_CACHE_HEADER;
+
+static int  use_media_cache = 1;
+static int  media_cache_max = 32;	// MB, the oldest entries go first
+static char cache_dir[256];		// under cache_dir_mutex, thumbnail workers come in parallel
+static pthread_mutex_t cache_dir_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int  stores;			// __sync_* only
+
+DECLARE_DEBUG_TOGGLE("mcache", use_media_cache );
+DECLARE_DEBUG_PARAM ("mcmax",  media_cache_max );
+
+// ************************************************************
+//
+//	media_cache_set_dir
+//
+// ************************************************************
+void media_cache_set_dir( const char *dir )
+{
+	pthread_mutex_lock( &cache_dir_mutex );
+	strnZcpy( cache_dir, dir ? dir : "", sizeof( cache_dir ) - 1 );
+	pthread_mutex_unlock( &cache_dir_mutex );
+}
+
+// ************************************************************
+//
+//	_get_dir
+//
+// ************************************************************
+// set up cache_dir once, call with cache_dir_mutex held
+static const char *_find_dir( void )
+{
+	if( !cache_dir[0] ) {
+#ifdef CONFIG_ANDROID
+		const char *pkg = device_config_get_android_pkg_name();
+		if( !pkg || !pkg[0] )
+			return NULL;
+		snprintf( cache_dir, sizeof( cache_dir ), "/data/data/%s/cache", pkg );
+#else
+		// per user, never a shared directory: the entries are fed to the demuxer
+		const char *xdg  = getenv( "XDG_CACHE_HOME" );
+		const char *home = getenv( "HOME" );
+		char base[200];
+		if( xdg && xdg[0] == '/' ) {
+			strnZcpy( base, xdg, sizeof( base ) - 1 );
+		} else if( home && home[0] == '/' ) {
+			snprintf( base, sizeof( base ), "%s/.cache", home );
+		} else {
+			return NULL;
+		}
+		mkdir( base, 0700 );
+		snprintf( cache_dir, sizeof( cache_dir ), "%s/avos", base );
+		if( mkdir( cache_dir, 0700 ) && errno != EEXIST ) {
+			cache_dir[0] = '\0';
+			return NULL;
+		}
+
+		struct stat st;
+		if( lstat( cache_dir, &st ) || !S_ISDIR( st.st_mode ) || st.st_uid != getuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) ) {
+serprintf("media_cache: %s is not a private directory, no cache\r\n", cache_dir );
+			cache_dir[0] = '\0';
+			return NULL;
+		}
+#endif
+	}
+	return cache_dir;
+}
+
+// copies the directory out, it may change under us once the lock is gone
+static int _get_dir( char *dir, int max )
+{
+	pthread_mutex_lock( &cache_dir_mutex );
+	const char *d = _find_dir();
+	if( d )
+		strnZcpy( dir, d, max - 1 );
+	pthread_mutex_unlock( &cache_dir_mutex );
+	return d == NULL;
+}
+
+// ************************************************************
+//
+//	_evict
+//
+// ************************************************************
+typedef struct CACHE_ENTRY {
+	char	name[64];
+	time_t	mtime;
+	off_t	size;
+} CACHE_ENTRY;
+
+static int _cmp_mtime( const void *a, const void *b )
+{
+	const CACHE_ENTRY *ea = a, *eb = b;
+	return ea->mtime < eb->mtime ? -1 : ea->mtime > eb->mtime;
+}
+
+// keeps the directory under media_cache_max MB, the least recently
+// used entries (a hit touches the entry) are removed first
+static void _evict( const char *dir )
+{
+	DIR *d = opendir( dir );
+	struct dirent *de;
+	CACHE_ENTRY *e = NULL;
+	int num = 0, max = 0, i;
+	off_t total = 0, limit = (off_t)media_cache_max << 20;
+
+	if( !d )
+		return;
+	while( (de = readdir( d )) ) {
+		struct stat st;
+		if( strncmp( de->d_name, "avos_", 5 ) || strlen( de->d_name ) >= sizeof( e->name ) )
+			continue;
+		if( fstatat( dirfd( d ), de->d_name, &st, AT_SYMLINK_NOFOLLOW ) || !S_ISREG( st.st_mode ) )
+			continue;
+		if( num == max ) {
+			CACHE_ENTRY *n = arealloc( e, ( max = max ? 2 * max : 64 ) * sizeof( CACHE_ENTRY ) );
+			if( !n )
+				break;
+			e = n;
+		}
+		strcpy( e[num].name, de->d_name );
+		e[num].mtime = st.st_mtime;
+		e[num].size  = st.st_size;
+		total += st.st_size;
+		num++;
+	}
+
+	if( total > limit ) {
+		// down to 3/4, not again with the next store
+		qsort( e, num, sizeof( CACHE_ENTRY ), _cmp_mtime );
+		for( i = 0; i < num && total > limit / 4 * 3; i++ ) {
+			if( !unlinkat( dirfd( d ), e[i].name, 0 ) )
+				total -= e[i].size;
+		}
+DBG serprintf("media_cache: evicted %d entries\r\n", i );
+	}
+	closedir( d );
+	afree( e );
+}
+
+// ************************************************************
+//
+//	_get_key
+//
+// ************************************************************
+// builds the cache file name and fills in the key of the media file
+static int _get_key( const char *kind, const char *path, char *name, int max, MEDIA_CACHE_HEADER *h )
+{
+	struct stat st;
+	char dir[256];
+
+	if( !use_media_cache || !path || path[0] != '/' )
+		return 1;
+	if( _get_dir( dir, sizeof( dir ) ) )
+		return 1;
+	if( stat( path, &st ) || !S_ISREG( st.st_mode ) )
+		return 1;
+
+	// FNV-1a, the full path is stored in the entry to catch collisions
+	UINT64 hash = 0xcbf29ce484222325ULL;
+	const unsigned char *p = (const unsigned char *)path;
+	while( *p ) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	snprintf( name, max, "%s/avos_%s_%016llx", dir, kind, (unsigned long long)hash );
+
+	memset( h, 0, sizeof( *h ) );
+	h->magic      = MEDIA_CACHE_MAGIC;
+	h->version    = MEDIA_CACHE_VERSION;
+	h->file_size  = st.st_size;
+	h->file_mtime = st.st_mtime;
+	h->path_len   = strlen( path );
+	return 0;
+}
+
+// ************************************************************
+//
+//	media_cache_load
+//
+// ************************************************************
+int media_cache_load( const char *kind, const char *path, void **data, int *size )
+{
+	char name[512];
+	char entry_path[MEDIA_CACHE_MAX_PATH];
+	MEDIA_CACHE_HEADER key, h;
+
+	*data = NULL;
+	*size = 0;
+	if( _get_key( kind, path, name, sizeof( name ), &key ) )
+		return 1;
+
+	int fd = open( name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+	if( fd < 0 ) {
+DBG serprintf("media_cache: miss %s %s\r\n", kind, path );
+		return 1;
+	}
+
+	// only our own entries, nobody else may have written them
+	struct stat st;
+	if( fstat( fd, &st ) || !S_ISREG( st.st_mode ) || st.st_uid != getuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) ) {
+serprintf("media_cache: ignoring foreign entry %s\r\n", name );
+		close( fd );
+		return 1;
+	}
+
+	FILE *f = fdopen( fd, "rb" );
+	if( !f ) {
+		close( fd );
+		return 1;
+	}
+
+	int ret = 1;
+	if( fread( &h, sizeof( h ), 1, f ) != 1 )
+		goto end;
+	if( h.magic != key.magic || h.version != key.version || h.path_len != key.path_len || h.path_len >= MEDIA_CACHE_MAX_PATH )
+		goto end;
+	if( h.file_size != key.file_size || h.file_mtime != key.file_mtime ) {
+DBG serprintf("media_cache: stale %s %s\r\n", kind, path );
+		goto end;
+	}
+	if( fread( entry_path, 1, h.path_len, f ) != h.path_len || memcmp( entry_path, path, h.path_len ) )
+		goto end;
+	if( !h.data_size || h.data_size > MEDIA_CACHE_MAX_DATA )
+		goto end;
+	if( !(*data = amalloc( h.data_size )) )
+		goto end;
+	if( fread( *data, 1, h.data_size, f ) != h.data_size ) {
+		afree( *data );
+		*data = NULL;
+		goto end;
+	}
+	*size = h.data_size;
+	ret = 0;
+	// the mtime is the last use for _evict()
+	futimens( fd, NULL );
+DBG serprintf("media_cache: hit %s %s (%d bytes)\r\n", kind, path, *size );
+end:
+	fclose( f );
+	return ret;
+}
+
+// ************************************************************
+//
+//	media_cache_store
+//
+// ************************************************************
+int media_cache_store( const char *kind, const char *path, const void *data, int size )
+{
+	char name[512];
+	char tmp[520];
+	MEDIA_CACHE_HEADER h;
+
+	if( !data || size <= 0 || size > MEDIA_CACHE_MAX_DATA )
+		return 1;
+	if( _get_key( kind, path, name, sizeof( name ), &h ) )
+		return 1;
+	h.data_size = size;
+
+	// write to a temporary file first, readers never see a partial entry
+	snprintf( tmp, sizeof( tmp ), "%s.XXXXXX", name );
+	int fd = mkstemp( tmp );
+	if( fd < 0 ) {
+DBG serprintf("media_cache: cannot create %s\r\n", tmp );
+		return 1;
+	}
+	FILE *f = fdopen( fd, "wb" );
+	if( !f ) {
+		close( fd );
+		unlink( tmp );
+		return 1;
+	}
+	int err = 0;
+	err |= fwrite( &h, sizeof( h ), 1, f ) != 1;
+	err |= fwrite( path, 1, h.path_len, f ) != h.path_len;
+	err |= fwrite( data, 1, size, f ) != size;
+	err |= fclose( f ) != 0;
+
+	if( err || rename( tmp, name ) ) {
+serprintf("media_cache: cannot write %s\r\n", name );
+		unlink( tmp );
+		return 1;
+	}
+DBG serprintf("media_cache: stored %s %s (%d bytes)\r\n", kind, path, size );
+
+	// a directory scan, not for every store
+	char dir[256];
+	if( !(__sync_fetch_and_add( &stores, 1 ) % 16) && !_get_dir( dir, sizeof( dir ) ) )
+		_evict( dir );
+	return 0;
+}
+
+// ************************************************************
+//
+//	media_cache_remove
+//
+// ************************************************************
+void media_cache_remove( const char *kind, const char *path )
+{
+	char name[512];
+	MEDIA_CACHE_HEADER h;
+
+	if( !_get_key( kind, path, name, sizeof( name ), &h ) ) {
+		unlink( name );
+	}
+}
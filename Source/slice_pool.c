@@ -0,0 +1,195 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "global.h"
+#include "types.h"
+#include "debug.h"
+#include "util.h"
+#include "astdlib.h"
+#include "athread.h"
+#include "slice_pool.h"
+
+#include <pthread.h>
+
+#define DBG if(0)
+
+struct SLICE_POOL {
+	int		workers;
+	pthread_t	thread[SLICE_POOL_MAX_WORKERS];
+
+	pthread_mutex_t	mutex;
+	pthread_cond_t	work_cond;
+	pthread_cond_t	done_cond;
+	int		stop;
+	unsigned int	job;		// bumped for every run
+	int		active;		// workers inside the current run
+
+	// current run, only written while no worker is active
+	SLICE_FUNC	func;
+	void		*arg;
+	int		height;
+	int		stripe;
+	int		stripes;
+	volatile int	next;		// next stripe to hand out
+	volatile int	left;		// stripes not finished yet
+};
+
+// ************************************************************
+//
+//	_do_stripes
+//
+// ************************************************************
+static void _do_stripes( SLICE_POOL *p )
+{
+	while( 1 ) {
+		int i = __sync_fetch_and_add( &p->next, 1 );
+		if( i >= p->stripes )
+			break;
+		int start  = i * p->stripe;
+		int height = p->height - start < p->stripe ? p->height - start : p->stripe;
+		p->func( p->arg, start, height );
+		__sync_fetch_and_sub( &p->left, 1 );
+	}
+}
+
+// ************************************************************
+//
+//	_worker
+//
+// ************************************************************
+static void *_worker( void *ctx )
+{
+	SLICE_POOL *p = (SLICE_POOL*)ctx;
+	unsigned int seen = 0;
+
+	pthread_mutex_lock( &p->mutex );
+	while( !p->stop ) {
+		// only join a run that still has work, a late wakeup
+		// must not touch the next run while its parameters change
+		if( seen == p->job || !p->left ) {
+			seen = p->job;
+			pthread_cond_wait( &p->work_cond, &p->mutex );
+			continue;
+		}
+		seen = p->job;
+		p->active++;
+		pthread_mutex_unlock( &p->mutex );
+
+		_do_stripes( p );
+
+		pthread_mutex_lock( &p->mutex );
+		if( !--p->active && !p->left )
+			pthread_cond_signal( &p->done_cond );
+	}
+	pthread_mutex_unlock( &p->mutex );
+	return NULL;
+}
+
+// ************************************************************
+//
+//	slice_pool_run
+//
+// ************************************************************
+void slice_pool_run( SLICE_POOL *p, SLICE_FUNC func, void *arg, int height, int stripe )
+{
+	if( height <= 0 )
+		return;
+	if( stripe <= 0 )
+		stripe = height;
+
+	pthread_mutex_lock( &p->mutex );
+	p->func    = func;
+	p->arg     = arg;
+	p->height  = height;
+	p->stripe  = stripe;
+	p->stripes = (height + stripe - 1) / stripe;
+	p->left    = p->stripes;
+	p->next    = 0;
+	p->job++;
+	pthread_cond_broadcast( &p->work_cond );
+	pthread_mutex_unlock( &p->mutex );
+
+	// lend a hand instead of just waiting
+	_do_stripes( p );
+
+	// single completion barrier: all stripes done and nobody still looking at this run
+	pthread_mutex_lock( &p->mutex );
+	while( p->left || p->active ) {
+		pthread_cond_wait( &p->done_cond, &p->mutex );
+	}
+	pthread_mutex_unlock( &p->mutex );
+}
+
+// ************************************************************
+//
+//	slice_pool_init
+//
+// ************************************************************
+SLICE_POOL *slice_pool_init( int workers, const char *name )
+{
+	if( workers <= 0 || workers > SLICE_POOL_MAX_WORKERS ) {
+serprintf("cannot create slice pool for %d\n", workers );
+		return NULL;
+	}
+
+	SLICE_POOL *p = acalloc( 1, sizeof( SLICE_POOL ) );
+	if( !p )
+		return NULL;
+
+	pthread_mutex_init( &p->mutex, NULL );
+	pthread_cond_init ( &p->work_cond, NULL );
+	pthread_cond_init ( &p->done_cond, NULL );
+
+	int i;
+	for( i = 0; i < workers; i++ ) {
+		if( apthread_create( &p->thread[i], NULL, _worker, (void*)p, name ) ) {
+serprintf("slice pool: cannot start worker %d\n", i );
+			break;
+		}
+	}
+	p->workers = i;
+DBG serprintf("slice pool %s: %d workers\n", name, p->workers );
+
+	return p;
+}
+
+// ************************************************************
+//
+//	slice_pool_exit
+//
+// ************************************************************
+int slice_pool_exit( SLICE_POOL *p )
+{
+	if( !p )
+		return 1;
+
+	pthread_mutex_lock( &p->mutex );
+	p->stop = 1;
+	pthread_cond_broadcast( &p->work_cond );
+	pthread_mutex_unlock( &p->mutex );
+
+	int i;
+	for( i = 0; i < p->workers; i++ ) {
+		apthread_join( p->thread[i], NULL );
+	}
+
+	pthread_mutex_destroy( &p->mutex );
+	pthread_cond_destroy ( &p->work_cond );
+	pthread_cond_destroy ( &p->done_cond );
+
+	afree( p );
+	return 0;
+}
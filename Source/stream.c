@@ -18,6 +18,7 @@
 #include "types.h"
 #include "global.h"
 #include "stream.h"
+#include "stream_alloc.h"
 #include "debug.h"
 #include "util.h"
 #include "astdlib.h"
@@ -55,6 +56,8 @@ extern STREAM_SINK_VIDEO *stream_sink_video_FAKE_new( void );
 
 extern STREAM_SINK_AUDIO stream_sink_audio;
 extern STREAM_SINK_AUDIO stream_sink_audio_FAKE;
+extern int stream_sink_audio_fake_free_run;
+extern int stream_no_sync;
 
 static int stream_use_fake_audio_sink    = 0;
 static int stream_use_fake_video_sink    = 0;
@@ -123,6 +126,20 @@ STREAM_SINK_AUDIO *stream_get_default_audio_sink( void )
 	return &stream_sink_audio;
 }
 
+// ************************************************************
+//
+//	stream_set_headless
+//
+// ***********************************************************
+// all new streams play into the fake sinks as fast as they can, for benchmarks
+void stream_set_headless( int headless )
+{
+	stream_use_fake_video_sink      = headless;
+	stream_use_fake_audio_sink      = headless;
+	stream_sink_audio_fake_free_run = headless;
+	stream_no_sync                  = headless;
+}
+
 // ************************************************************
 //
 //	stream_put_chunk_cache
@@ -221,6 +238,7 @@ DBGS serprintf("stream_new: %08X\r\n", s );
 	
 	// set this default value here!
 	stream_set_buffer_chunk( s, stream_buffer_sec * 512 );
+	stream_stats_register( s );
 
 	return s;	 
 }
@@ -235,6 +253,7 @@ int stream_delete( STREAM **s )
 DBGS serprintf("stream_delete: %08X\r\n", s ? (long)*s : -1 );
 	if( !s || !*s )
 		return 1;
+	stream_stats_unregister( *s );
 	afree( *s );
 	*s = NULL;
 	return 0;
@@ -262,6 +281,11 @@ DBGS serprintf("stream_init\r\n" );
 
 	pthread_mutex_init( &s->codec_mutex,       NULL );
 	pthread_mutex_init( &s->video_done_mutex,  NULL );
+
+	thread_event_init( &s->chunk_event );
+	thread_event_init( &s->space_event );
+	thread_event_init( &s->sync_event );
+	thread_event_init( &s->frame_event );
 	
 	ref_count ++;
 	return 0;
@@ -321,9 +345,17 @@ DBGS serprintf("codec_thread joined\r\n");
 	
 	pthread_mutex_destroy( &s->codec_mutex  );
 	pthread_mutex_destroy( &s->video_done_mutex );
+
+	thread_event_destroy( &s->chunk_event );
+	thread_event_destroy( &s->space_event );
+	thread_event_destroy( &s->sync_event );
+	thread_event_destroy( &s->frame_event );
 	
 	s->open = 0;
 	
+	// the audio chunk may still belong to the parser
+	stream_audio_release( s );
+
 	int ret = 0;
 	// close parser if we have one
 	if( s->parser ) {
@@ -334,8 +366,14 @@ DBGS serprintf("codec_thread joined\r\n");
 	_free_subtitle_urls( s );
 	
 	stream_free_chunk_cache( &s->cc );
-	
+
+	// the sink frames are back in the pool by now, keep them only while another stream may want them
 	ref_count --;
+	if( !ref_count ) {
+		stream_frame_pool_flush();
+	} else {
+		stream_frame_pool_trim();
+	}
 	
 	return ret;
 }
@@ -19,6 +19,9 @@
 #include "stream.h"
 #include "stream_alloc.h"
 #include "debug.h"
+#include "atime.h"
+
+#include <pthread.h>
 
 #define DBGS if(Debug[DBG_STREAM])
 
@@ -170,39 +173,282 @@ void stream_free_dma_cached( UCHAR **ptr, size_t size )
 	}
 }
 
-static void stream_frame_free2( VIDEO_FRAME *f )
+// ************************************************************
+//
+//	frame pool
+//
+// ***********************************************************
+/*
+	frames with buffers of their own (NRM, DMA, DMA_CACHED) go back into
+	the pool on frame_free(), the next _frame_alloc() with the same
+	width, height, colorspace and mem_type takes them out again. sinks
+	that reopen on seek, track switch or the next file of a playlist get
+	the buffers of the last set instead of going through the heap.
+
+	frames nobody took for frame_pool_idle ms are freed on the next pool
+	operation and on stream_close(), the pool holds at most frame_pool_max
+	MB, the least recently used go first. a miss drops the frames of the
+	same mem_type, they belong to a format that is gone. the last
+	stream_close() empties the pool.
+*/
+#define POOL_ALIGN	64
+#define POOL_ALIGN_UP(a)	(((a) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1))
+
+typedef struct POOL_FRAME {
+	VIDEO_FRAME		frame;		// first, frame_free() gets this
+	struct POOL_FRAME	*next;
+	int			width;
+	int			height;
+	int			colorspace;
+	int			mem_type;
+	int			size;
+	UCHAR			*data[3];	// users may move the frame's own pointers
+	int			data_size[3];
+	int			packed;		// all planes in one block at data[0]
+	int			idle;		// atime() when it went back
+} POOL_FRAME;
+
+static int frame_pool_on   = 1;
+static int frame_pool_idle = 10000;	// ms
+static int frame_pool_max  = 64;	// MB
+
+static pthread_mutex_t frame_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static POOL_FRAME	*frame_pool;		// most recently put first
+static size_t		frame_pool_size;
+static int		frame_pool_count;
+static int		frame_pool_hits;
+static int		frame_pool_misses;
+
+static int _pool_mem( int mem_type )
 {
-	int i;
-	for (i = 0; f->data[i]; i++)
-		stream_free2( &f->data[i], f->data_size[i] );
+	return mem_type == STREAM_MEM_NRM || mem_type == STREAM_MEM_DMA || mem_type == STREAM_MEM_DMA_CACHED;
 }
 
-static void stream_frame_free_dma( VIDEO_FRAME *f )
+static void _pool_free_planes( POOL_FRAME *pf )
 {
 	int i;
-	for (i = 0; f->data[i]; i++)
-		stream_free_dma( &f->data[i], f->data_size[i] );
+	for( i = 0; i < 3; i++ ) {
+		if( !pf->data[i] )
+			continue;
+		if( pf->packed ) {
+			if( !i )
+				afree( pf->data[0] );
+			pf->data[i] = NULL;
+			continue;
+		}
+		switch( pf->mem_type ) {
+		case STREAM_MEM_NRM:
+			stream_free2( &pf->data[i], pf->data_size[i] );
+			break;
+		case STREAM_MEM_DMA:
+			stream_free_dma( &pf->data[i], pf->data_size[i] );
+			break;
+		case STREAM_MEM_DMA_CACHED:
+			stream_free_dma_cached( &pf->data[i], pf->data_size[i] );
+			break;
+		}
+	}
+	pf->packed = 0;
 }
 
-static void stream_frame_free_dma_cached( VIDEO_FRAME *f )
+static int _pool_alloc_planes( POOL_FRAME *pf )
 {
 	int i;
-	for (i = 0; f->data[i]; i++)
-		stream_free_dma_cached( &f->data[i], f->data_size[i] );
+	if( pf->mem_type == STREAM_MEM_NRM && alloc_packed ) {
+		// one aligned block, the planes start on cache lines
+		size_t total = 0;
+		for( i = 0; i < 3 && pf->data_size[i]; i++ )
+			total += POOL_ALIGN_UP( pf->data_size[i] );
+		UCHAR *ptr = amalloc_align( POOL_ALIGN, total );
+		if( !ptr )
+			return 1;
+		for( i = 0; i < 3 && pf->data_size[i]; i++ ) {
+			pf->data[i] = ptr;
+			ptr += POOL_ALIGN_UP( pf->data_size[i] );
+		}
+		pf->packed = 1;
+		return 0;
+	}
+
+	for( i = 0; i < 3 && pf->data_size[i]; i++ ) {
+		switch( pf->mem_type ) {
+		case STREAM_MEM_NRM:
+			pf->data[i] = stream_malloc( pf->data_size[i] );
+			break;
+		case STREAM_MEM_DMA:
+			pf->data[i] = stream_malloc_dma( pf->data_size[i] );
+			break;
+		case STREAM_MEM_DMA_CACHED:
+			pf->data[i] = stream_malloc_dma_cached( pf->data_size[i] );
+			break;
+		}
+		if( !pf->data[i] ) {
+			_pool_free_planes( pf );
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void _pool_free_list( POOL_FRAME *pf )
+{
+	while( pf ) {
+		POOL_FRAME *next = pf->next;
+		_pool_free_planes( pf );
+		afree( pf );
+		pf = next;
+	}
+}
+
+// detach what is over max_size or older than idle ms, call with the mutex held
+static POOL_FRAME *_pool_cut( size_t max_size, int idle )
+{
+	POOL_FRAME **link = &frame_pool;
+	size_t size = 0;
+	int now = atime();
+
+	while( *link ) {
+		POOL_FRAME *pf = *link;
+		if( size + pf->size > max_size || now - pf->idle >= idle )
+			break;
+		size += pf->size;
+		link = &pf->next;
+	}
+
+	// the list is in put order, everything behind is older
+	POOL_FRAME *cut = *link, *pf;
+	*link = NULL;
+	for( pf = cut; pf; pf = pf->next ) {
+		frame_pool_size -= pf->size;
+		frame_pool_count--;
+	}
+	return cut;
+}
+
+// detach the frames of mem_type, call with the mutex held
+static POOL_FRAME *_pool_cut_mem( int mem_type )
+{
+	POOL_FRAME **link = &frame_pool, *cut = NULL, **tail = &cut;
+
+	while( *link ) {
+		POOL_FRAME *pf = *link;
+		if( pf->mem_type != mem_type ) {
+			link = &pf->next;
+			continue;
+		}
+		*link = pf->next;
+		pf->next = NULL;
+		*tail = pf;
+		tail = &pf->next;
+		frame_pool_size -= pf->size;
+		frame_pool_count--;
+	}
+	return cut;
+}
+
+static POOL_FRAME *_pool_take( int width, int height, int colorspace, int mem_type )
+{
+	POOL_FRAME **link, *pf = NULL, *cut;
+
+	pthread_mutex_lock( &frame_pool_mutex );
+	cut = _pool_cut( (size_t)frame_pool_max << 20, frame_pool_idle );
+	for( link = &frame_pool; *link; link = &(*link)->next ) {
+		if( (*link)->width == width && (*link)->height == height && (*link)->colorspace == colorspace && (*link)->mem_type == mem_type ) {
+			pf = *link;
+			*link = pf->next;
+			pf->next = NULL;
+			frame_pool_size -= pf->size;
+			frame_pool_count--;
+			break;
+		}
+	}
+	if( pf ) {
+		frame_pool_hits++;
+	} else {
+		frame_pool_misses++;
+		// the sink asks for a new format, what it had before will not come back
+		POOL_FRAME *stale = _pool_cut_mem( mem_type );
+		if( stale ) {
+			POOL_FRAME *last = stale;
+			while( last->next )
+				last = last->next;
+			last->next = cut;
+			cut = stale;
+		}
+	}
+	pthread_mutex_unlock( &frame_pool_mutex );
+
+	_pool_free_list( cut );
+	return pf;
+}
+
+static void _pool_put( POOL_FRAME *pf )
+{
+	POOL_FRAME *cut;
+
+	if( !frame_pool_on ) {
+		_pool_free_list( pf );
+		return;
+	}
+
+	pthread_mutex_lock( &frame_pool_mutex );
+	pf->idle = atime();
+	pf->next = frame_pool;
+	frame_pool = pf;
+	frame_pool_size += pf->size;
+	frame_pool_count++;
+	cut = _pool_cut( (size_t)frame_pool_max << 20, frame_pool_idle );
+	pthread_mutex_unlock( &frame_pool_mutex );
+
+	_pool_free_list( cut );
+}
+
+// frame_free() puts these back, this only runs if that is bypassed
+static void _pool_destroy( VIDEO_FRAME *f )
+{
+	_pool_free_planes( (POOL_FRAME*)f );
 }
 
 // ************************************************************
 //
-//	frame_alloc
+//	stream_frame_pool_trim
 //
 // ***********************************************************
-VIDEO_FRAME *_frame_alloc( int width, int height, int colorspace, int mem_type )
+void stream_frame_pool_trim( void )
 {
-	VIDEO_FRAME *frame = amalloc( sizeof( VIDEO_FRAME ) );
-	int i;
+	POOL_FRAME *cut;
 
-	if( !frame )
-		return NULL;
+	pthread_mutex_lock( &frame_pool_mutex );
+	cut = _pool_cut( (size_t)frame_pool_max << 20, frame_pool_idle );
+	pthread_mutex_unlock( &frame_pool_mutex );
+
+	_pool_free_list( cut );
+}
+
+// ************************************************************
+//
+//	stream_frame_pool_flush
+//
+// ***********************************************************
+void stream_frame_pool_flush( void )
+{
+	POOL_FRAME *cut;
+
+	pthread_mutex_lock( &frame_pool_mutex );
+	cut = _pool_cut( 0, 0 );
+	pthread_mutex_unlock( &frame_pool_mutex );
+
+	_pool_free_list( cut );
+}
+
+// ************************************************************
+//
+//	_frame_layout
+//
+// ***********************************************************
+static int _frame_layout( VIDEO_FRAME *frame, int width, int height, int colorspace )
+{
+	int i;
 
 	memset( frame, 0, sizeof( VIDEO_FRAME ) );
 	frame->map_fd[0] = frame->map_fd[1] = frame->map_fd[2] = -1;
@@ -234,8 +480,7 @@ VIDEO_FRAME *_frame_alloc( int width, int height, int colorspace, int mem_type )
 		break;
 	default:
 serprintf("frame_alloc: unknown color space: %d\r\n", colorspace );
-		afree( frame );
-		return NULL;
+		return 1;
 	}
 	
 	frame->colorspace = colorspace;
@@ -243,35 +488,63 @@ serprintf("frame_alloc: unknown color space: %d\r\n", colorspace );
 		frame->data_size[i] = frame->linestep[i] * frame->bpp[i] * pad_height( height );
 		frame->size += frame->data_size[i];
 	}
+	frame->width    = width;
+	frame->height   = height;
+	return 0;
+}
 
-	switch( mem_type ) {
-	case STREAM_MEM_NRM:
-		for (i = 0; frame->linestep[i]; i++)
-			frame->data[i] = stream_malloc( frame->data_size[i] );
-		frame->destroy = stream_frame_free2;
-		break;
+// ************************************************************
+//
+//	frame_alloc
+//
+// ***********************************************************
+VIDEO_FRAME *_frame_alloc( int width, int height, int colorspace, int mem_type )
+{
+	VIDEO_FRAME layout, *frame;
+	POOL_FRAME *pf;
+	int i;
 
-	case STREAM_MEM_DMA:
-		for (i = 0; frame->linestep[i]; i++)
-			frame->data[i] =  stream_malloc_dma( frame->data_size[i] );
-		frame->destroy = stream_frame_free_dma;
-		break;
+	if( _frame_layout( &layout, width, height, colorspace ) )
+		return NULL;
 
-	case STREAM_MEM_DMA_CACHED:
-		for (i = 0; frame->linestep[i]; i++)
-			frame->data[i] = stream_malloc_dma_cached( frame->data_size[i] );
-		frame->destroy = stream_frame_free_dma_cached;
-		break;
+	if( !_pool_mem( mem_type ) || !layout.data_size[0] ) {
+		if( mem_type != STREAM_MEM_BYO && mem_type != STREAM_MEM_ANDROID ) {
+serprintf("frame_alloc: error allocating %d x %d frame!\r\n", width, height );
+			return NULL;
+		}
+		if( !(frame = amalloc( sizeof( VIDEO_FRAME ) )) )
+			return NULL;
+		*frame = layout;
+		return frame;
 	}
-	
-	if ( !frame->data[0] && mem_type != STREAM_MEM_BYO && mem_type != STREAM_MEM_ANDROID ) {
+
+	if( !(pf = _pool_take( width, height, colorspace, mem_type )) ) {
+		if( !(pf = amalloc( sizeof( POOL_FRAME ) )) )
+			return NULL;
+		memset( pf, 0, sizeof( POOL_FRAME ) );
+		pf->width      = width;
+		pf->height     = height;
+		pf->colorspace = colorspace;
+		pf->mem_type   = mem_type;
+		pf->size       = layout.size;
+		memcpy( pf->data_size, layout.data_size, sizeof( pf->data_size ) );
+		
+		if( _pool_alloc_planes( pf ) ) {
+			// what the pool holds may be in the way
+			stream_frame_pool_flush();
+			if( _pool_alloc_planes( pf ) ) {
 serprintf("frame_alloc: error allocating %d x %d frame!\r\n", width, height );
-		afree( frame );
-		return NULL;
+				afree( pf );
+				return NULL;
+			}
+		}
 	}
 
-	frame->width    = width;
-	frame->height   = height;
+	frame = &pf->frame;
+	*frame = layout;
+	for( i = 0; i < 3; i++ )
+		frame->data[i] = pf->data[i];
+	frame->destroy = _pool_destroy;
 
 	return frame;
 }
@@ -304,6 +577,10 @@ VIDEO_FRAME *frame_alloc_with_cs_and_mem( int width, int height, int colorspace,
 void frame_free( VIDEO_FRAME *f )
 {
 	if( f ) {
+		if ( f->destroy == _pool_destroy ) {
+			_pool_put( (POOL_FRAME*)f );
+			return;
+		}
 		if ( f->destroy )
 			f->destroy( f );
 		afree( f );	
@@ -373,4 +650,27 @@ static void dbg_f_free( int argc, char *argv[] )
 DECLARE_DEBUG_COMMAND("sfal", dbg_f_alloc );
 DECLARE_DEBUG_COMMAND("sffr", dbg_f_free  );
 DECLARE_DEBUG_TOGGLE ("salp", alloc_packed  );
+
+static void dbg_frame_pool( int argc, char *argv[] )
+{
+	POOL_FRAME *pf;
+
+	pthread_mutex_lock( &frame_pool_mutex );
+serprintf("frame pool: %d frames, %d kB, hits %d, misses %d\r\n", frame_pool_count, (int)(frame_pool_size >> 10), frame_pool_hits, frame_pool_misses );
+	for( pf = frame_pool; pf; pf = pf->next ) {
+serprintf("  %4d x %4d  cs %d  mem %d  %6d kB  idle %d ms\r\n", pf->width, pf->height, pf->colorspace, pf->mem_type, pf->size >> 10, atime() - pf->idle );
+	}
+	pthread_mutex_unlock( &frame_pool_mutex );
+}
+
+static void dbg_frame_pool_flush( int argc, char *argv[] )
+{
+	stream_frame_pool_flush();
+}
+
+DECLARE_DEBUG_COMMAND("sfpl", dbg_frame_pool );
+DECLARE_DEBUG_COMMAND("sfpf", dbg_frame_pool_flush );
+DECLARE_DEBUG_TOGGLE ("sfpo", frame_pool_on );
+DECLARE_DEBUG_PARAM  ("sfpi", frame_pool_idle );
+DECLARE_DEBUG_PARAM  ("sfpm", frame_pool_max );
 #endif
@@ -49,6 +49,7 @@ void stream_audio_flush( STREAM *s )
 {
 	s->audio_buffer_size = 0;
 	s->audio_end = 0;
+	stream_audio_release( s );
 	
 	if( s->audio_dec ) {
 		s->audio_dec->flush( s->audio );
@@ -110,6 +111,24 @@ serprintf("_audio_abort!\r\n");
 	return 1;
 }
 
+// ************************************************************
+//
+//	stream_audio_release
+//
+//	hand a lent chunk back to the parser, audio thread only
+//	or with the audio thread stopped
+//
+// ************************************************************
+void stream_audio_release( STREAM *s )
+{
+	if( s->audio_release ) {
+		s->audio_release( s->audio_ref );
+	}
+	s->audio_ref      = NULL;
+	s->audio_release  = NULL;
+	s->audio_data_ref = NULL;
+}
+
 extern int DEBUG_delay;
 void _stream_resync( STREAM *s );
 
@@ -193,6 +212,10 @@ static void _audio_decode( STREAM *s )
 		while( s->audio_buffer_size <= 0 && !_abort( s ) ){
 			
 			STREAM_CDATA cdata = { 0 };
+			unsigned chunk_seq = thread_event_seq( &s->chunk_event );
+
+			// the last chunk is used up
+			stream_audio_release( s );
 
 			// and try to get a new one
 			if ( s->parser->get_audio_cdata( s, &s->audio_now, &cdata  ) ) {
@@ -218,11 +241,20 @@ serprintf("audio flush\r\n");
 					out_of_audio = 1;
 //serprintf("_OOA_");
 				}
-				// no more chunks, wait....
-				stream_yield_RT();
+				if( !s->audio_parse_end && !s->stats.audio_empty ) {
+					s->stats.audio_empty = 1;
+					stream_stats_count( &s->stats.audio_starved );
+				}
+				// no more chunks, wait for the parser
+				stream_wait_event( &s->chunk_event, chunk_seq );
 				continue;
 			}
 
+			// keep a lent chunk until it is decoded
+			s->audio_ref      = cdata.ref;
+			s->audio_release  = cdata.release;
+			s->audio_data_ref = cdata.data_ref;
+
 			// if we have video as well, if video has stopped, drop all audio as well, but consume all chunks!
 			if( s->video->valid && s->video_end ) {
 DBGV serprintf("drop audio chunk: time %d\r\n", cdata.time );			
@@ -249,7 +281,7 @@ DBGV serprintf("audio in the past! %d\r\n", cdata.time );
 				if( cdata.pos != -1 ) {
 					s->audio_pos = cdata.pos;
 				}
-				s->audio_buffer      = s->audio_now.data;
+				s->audio_buffer      = cdata.data ? cdata.data : s->audio_now.data;
 				s->audio_buffer_size = cdata.size;
 
 				if( cdata.audio_skip ) {
@@ -271,13 +303,18 @@ DBGA serprintf(" [[%d]] ", s->audio_ref_time);
 					}
 				}
 
-				while( !_abort( s ) && stream_sync_audio( s, s->audio_time ) ) {
+				while( !_abort( s ) ) {
+					unsigned sync_seq = thread_event_seq( &s->sync_event );
+					if( !stream_sync_audio( s, s->audio_time ) ) {
+						break;
+					}
 DBGS serprintf("~");
-					msec_sleep( 10 );
-					stream_yield_RT();
+					stream_wait_event( &s->sync_event, sync_seq );
 				}
 
 				out_of_audio = 0;
+				s->stats.audio_empty  = 0;
+				s->stats.audio_bytes += cdata.size;
 
 				if( s->dump_audio_fd > 0 ) {
 					file_write( s->dump_audio_fd, s->audio_buffer, s->audio_buffer_size );
@@ -307,6 +344,7 @@ DBGS serprintf("~");
 
 			// we need to pass the STREAM to the _decode() call!
 			s->audio->ctx = s;
+			s->audio->data_ref = s->audio_data_ref;
 			_decode( s->audio, s->audio_buffer, s->audio_buffer_size, &audio_frame, &decoded );
 		
 			// did the sample rate change?
@@ -46,6 +46,7 @@ int stream_buffer_time = 1;
 static int stream_buffer_priority = 0;
 static int stream_buffer_o_direct = 0;
 static int stream_clear_buffer    = 0;
+static int stream_buffer_mirror   = 1;
 
 // ************************************************************
 //
@@ -245,6 +246,30 @@ ErrorExit:
 	return 1;
 }
 
+// ************************************************************
+//
+//	mirror_buffer
+//
+//	maps the buffer twice, back to back: everything behind
+//	buffer_size is the start of the buffer again, so the overlap
+//	area never has to be copied and chunks are always contiguous
+//
+// ************************************************************
+static int mirror_buffer( STREAM_BUFFER *buffer, int size )
+{
+	if( buffer->overlap_size > size ) {
+		return 1;
+	}
+	if( !( buffer->data = amalloc_mirror( size, buffer->tag ) ) ) {
+serprintf("cannot mirror buffer size %d\n", size );
+		return 1;
+	}
+DBGS serprintf("buffer->data: %08X (mirrored)\n", buffer->data);
+	buffer->mmap_size = size;
+
+	return 0;
+}
+
 // ************************************************************
 //
 //	stream_buffer_alloc
@@ -252,6 +277,14 @@ ErrorExit:
 // ************************************************************
 int stream_buffer_alloc( STREAM_BUFFER *buffer, int size )
 {
+	if( buffer->flags & STREAM_BUFFER_MIRROR ) {
+		if( !mirror_buffer( buffer, buffer->buffer_size ) ) {
+			return 0;
+		}
+		// no mirror, fall back to the overlap copies
+		buffer->flags &= ~STREAM_BUFFER_MIRROR;
+	}
+
 	if( buffer->flags & STREAM_BUFFER_MMAP_FILE && buffer->mmap_file ) {
 		return mmap_file_buffer( buffer, size );
 	} else if( buffer->flags & STREAM_BUFFER_MMAP ) {
@@ -281,7 +314,9 @@ void stream_buffer_free( STREAM_BUFFER *buffer )
 	if( !buffer->data || buffer->virtual )
 		return;
 
-	if( buffer->flags & STREAM_BUFFER_MMAP_FILE && buffer->mmap_file && buffer->mmap_fd != -1 ) {
+	if( buffer->flags & STREAM_BUFFER_MIRROR ) {
+		afree_mirror( buffer->data, buffer->mmap_size );
+	} else if( buffer->flags & STREAM_BUFFER_MMAP_FILE && buffer->mmap_file && buffer->mmap_fd != -1 ) {
 		munmap( buffer->data, buffer->mmap_size );	
 		file_close( buffer->mmap_fd );
 		file_remove( buffer->mmap_file );
@@ -300,7 +335,15 @@ void stream_buffer_free( STREAM_BUFFER *buffer )
 int stream_buffer_resize( STREAM_BUFFER *buffer, int new_size )
 {
 DBGS serprintf("stream_buffer_resize(%s  new_size %d)\r\n", buffer->tag, new_size  );
-	if( buffer->flags & STREAM_BUFFER_MMAP_FILE && buffer->mmap_file ) {
+	if( buffer->flags & STREAM_BUFFER_MIRROR ) {
+		// the mirror cannot be mremapped, build a new one, we reload anyway
+		stream_buffer_free( buffer );
+		buffer->buffer_size = new_size;
+		if( stream_buffer_alloc( buffer, new_size + buffer->overlap_size ) ) {
+			buffer->data = NULL;
+			return 1;
+		}
+	} else if( buffer->flags & STREAM_BUFFER_MMAP_FILE && buffer->mmap_file ) {
 		return 1;
 	} else if( buffer->flags & STREAM_BUFFER_MMAP ) {
 		int new_mmap_size = new_size + buffer->overlap_size;
@@ -349,6 +392,9 @@ static int _open( STREAM_BUFFER *buffer, STREAM *s, STREAM_IO *io,
 			UINT32 flags, const char *tag, STREAM_BUFFER *src )
 {
 DBGS serprintf("stream_buffer_open(%s  size %d  over %d  start %llX  end %llX  flags %08X)\r\n", tag, buffer_size, overlap_size, start, end,  flags  );
+	if( stream_buffer_mirror && !src && !( flags & ( STREAM_BUFFER_NO_WRAP | STREAM_BUFFER_MMAP_FILE ) ) ) {
+		flags |= STREAM_BUFFER_MIRROR;
+	}
 	buffer->flags = flags;
 	buffer->s     = s;
 	buffer->io    = io;
@@ -394,6 +440,10 @@ serprintf("update end!\r\n" );
 	}
 
 	if( src ) {
+		if( src->flags & STREAM_BUFFER_MIRROR ) {
+serprintf("cannot split a mirrored buffer\n");
+			return 1;
+		}
 		// we take the mem away from an existing buffer
 		src->buffer_size -= buffer_size + overlap_size;
 		buffer->data = src->data + src->buffer_size + src->overlap_size;
@@ -743,7 +793,7 @@ static void _copy_nowrap( STREAM_BUFFER *buffer, const unsigned char *data, int
 	memcpy( buffer->data + buffer->buf_write, data, count );
 		
 	// copy start to overlap area !
-	if ( buffer->buf_write < buffer->overlap_size ) {
+	if ( buffer->buf_write < buffer->overlap_size && !( buffer->flags & STREAM_BUFFER_MIRROR ) ) {
 		int copy = MIN( count, buffer->overlap_size - buffer->buf_write);
 		
 //serprintf("cbe ovrl:  %d  %d\r\n", buffer->buffer_size + buffer->buf_write, size );
@@ -784,6 +834,10 @@ DBGH2 serprintf("%s                              wr %8d               rd %8d  sc
 //serprintf("write: %d  %d\r\n", buffer->buf_write, count );
 	if( rest >= size ) {
 		_copy_nowrap( buffer, data, size );
+	} else if( buffer->flags & STREAM_BUFFER_MIRROR ) {
+		// the mirror hides the wrap, one copy is enough
+		_copy_nowrap( buffer, data, size );
+		buffer->buf_wrap  = 1;
 	} else {
 		_copy_nowrap( buffer, data,        rest );
 		_copy_nowrap( buffer, data + rest, size - rest );
@@ -821,7 +875,7 @@ int stream_buffer_get_write_pointer( STREAM_BUFFER *buffer, UCHAR **data )
 	
 	// at the buffer end the size of the chunk to write is limited by the overlap_size!
 	int rest = buffer->buffer_size + buffer->overlap_size - buffer->buf_write;
-	if ( free > rest ) {
+	if ( free > rest && !( buffer->flags & STREAM_BUFFER_MIRROR ) ) {
 		free = rest;	
 	}
 DBGH2 serprintf("%s                              wr %8d               rd %8d  sc %8d/%8lld  fr %8d\r\n", 
@@ -843,7 +897,9 @@ int stream_buffer_update_write_pointer( STREAM_BUFFER *buffer, int count )
 		return 1;
 	}
 
-	if( buffer->buf_write < buffer->overlap_size ) {
+	if( buffer->flags & STREAM_BUFFER_MIRROR ) {
+		// nothing to copy, the mirror already has it
+	} else if( buffer->buf_write < buffer->overlap_size ) {
 		// start of buffer, copy to overlap area
 		int copy = MIN( count, buffer->overlap_size - buffer->buf_write);
 		
@@ -851,7 +907,7 @@ int stream_buffer_update_write_pointer( STREAM_BUFFER *buffer, int count )
 		memcpy( buffer->data + buffer->buffer_size + buffer->buf_write, buffer->data + buffer->buf_write, copy );
 	} 
 	
-	if( buffer->buf_write + count > buffer->buffer_size ) {
+	if( buffer->buf_write + count > buffer->buffer_size && !( buffer->flags & STREAM_BUFFER_MIRROR ) ) {
 		// overlap area, copy to start of buffer
 		memcpy( buffer->data, buffer->data + buffer->buffer_size, buffer->buf_write + count - buffer->buffer_size );
 				
@@ -994,6 +1050,12 @@ static void _stream_buffer_o_direct( int argc, char *argv[] )
 serprintf("stream_buffer_o_direct: %d\r\n", stream_buffer_o_direct );
 }
 
+static void _stream_buffer_mirror( int argc, char *argv[] )
+{ 
+	stream_buffer_mirror = 1 - stream_buffer_mirror;
+serprintf("stream_buffer_mirror: %d\r\n", stream_buffer_mirror );
+}
+
 static void _stream_clear_buffer( int argc, char *argv[] )
 { 
 	stream_clear_buffer = 1 - stream_clear_buffer;
@@ -1002,6 +1064,7 @@ serprintf("stream_clear_buffer: %d\r\n", stream_clear_buffer );
 
 DECLARE_DEBUG_COMMAND("sbt", 	_stream_buffer_time     );
 DECLARE_DEBUG_COMMAND("sbo", 	_stream_buffer_o_direct );
+DECLARE_DEBUG_COMMAND("sbm", 	_stream_buffer_mirror   );
 DECLARE_DEBUG_COMMAND("scb", 	_stream_clear_buffer    );
 DECLARE_DEBUG_PARAM( "sdws", stream_drive_wake_sleep );
 DECLARE_DEBUG_PARAM( "sdwns", stream_drive_wake_no_sleep );
@@ -383,8 +383,8 @@ DBGH serprintf("\r\n[%8d] %s gt READ, free %d  slept %d\r\n", atime(), buffer->t
 		UINT64 max_cls  = free_cls;
 		UINT64 rest_cls = pad_to_buffer_chunk( buffer->s, buffer->data_end - buffer->buf_write_pos ) / STREAM_BUFFER_CHUNK; 
 			
-		// make sure we do not read over end of buffer
-		if ( max_cls > ( ( buffer->buffer_size - buffer->buf_write ) / STREAM_BUFFER_CHUNK ) )
+		// make sure we do not read over end of buffer, the mirror lets us read across it
+		if ( !( buffer->flags & STREAM_BUFFER_MIRROR ) && max_cls > ( ( buffer->buffer_size - buffer->buf_write ) / STREAM_BUFFER_CHUNK ) )
 			max_cls = ( buffer->buffer_size - buffer->buf_write ) / STREAM_BUFFER_CHUNK;			
 		
 		// make sure we do not read over end of file
@@ -466,7 +466,7 @@ serprintf("stream_buffer: fail!\n");
 		// Command has ENDed successfully!!!
 			
 		// copy start to overlap area !
-		if ( buffer->buf_write < buffer->overlap_size ) {
+		if ( buffer->buf_write < buffer->overlap_size && !( buffer->flags & STREAM_BUFFER_MIRROR ) ) {
 			int copy_size = num_cls * STREAM_BUFFER_CHUNK;
 			if ( ( buffer->buf_write + copy_size) > buffer->overlap_size )				
 				copy_size = buffer->overlap_size - buffer->buf_write;
@@ -480,7 +480,7 @@ DBGH2 serprintf("COPY: src %8d  dst %8d  siz %8d\r\n", buffer->buf_write, buffer
 		buffer->buf_write     += to_read;
 		buffer->stat_bytes    += to_read;
 		
-		if (buffer->buf_write == buffer->buffer_size) {
+		if (buffer->buf_write >= buffer->buffer_size) {
 			if( buffer->flags & STREAM_BUFFER_NO_WRAP ) {
 serprintf("__BUFFER_NO_WRAP__%d %lld\r\n", buffer->buf_scan, buffer->buf_scan_pos );
 				// we are not allowed to wrap, in this case we have to clear the overlap area!
@@ -489,7 +489,7 @@ serprintf("__BUFFER_NO_WRAP__%d %lld\r\n", buffer->buf_scan, buffer->buf_scan_po
 			} else {
 serprintf("__BUFFER_WRAP__\r\n");
 				buffer->buf_wrap  = 1;
-				buffer->buf_write = 0;
+				buffer->buf_write -= buffer->buffer_size;
 			}
 		}
 
@@ -580,8 +580,9 @@ DBGH serprintf("\r\n[%8d] %s gt READ, free: %d\r\n", atime(), buffer->tag, free
 		// do not read more than one chunk
 		to_read = MIN( to_read, STREAM_BUFFER_CHUNK );
 		
-		// make sure we do not read over end of buffer
-		to_read = MIN( to_read, buffer->buffer_size - buffer->buf_write );
+		// make sure we do not read over end of buffer, the mirror lets us read across it
+		if( !( buffer->flags & STREAM_BUFFER_MIRROR ) )
+			to_read = MIN( to_read, buffer->buffer_size - buffer->buf_write );
 		
 		// make sure we do not read over end of file
 		to_read = MIN( to_read, buffer->data_end - buffer->buf_write_pos ); 
@@ -633,7 +634,7 @@ serprintf("stream_buffer: fail!\n");
 		// Command has ENDed successfully!!!
 			
 		// copy start to overlap area !
-		if ( buffer->buf_write < buffer->overlap_size ) {
+		if ( buffer->buf_write < buffer->overlap_size && !( buffer->flags & STREAM_BUFFER_MIRROR ) ) {
 			int copy = MIN( bytes, buffer->overlap_size - buffer->buf_write );
 			memcpy( buffer->data + buffer->buffer_size + buffer->buf_write, buffer->data + buffer->buf_write, copy );	
 DBGH2 serprintf("COPY: src %8d  dst %8d  cpy %8d\r\n", buffer->buf_write, buffer->buffer_size + buffer->buf_write, copy );
@@ -643,7 +644,7 @@ DBGH2 serprintf("COPY: src %8d  dst %8d  cpy %8d\r\n", buffer->buf_write, buffer
 		buffer->buf_write_pos += bytes;
 		buffer->buf_write     += bytes;
 		
-		if (buffer->buf_write == buffer->buffer_size) {
+		if (buffer->buf_write >= buffer->buffer_size) {
 			if( buffer->flags & STREAM_BUFFER_NO_WRAP ) {
 serprintf("__BUFFER_NO_WRAP__%d %lld\r\n", buffer->buf_scan, buffer->buf_scan_pos );
 				// we are not allowed to wrap, in this case we have to clear the overlap area!
@@ -652,7 +653,7 @@ serprintf("__BUFFER_NO_WRAP__%d %lld\r\n", buffer->buf_scan, buffer->buf_scan_po
 			} else {
 serprintf("__BUFFER_WRAP__\r\n");
 				buffer->buf_wrap  = 1;
-				buffer->buf_write = 0;
+				buffer->buf_write -= buffer->buffer_size;
 			}
 		}
 
@@ -22,7 +22,6 @@
 #include "astdlib.h"
 #include "util.h"
 #include "cbe.h"
-#include "linked_list.h"
 #include "astdlib.h"
 #include "mpeg2.h"
 #include "h264.h"
@@ -30,6 +29,8 @@
 #include "file_info_priv.h"
 #include "iso639.h"
 #include "android_codec.h"
+#include "media_cache.h"
+#include "athread.h"
 
 #ifdef CONFIG_STREAM
 #ifdef CONFIG_FFMPEG_PARSER
@@ -73,18 +74,68 @@ DECLARE_DEBUG_TOGGLE("ffreo", force_reorder );
 DECLARE_DEBUG_PARAM("ffvp",  force_vpid );
 DECLARE_DEBUG_PARAM("ffap",  force_apid );
 
-typedef struct PacketNode {
-	LinkedListNode s;
-	AVPacket packet;
-} PacketNode;
+// read local sources through STREAM_IO/STREAM_BUFFER instead of lavf's own file protocol
+static int use_stream_io   = 1;
+static int io_buffer_size  = 16;	// MB of read-ahead for the lavf AVIOContext
+
+DECLARE_DEBUG_TOGGLE("ffio",  use_stream_io );
+DECLARE_DEBUG_PARAM ("ffiob", io_buffer_size );
+
+#define AVIO_BUFFER_SIZE	(64 * 1024)	// lavf side buffer, refilled from the STREAM_BUFFER
+#define AVIO_KEEP_SIZE		(512 * 1024)	// already read data kept for short backward seeks
+
+// single producer (parser thread) / single consumer (decode thread) ring,
+// the slots are allocated once at open and never touched by malloc again
+#define AUDIO_QUEUE_SIZE	8192
+#define VIDEO_QUEUE_SIZE	8192
+#define SUB_QUEUE_SIZE		1024
 
 typedef struct AVQueue {
-	LinkedList	list;
-	pthread_mutex_t mutex;
-	int		mem_used;
-	int 		packets;
+	AVPacket	*ring;
+	unsigned int	mask;
+	volatile unsigned int	head;	// consumer
+	volatile unsigned int	tail;	// producer
+	volatile int	mem_used;
+	volatile int 	packets;
 } AVQueue;
 
+// keyframe index, kept in the media cache next to the probe data
+static int use_key_index   = 1;
+static int use_key_scan    = 0;	// complete the index in a background thread
+
+DECLARE_DEBUG_TOGGLE("ffki",  use_key_index );
+DECLARE_DEBUG_TOGGLE("ffks",  use_key_scan );
+
+enum {
+	KIDX_NONE,
+	KIDX_BYTE,	// we seek to the byte position of the keyframe ourselves
+	KIDX_LAVF,	// the entries are handed to lavf's own index
+};
+
+enum {
+	KIDX_RUN_NONE,	// nothing read since the last seek
+	KIDX_RUN_START,	// reading from the start of the file
+	KIDX_RUN_ON,	// run_ts is the keyframe read last
+};
+
+#define KIDX_CONT	1	// the previous entry is the previous keyframe of the file
+#define KIDX_LAST	2	// last keyframe of the file
+
+typedef struct FF_KEY {
+	INT64		pos;
+	INT64		ts;		// pts in the video stream time base
+	int		packet;		// video packet number, -1 if unknown
+	int		flags;
+} FF_KEY;
+
+typedef struct FF_KEY_INDEX {
+	FF_KEY		*keys;		// sorted by ts
+	int		count;
+	int		max;
+	int		run;
+	INT64		run_ts;
+} FF_KEY_INDEX;
+
 typedef struct FF_PRIV 
 {
 	AVFormatContext *fmt;
@@ -117,21 +168,44 @@ typedef struct FF_PRIV
 	
 	int 		need_key;
 	int 		last_audio_time;
+	AVPacket	audio_packet;	// lent to the audio path, see _get_audio_cdata
 	
 	int		apid;
 	int		vpid;
 
 	STREAM_CHUNK	sc;
-	
+
+	// our own io stack under lavf, NULL for protocols lavf handles itself
+	STREAM_IO	*io;
+	STREAM_BUFFER	*buffer;
+	AVIOContext	*pb;
+
+	// keyframe index, shared with the scan thread
+	int		kidx_mode;
+	FF_KEY_INDEX	kidx;
+	pthread_mutex_t	kidx_mutex;
+	int		kidx_dirty;
+	int		kidx_complete;
+	volatile int	kidx_pending;	// scan results to hand to lavf
+	int		video_packets;	// video packet number, -1 after a seek
+	pthread_t	kidx_thread;
+	int		kidx_scanning;
+	volatile int	kidx_abort;
+
 } FF_PRIV;
 
 
 static int ff_force_seek = 1;
+static int ff_lend_audio = 1;	// the audio path decodes straight from the packet
 
 DECLARE_DEBUG_PARAM( "fffs", ff_force_seek );
+DECLARE_DEBUG_TOGGLE( "ffla", ff_lend_audio );
 
 static int _close( STREAM *s );
+static int _init_queue( AVQueue *q, int size );
+static void _free_queue( AVQueue *q );
 static int _flush_packets( AVQueue *q, const char *tag );
+static void _dispose_packet( AVPacket *packet );
 
 #define ff_p	((FF_PRIV*)s->parser_priv)
 
@@ -593,12 +667,972 @@ DBGP serprintf("\r\n");
 	return 0;
 }
 
+// ************************************************************
+//
+//	probe cache
+//
+// ************************************************************
+// what avformat_find_stream_info() found out about a file, so that
+// reopening it (resume, thumbnails, media scan) can skip the probing.
+// chapters and the rest of the header are read by avformat_open_input()
+// anyway, AV_PROPERTIES are rebuilt from the codec parameters.
+#define PROBE_CACHE_KIND	"ffprobe"
+#define PROBE_FORMAT_LEN	32
+
+typedef struct FF_PROBE_STREAM {
+	int		codec_type;
+	int		codec_id;
+	UINT32		codec_tag;
+	int		format;
+	INT64		bit_rate;
+	int		bits_per_coded_sample;
+	int		bits_per_raw_sample;
+	int		profile;
+	int		level;
+	int		width;
+	int		height;
+	AVRational	sample_aspect_ratio;
+	int		field_order;
+	int		color_range;
+	int		color_primaries;
+	int		color_trc;
+	int		color_space;
+	int		chroma_location;
+	int		video_delay;
+	UINT64		channel_layout;
+	int		channels;
+	int		sample_rate;
+	int		block_align;
+	int		frame_size;
+	int		initial_padding;
+	int		seek_preroll;
+	AVRational	time_base;
+	INT64		start_time;
+	INT64		duration;
+	INT64		nb_frames;
+	AVRational	avg_frame_rate;
+	AVRational	r_frame_rate;
+	int		extradata_size;
+	// extradata follows
+} FF_PROBE_STREAM;
+
+typedef struct FF_PROBE {
+	unsigned int	version;	// avformat_version(), the enums may change with lavf
+	char		format[PROBE_FORMAT_LEN];
+	INT64		duration;
+	INT64		start_time;
+	INT64		bit_rate;
+	int		nb_streams;
+	// nb_streams FF_PROBE_STREAM follow
+} FF_PROBE;
+
+static int use_probe_cache = 1;
+
+DECLARE_DEBUG_TOGGLE("ffpc", use_probe_cache );
+
+// ************************************************************
+//
+//	_probe_store
+//
+// ************************************************************
+static void _probe_store( const char *url, AVFormatContext *fmt )
+{
+	int i, size = sizeof( FF_PROBE );
+
+	if( !fmt->nb_streams || (fmt->ctx_flags & AVFMTCTX_NOHEADER) ) {
+		// streams only show up while reading packets, nothing to restore them into
+		return;
+	}
+	for( i = 0; i < fmt->nb_streams; i++ ) {
+		size += sizeof( FF_PROBE_STREAM ) + fmt->streams[i]->codecpar->extradata_size;
+	}
+	UCHAR *data = acalloc( 1, size );
+	if( !data ) {
+		return;
+	}
+
+	FF_PROBE *p = (FF_PROBE*)data;
+	p->version    = avformat_version();
+	// only the first of "mov,mp4,m4a,..." is accepted by av_find_input_format()
+	strnZcpy( p->format, fmt->iformat->name, PROBE_FORMAT_LEN - 1 );
+	char *comma = strchr( p->format, ',' );
+	if( comma ) {
+		*comma = '\0';
+	}
+	p->duration   = fmt->duration;
+	p->start_time = fmt->start_time;
+	p->bit_rate   = fmt->bit_rate;
+	p->nb_streams = fmt->nb_streams;
+
+	UCHAR *pos = data + sizeof( FF_PROBE );
+	for( i = 0; i < fmt->nb_streams; i++ ) {
+		AVStream *st = fmt->streams[i];
+		AVCodecParameters *par = st->codecpar;
+		FF_PROBE_STREAM *ps = (FF_PROBE_STREAM*)pos;
+
+		ps->codec_type            = par->codec_type;
+		ps->codec_id              = par->codec_id;
+		ps->codec_tag             = par->codec_tag;
+		ps->format                = par->format;
+		ps->bit_rate              = par->bit_rate;
+		ps->bits_per_coded_sample = par->bits_per_coded_sample;
+		ps->bits_per_raw_sample   = par->bits_per_raw_sample;
+		ps->profile               = par->profile;
+		ps->level                 = par->level;
+		ps->width                 = par->width;
+		ps->height                = par->height;
+		ps->sample_aspect_ratio   = par->sample_aspect_ratio;
+		ps->field_order           = par->field_order;
+		ps->color_range           = par->color_range;
+		ps->color_primaries       = par->color_primaries;
+		ps->color_trc             = par->color_trc;
+		ps->color_space           = par->color_space;
+		ps->chroma_location       = par->chroma_location;
+		ps->video_delay           = par->video_delay;
+		ps->channel_layout        = par->channel_layout;
+		ps->channels              = par->channels;
+		ps->sample_rate           = par->sample_rate;
+		ps->block_align           = par->block_align;
+		ps->frame_size            = par->frame_size;
+		ps->initial_padding       = par->initial_padding;
+		ps->seek_preroll          = par->seek_preroll;
+		ps->time_base             = st->time_base;
+		ps->start_time            = st->start_time;
+		ps->duration              = st->duration;
+		ps->nb_frames             = st->nb_frames;
+		ps->avg_frame_rate        = st->avg_frame_rate;
+		ps->r_frame_rate          = st->r_frame_rate;
+		ps->extradata_size        = par->extradata_size;
+		pos += sizeof( FF_PROBE_STREAM );
+		if( par->extradata_size ) {
+			memcpy( pos, par->extradata, par->extradata_size );
+			pos += par->extradata_size;
+		}
+	}
+
+	media_cache_store( PROBE_CACHE_KIND, url, data, size );
+	afree( data );
+}
+
+// ************************************************************
+//
+//	_probe_restore
+//
+// ************************************************************
+// puts the cached probe results into the streams avformat_open_input() 
+// created, fails if the file does not look like the cached one
+static int _probe_restore( AVFormatContext *fmt, const UCHAR *data, int size )
+{
+	const FF_PROBE *p = (const FF_PROBE*)data;
+	int i;
+
+	if( fmt->ctx_flags & AVFMTCTX_NOHEADER || fmt->nb_streams != p->nb_streams ) {
+		return 1;
+	}
+
+	// validate everything before touching the streams
+	const UCHAR *pos = data + sizeof( FF_PROBE );
+	const UCHAR *end = data + size;
+	for( i = 0; i < fmt->nb_streams; i++ ) {
+		const FF_PROBE_STREAM *ps = (const FF_PROBE_STREAM*)pos;
+		AVCodecParameters *par = fmt->streams[i]->codecpar;
+		if( pos + sizeof( FF_PROBE_STREAM ) > end || ps->extradata_size < 0 || pos + sizeof( FF_PROBE_STREAM ) + ps->extradata_size > end ) {
+			return 1;
+		}
+		if( ps->codec_type != par->codec_type || ( par->codec_id != AV_CODEC_ID_NONE && ps->codec_id != par->codec_id ) ) {
+DBGP serprintf("FFMPEG: probe cache mismatch in stream %d\r\n", i );
+			return 1;
+		}
+		// never hand the decoders what lavf itself would not produce
+		if( ps->time_base.num <= 0 || ps->time_base.den <= 0 || ps->width < 0 || ps->width > 16384 || ps->height < 0 || ps->height > 16384 ||
+		    ps->channels < 0 || ps->channels > 64 || ps->sample_rate < 0 || ps->block_align < 0 || ps->frame_size < 0 ) {
+DBGP serprintf("FFMPEG: probe cache entry out of range in stream %d\r\n", i );
+			return 1;
+		}
+		pos += sizeof( FF_PROBE_STREAM ) + ps->extradata_size;
+	}
+
+	pos = data + sizeof( FF_PROBE );
+	for( i = 0; i < fmt->nb_streams; i++ ) {
+		const FF_PROBE_STREAM *ps = (const FF_PROBE_STREAM*)pos;
+		AVStream *st = fmt->streams[i];
+		AVCodecParameters *par = st->codecpar;
+
+		par->codec_id              = ps->codec_id;
+		par->codec_tag             = ps->codec_tag;
+		par->format                = ps->format;
+		par->bit_rate              = ps->bit_rate;
+		par->bits_per_coded_sample = ps->bits_per_coded_sample;
+		par->bits_per_raw_sample   = ps->bits_per_raw_sample;
+		par->profile               = ps->profile;
+		par->level                 = ps->level;
+		par->width                 = ps->width;
+		par->height                = ps->height;
+		par->sample_aspect_ratio   = ps->sample_aspect_ratio;
+		par->field_order           = ps->field_order;
+		par->color_range           = ps->color_range;
+		par->color_primaries       = ps->color_primaries;
+		par->color_trc             = ps->color_trc;
+		par->color_space           = ps->color_space;
+		par->chroma_location       = ps->chroma_location;
+		par->video_delay           = ps->video_delay;
+		par->channel_layout        = ps->channel_layout;
+		par->channels              = ps->channels;
+		par->sample_rate           = ps->sample_rate;
+		par->block_align           = ps->block_align;
+		par->frame_size            = ps->frame_size;
+		par->initial_padding       = ps->initial_padding;
+		par->seek_preroll          = ps->seek_preroll;
+		st->time_base              = ps->time_base;
+		st->start_time             = ps->start_time;
+		st->duration               = ps->duration;
+		st->nb_frames              = ps->nb_frames;
+		st->avg_frame_rate         = ps->avg_frame_rate;
+		st->r_frame_rate           = ps->r_frame_rate;
+		pos += sizeof( FF_PROBE_STREAM );
+
+		if( ps->extradata_size && ( ps->extradata_size != par->extradata_size || memcmp( par->extradata, pos, ps->extradata_size ) ) ) {
+			uint8_t *extradata = av_mallocz( ps->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE );
+			if( extradata ) {
+				memcpy( extradata, pos, ps->extradata_size );
+				av_freep( &par->extradata );
+				par->extradata      = extradata;
+				par->extradata_size = ps->extradata_size;
+			}
+		}
+		pos += ps->extradata_size;
+	}
+	fmt->duration   = p->duration;
+	fmt->start_time = p->start_time;
+	fmt->bit_rate   = p->bit_rate;
+	
+	return 0;
+}
+
+// ************************************************************
+//
+//	_open_input
+//
+// ************************************************************
+// avformat_open_input() and avformat_find_stream_info(), with a probe
+// cache hit the format is forced and the stream info is not probed
+static int _open_input( AVFormatContext **fmt, const char *url, AVDictionary **opts )
+{
+	void *probe = NULL;
+	int   probe_size = 0;
+	AVInputFormat *iformat = NULL;
+
+	if( use_probe_cache && !media_cache_load( PROBE_CACHE_KIND, url, &probe, &probe_size ) ) {
+		FF_PROBE *p = (FF_PROBE*)probe;
+		if( probe_size < sizeof( FF_PROBE ) || p->version != avformat_version() ) {
+			afree( probe );
+			probe = NULL;
+		} else {
+			p->format[PROBE_FORMAT_LEN - 1] = '\0';
+			iformat = (AVInputFormat*)av_find_input_format( p->format );
+		}
+	}
+
+	if( avformat_open_input( fmt, url, iformat, opts ) != 0 ) {
+		afree( probe );
+		return 1;
+	}
+
+	if( probe ) {
+		int err = _probe_restore( *fmt, probe, probe_size );
+		afree( probe );
+		if( !err ) {
+DBGP serprintf("FFMPEG: probe cache hit for %s\r\n", url );
+			return 0;
+		}
+	}
+
+DBGP serprintf("info\r\n");
+	// Retrieve stream information
+	if (avformat_find_stream_info(*fmt, NULL) < 0) {
+printf("FFMPEG: cannot find stream info\r\n");
+	} else if( use_probe_cache ) {
+		_probe_store( url, *fmt );
+	}
+	return 0;
+}
+
+// ************************************************************
+//
+//	stream_parser_ffmpeg_open_input
+//
+// ************************************************************
+// for the lavf users outside of the parser (thumbnails), same probe cache
+int stream_parser_ffmpeg_open_input( AVFormatContext **fmt, const char *url, AVDictionary **opts )
+{
+	return _open_input( fmt, url, opts );
+}
+
 static int ffmpeg_interrupt_cb(void *ctx)
 {
 	STREAM *s = (STREAM*)ctx;
 	return s && stream_abort( s ) ? 1 : 0;
 }
 
+// ************************************************************
+//
+//	_avio_release
+//
+// ************************************************************
+// let the buffer thread reuse what lavf has consumed, but keep
+// a bit behind the read position for short backward seeks
+static void _avio_release( STREAM_BUFFER *buffer )
+{
+	int keep = MIN( AVIO_KEEP_SIZE, stream_buffer_get_tail( buffer ) );
+	int buf  = buffer->buf_scan - keep;
+	if( buf < 0 )
+		buf += buffer->buffer_size;
+	stream_buffer_free_all_data( buffer, stream_buffer_get_pos( buffer ) - keep, buf );
+}
+
+// ************************************************************
+//
+//	_avio_read
+//
+// ************************************************************
+static int _avio_read( void *opaque, uint8_t *data, int size )
+{
+	STREAM *s = (STREAM*)opaque;
+	STREAM_BUFFER *buffer = ff_p->buffer;
+	int head;
+	
+	while( !(head = stream_buffer_get_head( buffer )) ) {
+		if( stream_buffer_end( buffer ) ) {
+			// buf_end is raised before the last read is committed, 
+			// the buffer thread holds the mutex for the whole read
+			pthread_mutex_lock( &buffer->mutex );
+			head = stream_buffer_get_head( buffer );
+			pthread_mutex_unlock( &buffer->mutex );
+			if( !head ) {
+				return AVERROR_EOF;
+			}
+			break;
+		}
+		if( stream_abort( s ) ) {
+			return AVERROR_EXIT;
+		}
+		msec_sleep( 5 );
+	}
+
+	int count = MIN( size, head );
+	int first = MIN( count, buffer->buffer_size - buffer->buf_scan );
+	memcpy( data, buffer->data + buffer->buf_scan, first );
+	if( count > first ) {
+		memcpy( data + first, buffer->data, count - first );
+	}
+	stream_buffer_skip( buffer, count );
+	_avio_release( buffer );
+
+	return count;
+}
+
+// ************************************************************
+//
+//	_avio_seek
+//
+// ************************************************************
+static int64_t _avio_seek( void *opaque, int64_t offset, int whence )
+{
+	STREAM *s = (STREAM*)opaque;
+	STREAM_BUFFER *buffer = ff_p->buffer;
+	int64_t pos;
+	
+	if( whence & AVSEEK_SIZE ) {
+		return s->size ? (int64_t)s->size : -1;
+	}
+	
+	switch( whence & ~AVSEEK_FORCE ) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = stream_buffer_get_pos( buffer ) + offset;
+		break;
+	case SEEK_END:
+		if( !s->size ) {
+			return -1;
+		}
+		pos = s->size + offset;
+		break;
+	default:
+		return -1;
+	}
+	if( pos < 0 || pos > buffer->data_end ) {
+		return AVERROR(EINVAL);
+	}
+DBGP2 serprintf("FFMPEG: avio seek %lld -> %lld\r\n", stream_buffer_get_pos( buffer ), pos );
+	if( stream_buffer_set_pos( buffer, pos, 0 ) ) {
+		return AVERROR(EIO);
+	}
+	_avio_release( buffer );
+	
+	return pos;
+}
+
+// ************************************************************
+//
+//	_avio_close
+//
+// ************************************************************
+static void _avio_close( STREAM *s )
+{
+	if( ff_p->pb ) {
+		av_freep( &ff_p->pb->buffer );
+		av_freep( &ff_p->pb );
+	}
+	if( ff_p->buffer ) {
+		if( ff_p->buffer->is_open ) {
+			ff_p->buffer->close( ff_p->buffer );
+		}
+		ff_p->buffer->delete( ff_p->buffer );
+		ff_p->buffer = NULL;
+	}
+	if( ff_p->io ) {
+		ff_p->io->delete( ff_p->io );
+		ff_p->io = NULL;
+	}
+}
+
+// ************************************************************
+//
+//	_avio_open
+//
+// ************************************************************
+// puts STREAM_IO and a read-ahead STREAM_BUFFER under lavf, so local files, 
+// fd:// and multi part files get the same prefetching and drive sleep 
+// handling as our own parsers, returns 1 if lavf shall open the url itself
+static int _avio_open( STREAM *s )
+{
+	if( !use_stream_io ) {
+		return 1;
+	}
+	if( !(ff_p->io = stream_get_new_io( &s->src )) ) {
+		return 1;
+	}
+	if( stream_io_can_abort( ff_p->io ) ) {
+		ff_p->buffer = new_stream_buffer_raw_non_blocked();
+	} else {
+		ff_p->buffer = new_stream_buffer_raw();
+	}
+	if( !ff_p->buffer ) {
+serprintf("FFMPEG: no mem for buffer!\r\n");
+		goto ErrorExit;
+	}
+
+	if( !s->parser_mindata_size ) {
+		s->parser_mindata_size = get_default_stream_max_iframe_size();
+	}
+	pthread_mutex_init( &s->parser_buffer_mutex, NULL );
+
+	if( s->drm_ctx.setup ) {
+		stream_io_set_setup( ff_p->io, (STREAM_IO_SETUP)s->drm_ctx.setup, s->drm_ctx.handle );
+	}
+	if( s->io_setup ) {
+		stream_io_set_setup( ff_p->io, s->io_setup, s->io_setup_ctx );
+	}
+	if( s->io_meta ) {
+		stream_io_set_meta( ff_p->io, s->io_meta, s->io_meta_ctx );
+	}
+
+	int buffer_flags = s->buffer_flags & ~STREAM_BUFFER_MMAP_FILE;
+	if( ff_p->flags & STREAM_PARSER_FILE_NONLOCAL ) {
+		buffer_flags |= STREAM_BUFFER_NO_SLEEP;
+	}
+	// lavf copies out of the buffer, so it needs no overlap
+	if( stream_buffer_open( ff_p->buffer, s, ff_p->io, io_buffer_size * 1024 * 1024, 0, 0, s->size, buffer_flags, "FFM" ) ) {
+serprintf("FFMPEG: cannot open buffer for %s\r\n", s->src.url );
+		goto ErrorExit;
+	}
+	// everything lavf reads counts as video data for freeing the buffer
+	ff_p->buffer->video = 1;
+
+	unsigned char *avio_buffer = av_malloc( AVIO_BUFFER_SIZE );
+	if( !avio_buffer ) {
+		goto ErrorExit;
+	}
+	ff_p->pb = avio_alloc_context( avio_buffer, AVIO_BUFFER_SIZE, 0, s, _avio_read, NULL, _avio_seek );
+	if( !ff_p->pb ) {
+		av_free( avio_buffer );
+		goto ErrorExit;
+	}
+DBGP serprintf("FFMPEG: reading through stream io, %d MB buffer\r\n", io_buffer_size );
+	return 0;
+
+ErrorExit:
+	_avio_close( s );
+	return 1;
+}
+
+// ************************************************************
+// keyframe index: pts, byte position and video packet number of the
+// keyframes read during playback or by the background scan.
+// TS/PS have no index and lavf bisects the file on timestamps to seek,
+// with the index we go straight to the byte position of the keyframe.
+// matroska without cues fills lavf's own index while reading clusters,
+// that one is saved and handed back to lavf on the next open.
+#define KIDX_CACHE_KIND		"ffkidx"
+#define KIDX_VERSION		1
+#define KIDX_MAX_KEYS		(256 * 1024)
+
+typedef struct FF_KEY_FILE {
+	UINT32		version;
+	int		mode;
+	int		stream;
+	AVRational	time_base;
+	int		complete;
+	int		count;
+	// count FF_KEY follow
+} FF_KEY_FILE;
+
+// ************************************************************
+//
+//	_kidx_search
+//
+// ************************************************************
+// number of entries at or before ts
+static int _kidx_search( const FF_KEY_INDEX *idx, INT64 ts )
+{
+	int lo = 0, hi = idx->count;
+	while( lo < hi ) {
+		int mid = (lo + hi) >> 1;
+		if( idx->keys[mid].ts <= ts ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+// ************************************************************
+//
+//	_kidx_add
+//
+// ************************************************************
+// an entry gets KIDX_CONT when the keyframe before it was added
+// in the same run of reading, returns 1 if the index changed
+static int _kidx_add( FF_KEY_INDEX *idx, INT64 pos, INT64 ts, int packet )
+{
+	int changed = 0;
+	int i = _kidx_search( idx, ts );
+
+	if( !i || idx->keys[i - 1].ts != ts ) {
+		if( idx->count == idx->max ) {
+			int max = idx->max ? idx->max * 2 : 1024;
+			FF_KEY *keys = max <= KIDX_MAX_KEYS ? arealloc( idx->keys, max * sizeof( FF_KEY ) ) : NULL;
+			if( !keys ) {
+				idx->run = KIDX_RUN_NONE;
+				return 0;
+			}
+			idx->keys = keys;
+			idx->max  = max;
+		}
+		memmove( &idx->keys[i + 1], &idx->keys[i], (idx->count - i) * sizeof( FF_KEY ) );
+		idx->count++;
+		idx->keys[i].pos    = pos;
+		idx->keys[i].ts     = ts;
+		idx->keys[i].packet = packet;
+		idx->keys[i].flags  = 0;
+		i++;
+		changed = 1;
+	}
+
+	FF_KEY *k = &idx->keys[i - 1];
+	if( k->packet < 0 && packet >= 0 ) {
+		k->packet = packet;
+		changed = 1;
+	}
+	int cont = idx->run == KIDX_RUN_START ? i == 1 : 
+		   idx->run == KIDX_RUN_ON && i > 1 && idx->keys[i - 2].ts == idx->run_ts;
+	if( cont && !(k->flags & KIDX_CONT) ) {
+		k->flags |= KIDX_CONT;
+		changed = 1;
+	}
+	idx->run    = KIDX_RUN_ON;
+	idx->run_ts = ts;
+	return changed;
+}
+
+// ************************************************************
+//
+//	_kidx_end
+//
+// ************************************************************
+// the end of the file was read, the last keyframe of the run is the last one
+static int _kidx_end( FF_KEY_INDEX *idx )
+{
+	if( idx->run != KIDX_RUN_ON || !idx->count ) {
+		return 0;
+	}
+	FF_KEY *k = &idx->keys[idx->count - 1];
+	if( k->ts != idx->run_ts || (k->flags & KIDX_LAST) ) {
+		return 0;
+	}
+	k->flags |= KIDX_LAST;
+	return 1;
+}
+
+// ************************************************************
+//
+//	_kidx_find
+//
+// ************************************************************
+// only answers when no unknown keyframe can be in between
+static int _kidx_find( const FF_KEY_INDEX *idx, INT64 ts, int dir, FF_KEY *key )
+{
+	int n = _kidx_search( idx, ts );	// keys[n - 1].ts <= ts < keys[n].ts
+
+	if( dir == STREAM_SEEK_FORWARD ) {
+		// first keyframe at or after ts
+		if( n && idx->keys[n - 1].ts == ts ) {
+			n--;
+		} else if( n == idx->count || !(idx->keys[n].flags & KIDX_CONT) ) {
+			return 1;
+		}
+		*key = idx->keys[n];
+	} else {
+		// last keyframe at or before ts
+		if( !n ) {
+			if( !idx->count || !(idx->keys[0].flags & KIDX_CONT) ) {
+				return 1;
+			}
+			n = 1;
+		} else if( n == idx->count ? !(idx->keys[n - 1].flags & KIDX_LAST) : !(idx->keys[n].flags & KIDX_CONT) ) {
+			return 1;
+		}
+		*key = idx->keys[n - 1];
+	}
+	return 0;
+}
+
+// ************************************************************
+//
+//	_kidx_complete
+//
+// ************************************************************
+static int _kidx_complete( const FF_KEY_INDEX *idx )
+{
+	int i;
+	if( !idx->count || !(idx->keys[idx->count - 1].flags & KIDX_LAST) ) {
+		return 0;
+	}
+	for( i = 0; i < idx->count; i++ ) {
+		if( !(idx->keys[i].flags & KIDX_CONT) ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// ************************************************************
+//
+//	_kidx_get_mode
+//
+// ************************************************************
+static int _kidx_get_mode( AVFormatContext *fmt )
+{
+	const char *name = fmt->iformat ? fmt->iformat->name : "";
+
+	if( !strcmp( name, "mpegts" ) || !strcmp( name, "mpeg" ) ) {
+		return KIDX_BYTE;
+	}
+	if( !strncmp( name, "matroska", 8 ) ) {
+		return KIDX_LAVF;
+	}
+	return KIDX_NONE;
+}
+
+// ************************************************************
+//
+//	_kidx_packet_ts
+//
+// ************************************************************
+static INT64 _kidx_packet_ts( AVPacket *packet )
+{
+	return (use_pts && packet->pts != AV_NOPTS_VALUE) ? packet->pts : packet->dts;
+}
+
+// ************************************************************
+//
+//	_kidx_from_lavf
+//
+// ************************************************************
+static void _kidx_from_lavf( FF_KEY_INDEX *idx, AVStream *st )
+{
+	int i, n;
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT( 58, 78, 100 )
+	n = avformat_index_get_entries_count( st );
+#else
+	n = st->nb_index_entries;
+#endif
+	for( i = 0; i < n; i++ ) {
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT( 58, 78, 100 )
+		const AVIndexEntry *e = avformat_index_get_entry( st, i );
+#else
+		const AVIndexEntry *e = &st->index_entries[i];
+#endif
+		if( e->flags & AVINDEX_KEYFRAME ) {
+			_kidx_add( idx, e->pos, e->timestamp, -1 );
+		}
+	}
+	idx->run = KIDX_RUN_NONE;
+}
+
+// ************************************************************
+//
+//	_kidx_to_lavf
+//
+// ************************************************************
+// parser thread only, lavf is not thread safe
+static void _kidx_to_lavf( STREAM *s )
+{
+	AVStream *st = ff_p->fmt->streams[s->video->stream];
+	int i;
+
+	pthread_mutex_lock( &ff_p->kidx_mutex );
+	for( i = 0; i < ff_p->kidx.count; i++ ) {
+		av_add_index_entry( st, ff_p->kidx.keys[i].pos, ff_p->kidx.keys[i].ts, 0, 0, AVINDEX_KEYFRAME );
+	}
+	ff_p->kidx_pending = 0;
+	pthread_mutex_unlock( &ff_p->kidx_mutex );
+}
+
+// ************************************************************
+//
+//	_kidx_record
+//
+// ************************************************************
+static void _kidx_record( STREAM *s, AVPacket *packet )
+{
+	if( (packet->flags & AV_PKT_FLAG_KEY) && packet->pos >= 0 ) {
+		INT64 ts = _kidx_packet_ts( packet );
+		if( ts != AV_NOPTS_VALUE ) {
+			pthread_mutex_lock( &ff_p->kidx_mutex );
+			ff_p->kidx_dirty |= _kidx_add( &ff_p->kidx, packet->pos, ts, ff_p->video_packets );
+			pthread_mutex_unlock( &ff_p->kidx_mutex );
+		}
+	}
+	if( ff_p->video_packets >= 0 ) {
+		ff_p->video_packets++;
+	}
+}
+
+// ************************************************************
+//
+//	_kidx_seek_key
+//
+// ************************************************************
+// time is rt, finds the keyframe a seek to time lands on
+static int _kidx_seek_key( STREAM *s, int time, int dir, FF_KEY *key )
+{
+	if( ff_p->kidx_mode != KIDX_BYTE ) {
+		return 1;
+	}
+	AVStream *st = ff_p->fmt->streams[s->video->stream];
+	INT64 ts = av_rescale_q( (INT64)time + ff_p->start_time, (AVRational){ 1, 1000 }, st->time_base );
+
+	pthread_mutex_lock( &ff_p->kidx_mutex );
+	int ret = _kidx_find( &ff_p->kidx, ts, dir, key );
+	pthread_mutex_unlock( &ff_p->kidx_mutex );
+	return ret;
+}
+
+// ************************************************************
+//
+//	_kidx_load
+//
+// ************************************************************
+static void _kidx_load( STREAM *s )
+{
+	AVStream *st = ff_p->fmt->streams[s->video->stream];
+	void *data;
+	int size;
+
+	if( media_cache_load( KIDX_CACHE_KIND, s->src.url, &data, &size ) ) {
+		return;
+	}
+	FF_KEY_FILE *h = (FF_KEY_FILE*)data;
+	if( size < sizeof( FF_KEY_FILE ) || h->version != KIDX_VERSION || h->mode != ff_p->kidx_mode ||
+	    h->stream != s->video->stream || av_cmp_q( h->time_base, st->time_base ) ||
+	    h->count <= 0 || h->count > KIDX_MAX_KEYS || size != sizeof( FF_KEY_FILE ) + h->count * sizeof( FF_KEY ) ) {
+DBGP serprintf("FFMPEG: key index in cache does not match\r\n");
+		afree( data );
+		return;
+	}
+	if( (ff_p->kidx.keys = amalloc( h->count * sizeof( FF_KEY ) )) ) {
+		memcpy( ff_p->kidx.keys, h + 1, h->count * sizeof( FF_KEY ) );
+		ff_p->kidx.count   = ff_p->kidx.max = h->count;
+		ff_p->kidx_complete = h->complete;
+DBGP serprintf("FFMPEG: %d keyframes from cache%s\r\n", h->count, h->complete ? ", complete" : "" );
+		if( ff_p->kidx_mode == KIDX_LAVF ) {
+			_kidx_to_lavf( s );
+		}
+	}
+	afree( data );
+}
+
+// ************************************************************
+//
+//	_kidx_store
+//
+// ************************************************************
+static void _kidx_store( STREAM *s )
+{
+	FF_KEY_INDEX *idx = &ff_p->kidx;
+
+	if( ff_p->kidx_mode == KIDX_LAVF ) {
+		int count = idx->count;
+		_kidx_from_lavf( idx, ff_p->fmt->streams[s->video->stream] );
+		ff_p->kidx_dirty |= idx->count != count;
+	}
+	if( !ff_p->kidx_dirty || idx->count < 2 ) {
+		return;
+	}
+
+	int size = sizeof( FF_KEY_FILE ) + idx->count * sizeof( FF_KEY );
+	FF_KEY_FILE *h = acalloc( 1, size );
+	if( !h ) {
+		return;
+	}
+	h->version   = KIDX_VERSION;
+	h->mode      = ff_p->kidx_mode;
+	h->stream    = s->video->stream;
+	h->time_base = ff_p->fmt->streams[s->video->stream]->time_base;
+	h->complete  = ff_p->kidx_complete || (ff_p->kidx_mode == KIDX_BYTE && _kidx_complete( idx ));
+	h->count     = idx->count;
+	memcpy( h + 1, idx->keys, idx->count * sizeof( FF_KEY ) );
+
+	media_cache_store( KIDX_CACHE_KIND, s->src.url, h, size );
+DBGP serprintf("FFMPEG: stored %d keyframes\r\n", idx->count );
+	afree( h );
+}
+
+static int _kidx_scan_interrupt( void *ctx )
+{
+	return *(volatile int*)ctx;
+}
+
+// ************************************************************
+//
+//	_kidx_scan_thread
+//
+// ************************************************************
+// reads the video stream of the whole file with a demuxer of its own,
+// the result replaces the index of the playback
+static void *_kidx_scan_thread( void *arg )
+{
+	STREAM *s = (STREAM*)arg;
+	int stream = s->video->stream;
+	int start = atime();
+	FF_KEY_INDEX idx;
+
+	memset( &idx, 0, sizeof( idx ) );
+	AVFormatContext *fmt = avformat_alloc_context();
+	if( !fmt ) {
+		return NULL;
+	}
+	fmt->interrupt_callback.callback = _kidx_scan_interrupt;
+	fmt->interrupt_callback.opaque   = (void*)&ff_p->kidx_abort;
+
+	if( _open_input( &fmt, s->src.url, NULL ) ) {
+		return NULL;
+	}
+	if( stream < fmt->nb_streams ) {
+		int i, packets = 0;
+		for( i = 0; i < fmt->nb_streams; i++ ) {
+			fmt->streams[i]->discard = i == stream ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+		}
+		idx.run = KIDX_RUN_START;
+
+		AVPacket packet = { 0 };
+		while( !ff_p->kidx_abort && av_read_frame( fmt, &packet ) >= 0 ) {
+			if( packet.stream_index == stream ) {
+				INT64 ts = _kidx_packet_ts( &packet );
+				if( ff_p->kidx_mode == KIDX_BYTE && (packet.flags & AV_PKT_FLAG_KEY) && packet.pos >= 0 && ts != AV_NOPTS_VALUE ) {
+					_kidx_add( &idx, packet.pos, ts, packets );
+				}
+				packets++;
+			}
+			av_packet_unref( &packet );
+		}
+
+		if( !ff_p->kidx_abort ) {
+			if( ff_p->kidx_mode == KIDX_BYTE ) {
+				_kidx_end( &idx );
+			} else {
+				_kidx_from_lavf( &idx, fmt->streams[stream] );
+			}
+DBGP serprintf("FFMPEG: key index scan: %d keyframes in %d packets (took %d)\r\n", idx.count, packets, atime() - start );
+
+			pthread_mutex_lock( &ff_p->kidx_mutex );
+			FF_KEY_INDEX old = ff_p->kidx;
+			ff_p->kidx.keys  = idx.keys;
+			ff_p->kidx.count = idx.count;
+			ff_p->kidx.max   = idx.max;
+			ff_p->kidx_dirty    = 1;
+			ff_p->kidx_complete = 1;
+			ff_p->kidx_pending  = ff_p->kidx_mode == KIDX_LAVF;
+			pthread_mutex_unlock( &ff_p->kidx_mutex );
+			idx = old;
+		}
+	}
+	avformat_close_input( &fmt );
+	afree( idx.keys );
+	return NULL;
+}
+
+// ************************************************************
+//
+//	_kidx_open
+//
+// ************************************************************
+static void _kidx_open( STREAM *s )
+{
+	pthread_mutex_init( &ff_p->kidx_mutex, NULL );
+	ff_p->kidx.run = KIDX_RUN_START;
+
+	if( !use_key_index || !s->video->valid ) {
+		return;
+	}
+	ff_p->kidx_mode = _kidx_get_mode( ff_p->fmt );
+	if( ff_p->kidx_mode == KIDX_NONE ) {
+		return;
+	}
+	_kidx_load( s );
+
+	if( use_key_scan && !ff_p->kidx_complete && s->src.url[0] == '/' ) {
+		if( !thread_create( &ff_p->kidx_thread, _kidx_scan_thread, (void*)s, 0, "ff key index scan" ) ) {
+			ff_p->kidx_scanning = 1;
+		}
+	}
+}
+
+// ************************************************************
+//
+//	_kidx_close
+//
+// ************************************************************
+// before the demuxer is closed, the lavf index is saved from it
+static void _kidx_close( STREAM *s )
+{
+	if( ff_p->kidx_scanning ) {
+		ff_p->kidx_abort = 1;
+		pthread_join( ff_p->kidx_thread, NULL );
+		ff_p->kidx_scanning = 0;
+	}
+	if( ff_p->kidx_mode != KIDX_NONE && ff_p->fmt ) {
+		_kidx_store( s );
+	}
+	afree( ff_p->kidx.keys );
+	memset( &ff_p->kidx, 0, sizeof( FF_KEY_INDEX ) );
+	pthread_mutex_destroy( &ff_p->kidx_mutex );
+}
+
 static void parse_PID_from_query( STREAM *s )
 {
 	int pid;
@@ -691,16 +1725,14 @@ DBGP serprintf("max_delay: %d\n", ff_p->fmt->max_delay);
 
 	av_dict_set(&ff_p->fmt_opts, "probesize", "10000000", 0);
 
-	if( avformat_open_input(&ff_p->fmt, s->src.url, NULL, &ff_p->fmt_opts ) != 0) {
-serprintf("FFMPEG: cannot open file\r\n");
-		goto ErrorExit4;
+	if( !_avio_open( s ) ) {
+		// the url is still passed along as a hint for probing
+		ff_p->fmt->pb = ff_p->pb;
 	}
 
-DBGP serprintf("info\r\n");
-
-	// Retrieve stream information
-	if (avformat_find_stream_info(ff_p->fmt, NULL) < 0) {
-printf("FFMPEG: cannot find stream info\r\n");
+	if( _open_input( &ff_p->fmt, s->src.url, &ff_p->fmt_opts ) ) {
+serprintf("FFMPEG: cannot open file\r\n");
+		goto ErrorExit4;
 	}
 	
 	_parse_format( s->etype, ff_p );
@@ -710,13 +1742,11 @@ printf("FFMPEG: cannot find stream info\r\n");
 	s->duration = ff_p->duration;
 	s->size     = ff_p->size;
 	
-	LinkedList_init( &ff_p->aq.list );
-	LinkedList_init( &ff_p->vq.list );
-	LinkedList_init( &ff_p->sq.list );
-
-	pthread_mutex_init( &ff_p->aq.mutex, NULL );
-	pthread_mutex_init( &ff_p->vq.mutex, NULL );
-	pthread_mutex_init( &ff_p->sq.mutex, NULL );
+	if( _init_queue( &ff_p->aq, AUDIO_QUEUE_SIZE ) || _init_queue( &ff_p->vq, VIDEO_QUEUE_SIZE ) || _init_queue( &ff_p->sq, SUB_QUEUE_SIZE ) ) {
+serprintf("FFMPEG: no mem for packet queues\r\n");
+		avformat_close_input(&ff_p->fmt);
+		goto ErrorExit4;
+	}
 
 	// make lavf parser use this sync mode! 0 is for STREAM_SYNC_CDATA (PTS) and 1 for STREAM_SYNC_SAMPLES
 	//s->sync_mode = STREAM_SYNC_SAMPLES;
@@ -728,15 +1758,22 @@ printf("FFMPEG: cannot find stream info\r\n");
 	if( s->video->valid ) {
 		ff_p->need_key = 1;
 	}
+	_kidx_open( s );
 	return 0;
 
 ErrorExit4:
 ErrorExit3:
+	_avio_close( s );
 	av_dict_free(&ff_p->fmt_opts);
 	avformat_network_deinit();
 
 ErrorExit2:
 ErrorExit:
+	if( ff_p ) {
+		_free_queue( &ff_p->aq );
+		_free_queue( &ff_p->vq );
+		_free_queue( &ff_p->sq );
+	}
 	afree( ff_p );
 	s->parser_priv = NULL;
 	
@@ -757,16 +1794,23 @@ serprintf("FFMPEG: not open!\r\n" );
 	} 
 	s->parser_open = 0;
 	if( ff_p ) {
+		_kidx_close( s );
 		if( ff_p->fmt ) {
 			// Close the video file
 			avformat_close_input(&ff_p->fmt);
 		}
+		_avio_close( s );
 
 
 		_flush_packets( &ff_p->vq, "VID" );
 		_flush_packets( &ff_p->aq, "AUD" );
 		_flush_packets( &ff_p->sq, "SUB" );
 
+		_free_queue( &ff_p->vq );
+		_free_queue( &ff_p->aq );
+		_free_queue( &ff_p->sq );
+		_dispose_packet( &ff_p->audio_packet );
+
 		av_dict_free(&ff_p->fmt_opts);
 
 		afree( ff_p );
@@ -786,25 +1830,72 @@ static void _dispose_packet( AVPacket *packet )
 	av_packet_unref( packet );
 }
 
+// ************************************************************
+//
+//	_init_queue
+//
+// ************************************************************
+static int _init_queue( AVQueue *q, int size )
+{
+	// size must be a power of two
+	if( !(q->ring = acalloc( size, sizeof( AVPacket ) ) ) ) {
+		return 1;
+	}
+	q->mask     = size - 1;
+	q->head     = 0;
+	q->tail     = 0;
+	q->mem_used = 0;
+	q->packets  = 0;
+	return 0;
+}
+
+// ************************************************************
+//
+//	_free_queue
+//
+// ************************************************************
+static void _free_queue( AVQueue *q )
+{
+	afree( q->ring );
+	q->ring = NULL;
+}
+
+// ************************************************************
+//
+//	_queue_full
+//
+// ************************************************************
+static int _queue_full( AVQueue *q )
+{
+	return q->tail - q->head > q->mask;
+}
+
 // ************************************************************
 //
 //	_add_packet
 //
+//	parser thread only
+//
 // ************************************************************
 static int _add_packet( AVQueue *q, AVPacket *packet )
 {
-	pthread_mutex_lock( &q->mutex );
+	unsigned int tail = q->tail;
+	if( tail - q->head > q->mask ) {
+serprintf("FFMPEG: packet queue full!\r\n");
+		return 1;
+	}
+	AVPacket *slot = &q->ring[tail & q->mask];
 
-	PacketNode *node = acalloc( 1, sizeof( PacketNode ) );
-	LinkedListNode_init( (LinkedListNode*)node);
+	// the consumer moved the old refs out, just start clean
+	memset( slot, 0, sizeof( AVPacket ) );
+	av_packet_ref( slot, packet );
 
-	av_packet_ref(&node->packet, packet);
+	__sync_fetch_and_add( &q->mem_used, sizeof( AVPacket ) + slot->size );
+	__sync_fetch_and_add( &q->packets, 1 );
 
-	LinkedList_append( &q->list, (LinkedListNode*) node);
-	
-	q->mem_used += sizeof( PacketNode ) + node->packet.size;
-	q->packets  ++;
-	pthread_mutex_unlock( &q->mutex );
+	// publish the slot before moving the tail
+	__sync_synchronize();
+	q->tail = tail + 1;
 	return 0;
 }
 
@@ -812,25 +1903,25 @@ static int _add_packet( AVQueue *q, AVPacket *packet )
 //
 //	_get_packet
 //
+//	decode thread only, or any thread when the others are stopped
+//
 // ************************************************************
 static AVPacket *_get_packet( AVQueue *q, AVPacket *packet )
 {
-	pthread_mutex_lock( &q->mutex );
-	PacketNode *node = (PacketNode*)q->list.first;
-	if( !node ) {
-		pthread_mutex_unlock( &q->mutex );
+	unsigned int head = q->head;
+	if( head == q->tail ) {
 		return NULL;
-	}	
+	}
+	__sync_synchronize();
 
-	LinkedList_remove( &q->list, (LinkedListNode*)node );
+	*packet = q->ring[head & q->mask];
 
-	*packet = node->packet;
-	afree( node );
-	
-	q->mem_used -= sizeof( PacketNode ) + packet->size;
-	q->packets  --;
-	
-	pthread_mutex_unlock( &q->mutex );
+	__sync_fetch_and_sub( &q->mem_used, sizeof( AVPacket ) + packet->size );
+	__sync_fetch_and_sub( &q->packets, 1 );
+
+	// release the slot after we are done with it
+	__sync_synchronize();
+	q->head = head + 1;
 	return packet;
 } 
 
@@ -841,16 +1932,13 @@ static AVPacket *_get_packet( AVQueue *q, AVPacket *packet )
 // ************************************************************
 static AVPacket *_peek_packet( AVQueue *q, AVPacket *packet, int at )
 {
-	pthread_mutex_lock( &q->mutex );
-	PacketNode *node = (PacketNode*)LinkedList_entryAt( &q->list, at );
-	if( !node ) {
-		pthread_mutex_unlock( &q->mutex );
+	unsigned int head = q->head;
+	if( at < 0 || at >= (int)(q->tail - head) ) {
 		return NULL;
-	}	
+	}
+	__sync_synchronize();
 
-	*packet = node->packet;
-	
-	pthread_mutex_unlock( &q->mutex );
+	*packet = q->ring[(head + at) & q->mask];
 	return packet;
 } 
 
@@ -949,7 +2037,8 @@ DBGP serprintf("FFMPEG: wake\r\n");
 		}
 	}
 
-	if( ff_p->aq.mem_used + ff_p->vq.mem_used + ff_p->sq.mem_used > ff_p->buffer_size ) {
+	if( ff_p->aq.mem_used + ff_p->vq.mem_used + ff_p->sq.mem_used > ff_p->buffer_size ||
+	    _queue_full( &ff_p->aq ) || _queue_full( &ff_p->vq ) || _queue_full( &ff_p->sq ) ) {
 DBGP2 serprintf("FFMPEG full %d %d %d %d\r\n", ff_p->aq.mem_used, ff_p->vq.mem_used, ff_p->sq.mem_used, ff_p->buffer_size);
 		if( s->time_parsed > stream_drive_wake_sleep && !(ff_p->flags & STREAM_PARSER_FILE_NONLOCAL) ) {
 			// time to sleep
@@ -959,14 +2048,24 @@ DBGP serprintf("FFMPEG: sleep\r\n");
 		return 0;		
 	}	
 	
+	if( ff_p->kidx_pending ) {
+		_kidx_to_lavf( s );
+	}
+
 	// Read the next packet, skipping all packets that aren't for this stream
 	AVPacket packet = { 0 };
 	// Read new packet
 	if (av_read_frame( fmt, &packet) < 0) {
 		if( !s->video_parse_end ) {
 DBGP serprintf("FFMPEG: end\r\n");
+			if( ff_p->kidx_mode == KIDX_BYTE ) {
+				pthread_mutex_lock( &ff_p->kidx_mutex );
+				ff_p->kidx_dirty |= _kidx_end( &ff_p->kidx );
+				pthread_mutex_unlock( &ff_p->kidx_mutex );
+			}
 			s->video_parse_end = 1;
 			s->audio_parse_end = 1;
+			thread_event_signal( &s->chunk_event );
 		}
 		return 1;
 	}	
@@ -990,6 +2089,9 @@ DBGP2 serprintf("VIDEO      dts/pts %8lld/%8lld  %s  %02X %02X %02X %02X\r\n", G
 										packet.data[0], packet.data[1],packet.data[2],packet.data[3]  );
 DBGC4 serprintf("VIDEO      dts/pts %8lld/%8lld  %s  %02X %02X %02X %02X\r\n", GET_VIDEO_TS( packet.dts ), GET_VIDEO_TS( packet.pts ), (packet.flags & AV_PKT_FLAG_KEY) ? "I" : " ",
 										packet.data[0], packet.data[1],packet.data[2],packet.data[3]  );
+		if( ff_p->kidx_mode == KIDX_BYTE ) {
+			_kidx_record( s, &packet );
+		}
 		// add video packet
 		_add_packet( &ff_p->vq, &packet );
 		if( timestamp )
@@ -1006,6 +2108,8 @@ DBGP2 serprintf("\r\n");
 		if( timestamp )
 			*timestamp = -1;
 	}
+	// wake up the decoders waiting for data, and tell the parser thread we moved on
+	thread_event_signal( &s->chunk_event );
 
 	// discard packet
 	av_packet_unref(&packet);
@@ -1099,14 +2203,26 @@ DBGP serprintf("FFMPEG: seek: time %8d  pos %5d  dir %d\r\n", time, pos, dir);
 
 	__attribute__((unused))	
 	int stream = s->video->valid ? s->video->stream : s->audio->stream;
+	int ret = -1;
+
+	// with a known keyframe go straight to its byte position
+	FF_KEY key;
+	int indexed = time != -1 && !_kidx_seek_key( s, time, dir, &key );
+	if( indexed ) {
+		ret = avformat_seek_file( fmt, -1, key.pos, key.pos, key.pos, AVSEEK_FLAG_BYTE );
+DBGP serprintf("FFMPEG: key index seek to %lld (%d)\r\n", key.pos, ret );
+		indexed = ret >= 0;
+	}
+	if( !indexed ) {
 #if 0
-	int ret = av_seek_frame( fmt, stream, new_pos, 1 );
+		ret = av_seek_frame( fmt, stream, new_pos, 1 );
 #else
-	int64_t seek_min    = dir == STREAM_SEEK_FORWARD ? new_pos : INT64_MIN;
-	int64_t seek_max    = dir == STREAM_SEEK_BACKWARD ? new_pos : INT64_MAX;
+		int64_t seek_min    = dir == STREAM_SEEK_FORWARD ? new_pos : INT64_MIN;
+		int64_t seek_max    = dir == STREAM_SEEK_BACKWARD ? new_pos : INT64_MAX;
 
-	int ret = avformat_seek_file( fmt, -1, seek_min, new_pos, seek_max, av_flags);
+		ret = avformat_seek_file( fmt, -1, seek_min, new_pos, seek_max, av_flags);
 #endif
+	}
 
 	if( ret < 0 ) {
 serprintf("FFMPEG: seek error\r\n"); 
@@ -1121,10 +2237,17 @@ serprintf("FFMPEG: seek error\r\n");
 	_flush_packets( &ff_p->sq, "SUB" );
 
 	ff_p->sleeping = 0;
+
+	if( ff_p->kidx_mode != KIDX_NONE ) {
+		pthread_mutex_lock( &ff_p->kidx_mutex );
+		ff_p->kidx.run = KIDX_RUN_NONE;
+		pthread_mutex_unlock( &ff_p->kidx_mutex );
+	}
+	ff_p->video_packets = indexed ? key.packet : -1;
 	
 	// retry until we get a video frame
 	int ignore_first = 0;
-	if( s->video->format == VIDEO_FORMAT_MPEG ) {
+	if( s->video->format == VIDEO_FORMAT_MPEG && !indexed ) {
 		// for some f*cking reason, lavf is unable to give 
 		// us a good key frame after seek in TS, so we scan until
 		// the next one...doh
@@ -1189,10 +2312,23 @@ static int _seek_pos( STREAM *s, int time, int dir, int flags, int force_reload,
 	return _seek( s, -1, time, dir, flags, force_reload, sc );
 }
 
+// ************************************************************
+//
+//	_release_audio_packet
+//
+// ************************************************************
+static void _release_audio_packet( void *ref )
+{
+	_dispose_packet( (AVPacket *)ref );
+}
+
 // ************************************************************
 //
 //	_get_audio_cdata
 //
+//	refcounted packets are lent to the audio path as they are,
+//	it decodes from packet memory and releases them when done
+//
 // ************************************************************
 static int _get_audio_cdata( STREAM *s, CLEVER_BUFFER *audio_buffer, STREAM_CDATA *cdata )
 {
@@ -1210,8 +2346,11 @@ static int _get_audio_cdata( STREAM *s, CLEVER_BUFFER *audio_buffer, STREAM_CDAT
 	if( !packet ) {
 		return 1;
 	}
+	// the parser may be waiting for room
+	thread_event_signal( &s->space_event );
 
-	if( audio_buffer->size < packet->size ) {
+	int lend = ff_lend_audio && packet->buf;
+	if( !lend && audio_buffer->size < packet->size ) {
 		if ( realloc_clever_buffer( audio_buffer, packet->size ) ) {
 			_dispose_packet( packet );			
 			return 1;
@@ -1239,10 +2378,22 @@ serprintf("FF: audio_skip! %d\n", cdata->time - ff_p->last_audio_time );
 	}
 	
 DBGC2  serprintf(" A   siz %6d  pos %8lld   tim %8d  pkt %6d  %8d\r\n", packet->size, packet->pos, cdata->time, ff_p->aq.packets, ff_p->aq.mem_used );
-	memcpy( audio_buffer->data, packet->data, packet->size );
-	
 	cdata->valid = CHUNK_VALID;
 
+	if( lend ) {
+		// the audio path gives back the previous one before it asks for more
+		_dispose_packet( &ff_p->audio_packet );
+		av_packet_move_ref( &ff_p->audio_packet, packet );
+
+		cdata->data     = ff_p->audio_packet.data;
+		cdata->ref      = &ff_p->audio_packet;
+		cdata->release  = _release_audio_packet;
+		cdata->data_ref = ff_p->audio_packet.buf;
+		return 0;
+	}
+
+	memcpy( audio_buffer->data, packet->data, packet->size );
+
 	_dispose_packet( packet );			
 	return 0;
 }
@@ -1285,6 +2436,8 @@ static int _get_video_cdata( STREAM *s, CBE *cbe, STREAM_CDATA *cdata )
 	if( !packet ) {
 		return 1;
 	}
+	// the parser may be waiting for room
+	thread_event_signal( &s->space_event );
 	memset( cdata, 0, sizeof( STREAM_CDATA ) );
 	
 	if( ff_p->need_key ) {
@@ -1424,6 +2577,8 @@ static int _get_subtitle_cdata( STREAM *s, CLEVER_BUFFER *sub_buffer, STREAM_CDA
 	if( !packet ) {
 		return 1;
 	}
+	// the parser may be waiting for room
+	thread_event_signal( &s->space_event );
 
 	if( sub_buffer->size < packet->size + 128 ) {
 serprintf("realloc %d -> %d \r\n", sub_buffer->size, packet->size );
@@ -1504,15 +2659,18 @@ static int _calc_rate( STREAM *s )
 {
 	float as = audio_interface_get_audio_speed();
 	if( s->audio->valid ) {
-		pthread_mutex_lock( &ff_p->aq.mutex );
-		PacketNode *first = (PacketNode*)ff_p->aq.list.first;
-		PacketNode *last  = (PacketNode*)ff_p->aq.list.last;
-		if( first && last ) {
+		// we are the producer, the slots cannot change under us
+		AVQueue *q = &ff_p->aq;
+		unsigned int head = q->head;
+		unsigned int tail = q->tail;
+		if( head != tail ) {
+			AVPacket *first = &q->ring[head & q->mask];
+			AVPacket *last  = &q->ring[(tail - 1) & q->mask];
 			// TODO MARC perhaps should not be scaled by as
-			int first_time   = (int)(GET_AUDIO_TS( first->packet.dts ) / as);
-			int last_time    = (int)(GET_AUDIO_TS( last->packet.dts ) / as);
-			UINT64 first_pos = first->packet.pos;
-			UINT64 last_pos  = last->packet.pos;
+			int first_time   = (int)(GET_AUDIO_TS( first->dts ) / as);
+			int last_time    = (int)(GET_AUDIO_TS( last->dts ) / as);
+			UINT64 first_pos = first->pos;
+			UINT64 last_pos  = last->pos;
 
 			s->atime_parsed = last_time - first_time;
 			if( s->atime_parsed ) {
@@ -1522,19 +2680,20 @@ static int _calc_rate( STREAM *s )
 			}
 //serprintf("A: 1st %8d  last %8d  diff %8d  rate %8d\r\n", first_time, last_time, s->atime_parsed, s->acurrent_rate );
 		}
-		
-		pthread_mutex_unlock( &ff_p->aq.mutex );
+
 	}
 	if( s->video->valid ) {
-		pthread_mutex_lock( &ff_p->vq.mutex );
-		PacketNode *first = (PacketNode*)ff_p->vq.list.first;
-		PacketNode *last  = (PacketNode*)ff_p->vq.list.last;
-		if( first && last ) {
+		AVQueue *q = &ff_p->vq;
+		unsigned int head = q->head;
+		unsigned int tail = q->tail;
+		if( head != tail ) {
+			AVPacket *first = &q->ring[head & q->mask];
+			AVPacket *last  = &q->ring[(tail - 1) & q->mask];
 			// TODO MARC perhaps should not be scaled by as
-			int first_time   = (int)(GET_VIDEO_TS( first->packet.dts ) / as);
-			int last_time    = (int)(GET_VIDEO_TS( last->packet.dts ) / as);
-			UINT64 first_pos = first->packet.pos;
-			UINT64 last_pos  = last->packet.pos;
+			int first_time   = (int)(GET_VIDEO_TS( first->dts ) / as);
+			int last_time    = (int)(GET_VIDEO_TS( last->dts ) / as);
+			UINT64 first_pos = first->pos;
+			UINT64 last_pos  = last->pos;
 
 			s->vtime_parsed = last_time - first_time;
 			if( s->atime_parsed ) {
@@ -1544,8 +2703,7 @@ static int _calc_rate( STREAM *s )
 			}
 //serprintf("V: 1st %8d  last %8d  diff %8d  rate %8d\r\n", first_time, last_time, s->vtime_parsed, s->vcurrent_rate );
 		}
-		
-		pthread_mutex_unlock( &ff_p->vq.mutex );
+
 	}
 	
 	if ( s->audio->valid && s->video->valid ) {
@@ -1641,17 +2799,11 @@ DBGP serprintf("ReadFFMPEGInfo: ");
 	int err = 0;
 	// Open video file
 	priv->fmt = avformat_alloc_context();
-	if( avformat_open_input(&priv->fmt, full_path, NULL, NULL ) != 0) {
+	if( _open_input( &priv->fmt, full_path, NULL ) ) {
 serprintf("FFMPEG: cannot open file\r\n");
 		err = 1;
 		goto ErrorExit;
 	}
-
-DBGP serprintf("info\r\n");
-	// Retrieve stream information
-	if (avformat_find_stream_info(priv->fmt, NULL) < 0) {
-printf("FFMPEG: cannot find stream info\r\n");
-	}
 	
 	_parse_format( info->etype, priv );
 
@@ -26,6 +26,9 @@
 #ifdef CONFIG_STREAM
 static int debug_fas = 0;
 
+// drop the audio right away instead of playing it in real time
+int stream_sink_audio_fake_free_run = 0;
+
 DECLARE_DEBUG_TOGGLE( "dbgfas", debug_fas );
 
 #define DBGS 	if(Debug[DBG_STREAM])
@@ -201,6 +204,9 @@ static int _write( STREAM *s, AUDIO_FRAME *frame )
 	UCHAR *data = frame->data;
 	int    size = frame->size;
 	
+	if( stream_sink_audio_fake_free_run ) {
+		return size;
+	}
 	while( size ) {
 		int copy = MIN( size, block_size );
 //DBGS serprintf("ssaf: free %5d  copy: %5d\r\n", pipe_get_free( out_pipe ), copy );
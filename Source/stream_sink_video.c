@@ -108,8 +108,10 @@ static void blit_video_frame( SINK_PRIV *p, VIDEO_FRAME *frame )
 	FB_update( FB_UPDATE_VID );
 }
  
-static void venc_vencode( SINK_PRIV *p )
+// returns the number of frames given back
+static int venc_vencode( SINK_PRIV *p )
 {
+	int released = 0;
 	p->venc_time   = (UINT64) p->venc_frame      * 1000 * (UINT64) venc_scale / (UINT64) venc_rate;
 	int next_time  = (UINT64)(p->venc_frame + 1) * 1000 * (UINT64) venc_scale / (UINT64) venc_rate;
 	
@@ -142,6 +144,7 @@ DBGSI serprintf("ssv: id:%i  DOUB %8d  next:%8d\r\n", f->index, f->blit_time, ne
 //serprintf("\tPUT %d\r\n", out_frame->index );		
 			frame_q_put( &p->empty, f );
 			p->out_frame = NULL;
+			released++;
 			
 			if( blit ) {
 				break;
@@ -151,6 +154,7 @@ DBGSI serprintf("ssv: id:%i  DOUB %8d  next:%8d\r\n", f->index, f->blit_time, ne
 //if( out_frame ) serprintf("\tGET %d\r\n", p->out_frame->index );
 		}
 	}
+	return released;
 }
 
 static int _get_time( STREAM_SINK_VIDEO *sink )
@@ -224,9 +228,13 @@ DBGS serprintf("venc_thread::Starting\r\n");
 	while( p->venc_run ) {
 		if( !pthread_mutex_trylock( &p->venc_mutex ) ) {
 			
-			venc_vencode( p );
+			int released = venc_vencode( p );
 			
 			pthread_mutex_unlock( &p->venc_mutex );
+
+			if( released ) {
+				stream_frame_released( (STREAM*)sink->ctx );
+			}
 		}
 		
 		msec_sleep( 1 );
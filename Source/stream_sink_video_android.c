@@ -200,6 +200,7 @@ DBGSI serprintf(" ok\n");
 endloop:
 		p->frame_out = NULL;
 		pthread_cond_broadcast(&p->venc_cond);
+		stream_frame_released(s);
 	}
 	pthread_mutex_unlock(&p->venc_mutex);
 	return NULL;
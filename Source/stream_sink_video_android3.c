@@ -304,6 +304,7 @@ endloop:
 DBGSI serprintf("\n");
 		p->frame_out = NULL;
 		pthread_cond_broadcast(&p->venc_cond);
+		stream_frame_released(s);
 	}
 	pthread_mutex_unlock(&p->venc_mutex);
 	return NULL;
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "global.h"
+#include "types.h"
+#include "debug.h"
+#include "util.h"
+#include "atime.h"
+#include "stream.h"
+#include "stream_stats.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CONFIG_STREAM
+
+#define STATS_SAMPLE_TIME	100	// ms between two queue samples
+#define STATS_MAX_STREAMS	8
+
+static pthread_mutex_t	streams_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct STREAM	*streams[STATS_MAX_STREAMS];
+
+static const char *stage_names[STREAM_STAGE_MAX] = {
+	"parse", "vdecode", "convert", "adecode", "sink"
+};
+
+// ************************************************************
+//
+//	stream_stats_reset
+//
+// ************************************************************
+void stream_stats_reset( STREAM_STATS *st )
+{
+	memset( st, 0, sizeof( STREAM_STATS ) );
+	st->start = atime();
+}
+
+// ************************************************************
+//
+//	stream_stats_add
+//
+// ************************************************************
+void stream_stats_add( STREAM_STATS *st, int stage, int time )
+{
+	STREAM_STAGE_STATS *sg = &st->stage[stage];
+	int i = 0;
+
+	if( time < 0 )
+		time = 0;
+	while( i < STREAM_STATS_BUCKETS - 1 && time >= (1 << i) ) {
+		i++;
+	}
+	__sync_fetch_and_add( &sg->hist[i], 1 );
+	__sync_fetch_and_add( &sg->total, (UINT64)time );
+	__sync_fetch_and_add( &sg->count, 1 );
+	sg->last = time;
+	if( time > sg->max ) {
+		sg->max = time;
+	}
+}
+
+// ************************************************************
+//
+//	stream_stats_count
+//
+// ************************************************************
+void stream_stats_count( int *counter )
+{
+	__sync_fetch_and_add( counter, 1 );
+}
+
+// ************************************************************
+//
+//	stream_stats_sample
+//
+// ************************************************************
+// called from the player thread, that owns the frame queues
+void stream_stats_sample( STREAM *s )
+{
+	STREAM_STATS *st = &s->stats;
+	int now = atime();
+
+	if( now - st->sample_time < STATS_SAMPLE_TIME ) {
+		return;
+	}
+	st->sample_time = now;
+
+	STREAM_PARSER_STATS _ps;
+	STREAM_PARSER_STATS *ps = s->parser && s->parser->get_stats ? s->parser->get_stats( s, &_ps ) : NULL;
+	if( ps ) {
+		st->audio_chunks = ps->audio_chunks;
+		st->video_chunks = ps->video_chunks;
+		st->sub_chunks   = ps->sub_chunks;
+		st->buffer_fill  = ps->buffer_size ? (UINT64)ps->buffer_used * 100 / (UINT64)ps->buffer_size : 0;
+	}
+	st->decode_q = frame_q_count( &s->decode_q );
+	st->disp_q   = frame_q_count( &s->disp_q );
+	st->sink_q   = s->video_sink_count;
+
+	st->av_drift   = s->delay;
+	st->sink_delay = s->sink_delay;
+	if( ABS( s->delay ) > st->av_drift_max ) {
+		st->av_drift_max = ABS( s->delay );
+	}
+}
+
+// ************************************************************
+//
+//	stream_stats_get
+//
+// ************************************************************
+STREAM_STATS *stream_stats_get( STREAM *s, STREAM_STATS *stats )
+{
+	if( !s || !stats )
+		return NULL;
+	memcpy( stats, &s->stats, sizeof( STREAM_STATS ) );
+	return stats;
+}
+
+// ************************************************************
+//
+//	stream_stats_print
+//
+// ************************************************************
+// one "name value..." line per group, times in ms
+int stream_stats_print( STREAM *s, char *buf, int size )
+{
+	STREAM_STATS st;
+	int i, j, len = 0;
+
+#define PRINT( ... ) do { if( len < size ) len += snprintf( buf + len, size - len, __VA_ARGS__ ); } while( 0 )
+
+	if( !stream_stats_get( s, &st ) || size <= 0 )
+		return 0;
+	buf[0] = 0;
+
+	PRINT( "stream %p up %d\n", s, atime() - st.start );
+	for( i = 0; i < STREAM_STAGE_MAX; i++ ) {
+		STREAM_STAGE_STATS *sg = &st.stage[i];
+		int avg = sg->count ? sg->total / sg->count : 0;
+		PRINT( "%-8s n %u  avg %d.%d  max %u.%u  last %u.%u  hist", stage_names[i], sg->count,
+			avg / 10, avg % 10, sg->max / 10, sg->max % 10, sg->last / 10, sg->last % 10 );
+		for( j = 0; j < STREAM_STATS_BUCKETS; j++ ) {
+			PRINT( " %u", sg->hist[j] );
+		}
+		PRINT( "\n" );
+	}
+	PRINT( "queues   audio %d  video %d  sub %d  buffer %d%%  decode %d  disp %d  sink %d\n",
+		st.audio_chunks, st.video_chunks, st.sub_chunks, st.buffer_fill, st.decode_q, st.disp_q, st.sink_q );
+	PRINT( "sync     drift %d  drift_max %d  sink_delay %d\n", st.av_drift, st.av_drift_max, st.sink_delay );
+	PRINT( "video    shown %d  dropped %d  doubled %d  starved %d  B_dropped %d  errors %d\n",
+		st.video_shown, st.video_dropped, st.video_doubled, st.video_starved, st.video_B_dropped, st.video_errors );
+	PRINT( "audio    starved %d\n", st.audio_starved );
+	PRINT( "demuxed  video %llu  audio %llu\n", (unsigned long long)st.video_bytes, (unsigned long long)st.audio_bytes );
+#undef PRINT
+
+	return MIN( len, size - 1 );
+}
+
+// ************************************************************
+//
+//	stream_stats_register
+//
+// ************************************************************
+void stream_stats_register( STREAM *s )
+{
+	int i;
+	pthread_mutex_lock( &streams_mutex );
+	for( i = 0; i < STATS_MAX_STREAMS; i++ ) {
+		if( !streams[i] ) {
+			streams[i] = s;
+			break;
+		}
+	}
+	pthread_mutex_unlock( &streams_mutex );
+}
+
+// ************************************************************
+//
+//	stream_stats_unregister
+//
+// ************************************************************
+void stream_stats_unregister( STREAM *s )
+{
+	int i;
+	pthread_mutex_lock( &streams_mutex );
+	for( i = 0; i < STATS_MAX_STREAMS; i++ ) {
+		if( streams[i] == s ) {
+			streams[i] = NULL;
+		}
+	}
+	pthread_mutex_unlock( &streams_mutex );
+}
+
+// ************************************************************
+//
+//	stream_stats_print_all
+//
+// ************************************************************
+// the open streams only, the mutex keeps them from being deleted meanwhile
+int stream_stats_print_all( char *buf, int size )
+{
+	int i, len = 0;
+
+	if( size <= 0 )
+		return 0;
+	buf[0] = 0;
+	pthread_mutex_lock( &streams_mutex );
+	for( i = 0; i < STATS_MAX_STREAMS; i++ ) {
+		if( streams[i] && streams[i]->open ) {
+			len += stream_stats_print( streams[i], buf + len, size - len );
+		}
+	}
+	pthread_mutex_unlock( &streams_mutex );
+	return len;
+}
+
+#ifdef DEBUG_MSG
+static void print_stats( int argc, char *argv[] )
+{
+	char buf[4096];
+	stream_stats_print_all( buf, sizeof( buf ) );
+serprintf("%s", buf );
+}
+DECLARE_DEBUG_COMMAND("stats", print_stats );
+#endif
+
+#else
+
+int stream_stats_print_all( char *buf, int size )
+{
+	if( size > 0 )
+		buf[0] = 0;
+	return 0;
+}
+
+#endif	// CONFIG_STREAM
@@ -26,6 +26,7 @@
 #include "browse.h"
 
 #include <ctype.h>		// for isspace
+#include <limits.h>
 #include <unistd.h>
 #include <string.h>
 
@@ -37,12 +38,28 @@
 #ifdef CONFIG_STREAM
 #ifdef CONFIG_SUBTITLES
 
+// cues of one track sorted by start, read as an implicit interval tree: the
+// cue at (lo + hi) / 2 is the root of [lo, hi), maxend is the largest end in
+// that range, so subtrees that are all over can be skipped
+typedef struct SUB_CUE {
+	sub_line *line;
+	int maxend;
+} SUB_CUE;
+
+typedef struct SUB_INDEX {
+	SUB_CUE *cue;
+	int count;
+	int maxend;		// the last end of the track
+} SUB_INDEX;
+
+#define SUB_ACTIVE_MAX	8	// overlapping cues shown at once
+
 typedef struct SUB_PRIV {
 	subtitle_files *files;
 	converted_subs *subs;
+	SUB_INDEX *index;		// one per converted track
 	int stream;
-	sub_line *sub;
-	sub_line *out;
+	int next_change;		// nothing to do before this time
 	int sub_time;
 	int prev_max;
 } SUB_PRIV;
@@ -85,6 +102,119 @@ static int scale_time( STREAM *s, int time )
 	return time;
 }
 
+// *************************
+//
+// SUB_INDEX
+//
+// *************************
+static int _cue_cmp( const void *a, const void *b )
+{
+	const SUB_CUE *ca = a;
+	const SUB_CUE *cb = b;
+	if( ca->line->start != cb->line->start )
+		return ca->line->start < cb->line->start ? -1 : 1;
+	// maxend still holds the file order here, keeps equal starts stable
+	return ca->maxend - cb->maxend;
+}
+
+// fill in maxend of the subtree [lo, hi) and return it
+static int _index_tree( SUB_INDEX *idx, int lo, int hi )
+{
+	if( lo >= hi )
+		return INT_MIN;
+	int mid    = (lo + hi) / 2;
+	int maxend = idx->cue[mid].line->end;
+	int left   = _index_tree( idx, lo, mid );
+	int right  = _index_tree( idx, mid + 1, hi );
+	maxend = MAX( maxend, MAX( left, right ) );
+	idx->cue[mid].maxend = maxend;
+	return maxend;
+}
+
+static int _index_build( SUB_INDEX *idx, uni_sub *sub )
+{
+	sub_line *line;
+	int count = 0;
+	for( line = sub->first; line; line = line->next )
+		count++;
+
+	idx->count  = 0;
+	idx->maxend = 0;
+	idx->cue    = NULL;
+	if( !count )
+		return 0;
+	if( !(idx->cue = amalloc( count * sizeof( SUB_CUE ) ) ) )
+		return 1;
+
+	for( line = sub->first; line; line = line->next ) {
+		idx->cue[idx->count].line   = line;
+		idx->cue[idx->count].maxend = idx->count;
+		idx->count++;
+	}
+	qsort( idx->cue, idx->count, sizeof( SUB_CUE ), _cue_cmp );
+
+	idx->maxend = _index_tree( idx, 0, idx->count );
+	return 0;
+}
+
+static void _index_free( SUB_PRIV *p )
+{
+	if( !p->index )
+		return;
+	int i;
+	for( i = 0; i < p->subs->cnt; i++ ) {
+		afree( p->index[i].cue );
+	}
+	afree( p->index );
+	p->index = NULL;
+}
+
+// first cue that starts after time
+static int _index_upper( STREAM *s, SUB_INDEX *idx, int time )
+{
+	int lo = 0;
+	int hi = idx->count;
+	while( lo < hi ) {
+		int mid = (lo + hi) / 2;
+		if( scale_time( s, idx->cue[mid].line->start ) > time )
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+// in order walk of [lo, hi), skips subtrees that ended or start after time
+static int _index_walk( STREAM *s, SUB_INDEX *idx, int lo, int hi, int time, sub_line **out, int n, int max )
+{
+	if( lo >= hi || n >= max )
+		return n;
+	int mid = (lo + hi) / 2;
+	if( scale_time( s, idx->cue[mid].maxend ) <= time )
+		return n;
+	n = _index_walk( s, idx, lo, mid, time, out, n, max );
+	if( n >= max || scale_time( s, idx->cue[mid].line->start ) > time )
+		return n;
+	if( scale_time( s, idx->cue[mid].line->end ) > time )
+		out[n++] = idx->cue[mid].line;
+	return _index_walk( s, idx, mid + 1, hi, time, out, n, max );
+}
+
+// all cues active at time (start <= time < end), in start order
+static int _index_active( STREAM *s, SUB_INDEX *idx, int time, sub_line **out, int max )
+{
+	return _index_walk( s, idx, 0, idx->count, time, out, 0, max );
+}
+
+static char *_append( char *dst, int *max, const char *src )
+{
+	while( *src && *max > 0 ) {
+		*dst++ = *src++;
+		(*max)--;
+	}
+	return dst;
+}
+
 static subtitle_files *get_subtitle_files( STREAM *s )
 {
 	const char *name =  s->src.name[0] == '\0' ? cut_path( s->src.url ) : s->src.name;
@@ -161,6 +291,7 @@ DBGS serprintf("stream_sub_ext_check: [%s]\r\n", s->sub_url[0] );
 	}
 	SUB_PRIV *p = s->subtitle_priv;
 	memset( p, 0, sizeof( SUB_PRIV ) );
+	int i;
 	p->prev_max = s->av.subs_max;
 	p->files = files;
 
@@ -180,8 +311,15 @@ DBGS serprintf("stream_sub_ext_check: [%s]\r\n", s->sub_url[0] );
 	//convert the subtitle time format if necessary
 	_adjust_timing( s, p->subs );
 
+	// build the seek index once, the cue lists do not change from here on
+	if( !(p->index = acalloc( p->subs->cnt, sizeof( SUB_INDEX ) ) ) )
+		goto NULL_SUBTITLES;
+	for( i = 0; i < p->subs->cnt; i++ ) {
+		if( _index_build( p->index + i, p->subs->converted[i] ) )
+			goto NULL_SUBTITLES;
+	}
+
 	// add them to the sub props:
-	int i;
 	struct subt_orig_t *sub_files = p->files->files;
 	for( i = 0; i < p->subs->cnt; i++ ) {
 		if( s->av.subs_max >= SUB_TRACK_MAX )
@@ -211,8 +349,7 @@ DBGS serprintf("has palette!\n");
 	}
 
 	p->stream = -1;
-	p->sub    = NULL;
-	p->out    = NULL;
+	p->next_change = -1;
 	p->sub_time = -1;
 	
 	return 0;
@@ -240,8 +377,10 @@ DBGS serprintf("stream_sub_ext_close\r\n" );
 		s->av.subs_max = p->prev_max;
 		if( p->files )
 			subtitle_free_files( p->files );
-		if( p->subs )
+		if( p->subs ) {
+			_index_free( p );
 			subtitle_free_converted( p->subs );
+		}
 		afree( s->subtitle_priv );
 		s->subtitle_priv = NULL;
 	}
@@ -257,94 +396,83 @@ int stream_sub_ext_get_subtitle_data( STREAM *s, VIDEO_FRAME **pframe, int time
 	SUB_PRIV *p = s->subtitle_priv;
 	if( s->subtitle->stream != p->stream ) {
 		p->stream = s->subtitle->stream;
-		p->sub = NULL;
-		p->out = NULL;
+		p->next_change = -1;
 DBG serprintf("sub: stream now %d\r\n", p->stream );
 	}
+	SUB_INDEX *idx = p->index + p->stream;
+	if( !idx->count ) {
+		return 1;
+	}
 	
 	// over the end, give up
-	if( time > scale_time( s, p->subs->converted[p->stream]->last->end ) ) {
+	if( time >= scale_time( s, idx->maxend ) ) {
 		return 1;
 	} else if( p->sub_time == -1 || time < p->sub_time ) {
-		p->sub = NULL;
-		p->out = NULL;
+DBG serprintf("sub: seek to %d\r\n", time);
+		p->next_change = -1;
 	}
 
 	p->sub_time = time;
-	
-	if( !p->sub ) {
-DBG serprintf("sub: rewind at %d\r\n", time);
-		// start from 1st sub
-		p->sub = p->subs->converted[p->stream]->first;
-		if( !p->sub ) {
-DBG serprintf("sub: no 1st\r\n");
-			return 1;
-		}
+
+	// what is on screen is still right
+	if( time < p->next_change ) {
+		return 1;
 	}
-	
-	if( !p->sub ) {
+
+	// the last change point, the shown set may have changed because a cue ended
+	int changed = p->next_change;
+	sub_line *active[SUB_ACTIVE_MAX];
+	int num  = _index_active( s, idx, time, active, SUB_ACTIVE_MAX );
+	int next = _index_upper( s, idx, time );
+	int next_start = next < idx->count ? scale_time( s, idx->cue[next].line->start ) : INT_MAX;
+
+	if( !num ) {
+DBG3 serprintf("sub: wait [%8d] next %8d\r\n", time, next_start );
+		p->next_change = next_start;
 		return 1;
 	}
-	
-	// no current or current is done?
-	if( !p->out || scale_time( s, p->out->end ) < time ) {
-		int start = scale_time( s, p->sub->start );
-		int end   = scale_time( s, p->sub->end );
-		
-		// drop all subs in the past
-		while( p->sub ) {
-			if( end > time ) {
-				break;
-			}
-DBG3 serprintf("sub: skip [%8d] %8d -> %8d [%s][%s]\r\n", time, start, end, p->sub->top, p->sub->bottom );
-			p->sub = p->sub->next;
-			start = scale_time( s, p->sub->start );
-			end   = scale_time( s, p->sub->end );
-		}
-		if( !p->sub ) {
-			return 1;
-		}		
-	
-		// check if this one is due?
-		if( start > time ) {
-DBG3 serprintf("sub: wait [%8d] %8d -> %8d [%s][%s]\r\n", time, start, end, p->sub->top, p->sub->bottom );
-			return 1;
-		}	
-		
-		// output this one:
-		p->out = p->sub;
-DBG2 serprintf("sub: out  [%8d] %8d -> %8d TOP[%s] BOT[%s]\r\n", time, start, end, p->out->top, p->out->bottom );
-		
-		VIDEO_FRAME *frame = *pframe;
-		if( s->subtitle->gfx ) {
-			frame->valid = frame->size;
-			subtitle_get_gfx( p->subs->converted[p->stream], p->out->pos, frame->data[0], &frame->valid );
-		} else {
-			int   max = frame->size - 1;
-			char *src = p->out->top;
-			char *dst = frame->data[0];
-			while( *src && max-- ) {
-				*dst++ = *src++;
-			}
-			if( p->out->bottom && max > 2 ) {
-				*dst++ = '\\';
-				*dst++ = 'n';
-				char *src = p->out->bottom;
-				while( *src && max-- ) {
-					*dst++ = *src++;
-				}
+
+	VIDEO_FRAME *frame = *pframe;
+	int start;
+	int end;
+	if( s->subtitle->gfx ) {
+		// pictures do not stack, show the oldest until it is over
+		sub_line *out = active[0];
+		start = scale_time( s, out->start );
+		end   = scale_time( s, out->end );
+DBG2 serprintf("sub: out  [%8d] %8d -> %8d gfx\r\n", time, start, end );
+		frame->valid = frame->size;
+		subtitle_get_gfx( p->subs->converted[p->stream], out->pos, frame->data[0], &frame->valid );
+	} else {
+		// overlapping cues go out together until the next one starts or ends
+		int   max = frame->size - 1;
+		char *dst = frame->data[0];
+		int   i;
+		start = changed > 0 ? changed : 0;
+		end   = next_start;
+		for( i = 0; i < num; i++ ) {
+			sub_line *out = active[i];
+DBG2 serprintf("sub: out  [%8d] %8d -> %8d TOP[%s] BOT[%s]\r\n", time, scale_time( s, out->start ), scale_time( s, out->end ), out->top, out->bottom );
+			if( scale_time( s, out->start ) > start )
+				start = scale_time( s, out->start );
+			if( scale_time( s, out->end ) < end )
+				end = scale_time( s, out->end );
+			if( i && max > 2 )
+				dst = _append( dst, &max, "\\n" );
+			dst = _append( dst, &max, out->top );
+			if( out->bottom && max > 2 ) {
+				dst = _append( dst, &max, "\\n" );
+				dst = _append( dst, &max, out->bottom );
 			}
-			*dst = '\0';
 		}
-			
-		frame->time      = start;
-		frame->duration  = end - start; 
-
-		p->sub = p->sub->next;
-		return 0;
+		*dst = '\0';
 	}
+			
+	frame->time      = start;
+	frame->duration  = end - start; 
 
-	return 1;
+	p->next_change = end;
+	return 0;
 }
 #endif	// CONFIG_SUBTITLES
 #endif  // CONFIG_STREAM
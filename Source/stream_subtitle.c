@@ -315,10 +315,12 @@ DBGS serprintf("PID[%5d] stream_sub_dec_thread::Starting\r\n", getpid() );
 	
 	while( thread_state_get( &s->sub_tstate ) != THREAD_EXIT ) {
 		thread_state_ack( &s->sub_tstate );
+		// subtitles follow the video time
+		unsigned sync_seq = thread_event_seq( &s->sync_event );
 		if( thread_state_get( &s->sub_tstate ) == THREAD_RUNNING ) {
 			_sub_decode( s );
 		}
-		stream_yield_RT();
+		stream_wait_event( &s->sync_event, sync_seq );
 	}
 DBGS serprintf("PID[%5d] stream_sub_dec_thread::Exiting\r\n", getpid() );
  	return NULL;
@@ -163,7 +163,11 @@ int stream_sync_audio( STREAM *s, int audio_time )
 		}
 	}
 
-	s->sync_a_time = audio_time;
+	if( s->sync_a_time != audio_time ) {
+		s->sync_a_time = audio_time;
+		// the video side may wait for us
+		thread_event_signal( &s->sync_event );
+	}
 	
 	if( !s->sync_audio || s->play_n_audio_frames || stream_no_sync ) {
 		return 0;
@@ -210,7 +214,11 @@ DBGY serprintf("{{A %d}} ", diff );
 // ************************************************************
 int stream_sync_video( STREAM *s, int video_time )
 {
-	s->sync_v_time = video_time;
+	if( s->sync_v_time != video_time ) {
+		s->sync_v_time = video_time;
+		// the audio side may wait for us
+		thread_event_signal( &s->sync_event );
+	}
 
 	if( !s->sync_video || s->speed != STREAM_SPEED_NORMAL || s->play_n_video_frames || stream_no_sync ) {
 		return 0;
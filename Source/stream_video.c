@@ -74,6 +74,7 @@ static int	stream_no_output   = 0;
 static int 	stream_no_parser   = 0;
 static int 	stream_no_seek     = 0;
 static int 	stream_parser_sleep = 0;
+static int 	stream_event_timeout = 10;
 static int 	stream_no_video    = 0;
 int	 	stream_fake_video  = 0;
 int	 	stream_fake_chapters = 0;
@@ -1272,6 +1273,35 @@ void stream_yield_RT( void )
 	msec_sleep( 1 );
 }
 
+// *****************************************************************************
+//
+//	stream_wait_event
+//
+//	take the sequence before checking the condition, then wait here until
+//	the event moved past it, or stream_event_timeout ms at most so state
+//	changes and sources that do not signal are still seen
+//
+// *****************************************************************************
+void stream_wait_event( THREAD_EVENT *ev, unsigned seq )
+{
+	thread_event_wait( ev, seq, stream_event_timeout );
+}
+
+// *****************************************************************************
+//
+//	stream_frame_released
+//
+//	sinks call this from their threads when they are done with a frame,
+//	the engine may be waiting for it
+//
+// *****************************************************************************
+void stream_frame_released( STREAM *s )
+{
+	if( s ) {
+		thread_event_signal( &s->frame_event );
+	}
+}
+
 static VIDEO_FRAME *find_frame( STREAM *s, void *tag )
 {
 	int i;
@@ -1371,6 +1401,9 @@ static void _queue_sink_frames( STREAM *s )
 		s->video_drop   = (frame->blit_time == -1);
 		if( s->video_sink->put_time ) {
 			frames_dropped += s->video_drop;
+			if( s->video_drop ) {
+				stream_stats_count( &s->stats.video_dropped );
+			}
 		}
 		frame->time = -1;
 		if( frame->locked ) {
@@ -1546,6 +1579,7 @@ int stream_open(STREAM     *s,
 {
 	if( !s )
 		return 1;
+	stream_stats_reset( &s->stats );
 serprintf("\r\nstream_open %s  etype %d->%s  flags %02X\r\n",  src->url, etype, av_get_etype_name(etype), _flags );	
 
 	if( stream_force_error ) {
@@ -2581,10 +2615,13 @@ static void _put_frame_in_sink( STREAM *s, VIDEO_FRAME *frame, int time )
 	frame->aspect_d = s->video->aspect_d;
 	frame->duration = s->video->msPerFrame; // ts
 				
+	int start = time_update_time();
 	pthread_mutex_lock( &s->video_sink_mutex );
 	s->sink_delay = frame->blit_time - s->video_sink->put( s->video_sink, frame ); 	
 	s->video_sink_count ++;
 	pthread_mutex_unlock( &s->video_sink_mutex );
+	stream_stats_add( &s->stats, STREAM_STAGE_SINK, time_update_time() - start );
+	stream_stats_count( &s->stats.video_shown );
 DBGQ serprintf("OUT[%2d|%2d] ", frame->index, frame_q_count( &s->decode_q ) );
 	if( s->play_n_video_one ) {
 		s->play_n_video_frames = 0;
@@ -2631,9 +2668,13 @@ static void _output_frame_no_resize( STREAM *s, VIDEO_FRAME *frame, VIDEO_FRAME
 		goto Discard;
 	}
 	
-	while( qframe && !_engine_abort( s ) && stream_sync_video( s, frame->time ) ) {
+	while( qframe && !_engine_abort( s ) ) {
+		unsigned seq = thread_event_seq( &s->sync_event );
+		if( !stream_sync_video( s, frame->time ) ) {
+			break;
+		}
 serprintf("#");
-		msec_sleep( 10 );
+		stream_wait_event( &s->sync_event, seq );
 	}
 		
 DBGV2 serprintf("  out %8d/%2d/%c", frame->time, frame->index, frame_type( frame->type ) );
@@ -2667,6 +2708,7 @@ DBG2 serprintf("stream_video:_output_frame_no_resize drop\n");
 				// sink_ref_time is ts
 				s->sink_ref_time -= s->video->msPerFrame;
 				frames_dropped ++;
+				stream_stats_count( &s->stats.video_dropped );
 DBGY serprintf("[-%8d] ", frame->time );
 				s->drop_count ++;
 				if( s->vtime_post_sink ) {
@@ -2682,6 +2724,7 @@ DBG2 serprintf("stream_video:_output_frame_no_resize double\n");
 				s->drop ++;
 				s->sink_ref_time += s->video->msPerFrame;
 				frames_doubled ++;
+				stream_stats_count( &s->stats.video_doubled );
 DBGY serprintf("[+%8d] ", frame->time );
 				if( s->vtime_post_sink ) {
 					VIDEO_TIME_IS_TS {
@@ -2727,6 +2770,7 @@ DBGQ serprintf(">%2d]", frame_q_count( &s->decode_q ) );
 
 void stream_audio_debug( STREAM *s, int samples, int decoded, int time )
 {
+	stream_stats_add( &s->stats, STREAM_STAGE_ADECODE, time );
 	do_avg_audio( &aud_avg, time, samples, s->audio );
 	t_adecode       += time;
 	t_adecode_bytes += decoded;
@@ -2814,6 +2858,7 @@ serprintf("flush: no decode frame\r\n");
 			if( ret ) {
 				// error!
 serprintf("video_decode_error(%d)!\r\n", decoded);
+				stream_stats_count( &s->stats.video_errors );
 				// signal error in case the codec did not
 				if( s->vcodec.decode_frame )
 					s->vcodec.decode_frame->error = 1;
@@ -2826,6 +2871,7 @@ serprintf("video_decode_error(%d)!\r\n", decoded);
 			msec_sleep( stream_vcodec_delay );
 			s->vcodec.time += 10 * (atime() - delay);
 		}
+		stream_stats_add( &s->stats, STREAM_STAGE_VDECODE, s->vcodec.time );
 GOT_NO_FRAME:
 		if( s->vcodec.decode_frame ) {
 GOT_FRAME:
@@ -2896,6 +2942,7 @@ DBGV1 WAIT("DE");
 			pthread_cond_signal(&s->video_done);
 //DBGV1 WAIT("DE1");
 			pthread_mutex_unlock(&s->video_done_mutex);
+			thread_event_signal( &s->frame_event );
 //DBGV1 WAIT("DE");
 			sched_yield();
 		}
@@ -2921,6 +2968,7 @@ static void *_parser_thread( void *data )
 DBGS serprintf("PID[%5d] stream_parser_thread::Starting\r\n", getpid() );	
 	
 	while( thread_state_get( &s->parser_tstate ) != THREAD_EXIT ) {
+		unsigned idle_seq = thread_event_seq( &s->space_event );
 		thread_state_ack( &s->parser_tstate );
 		yield = 1;
 		if( thread_state_get( &s->parser_tstate ) == THREAD_RUNNING ) {
@@ -2930,7 +2978,17 @@ DBGS serprintf("PID[%5d] stream_parser_thread::Starting\r\n", getpid() );
 					s->parser_parse_once--;
 					
 				if( !stream_no_parser ) {
+					unsigned chunk_seq = thread_event_seq( &s->chunk_event );
+					unsigned space_seq = thread_event_seq( &s->space_event );
+					int start = time_update_time();
 					s->parser->parse( s );
+					stream_stats_add( &s->stats, STREAM_STAGE_PARSE, time_update_time() - start );
+
+					// queued something: parse on, else wait until the decoders made room
+					if( thread_event_seq( &s->chunk_event ) == chunk_seq ) {
+						stream_wait_event( &s->space_event, space_seq );
+					}
+					yield = 0;
 
 					if( atime() > last_time + 100 ) {
 						last_time = atime();
@@ -2946,7 +3004,8 @@ DBGS serprintf("PID[%5d] stream_parser_thread::Starting\r\n", getpid() );
 		}
 		
 		if( yield ) {
-			stream_yield_RT();
+			// paused or stopped, a decoder taking chunks means we are needed again
+			stream_wait_event( &s->space_event, idle_seq );
 		} 
 	}
 DBGS serprintf("PID[%5d] stream_parser_thread::Exiting\r\n", getpid() );	
@@ -2964,6 +3023,7 @@ static void *_player_thread( void *data )
 DBGS serprintf("PID[%5d] stream_player_thread::Starting\r\n", getpid() );	
 	
 	while( thread_state_get( &s->engine_tstate ) != THREAD_EXIT ) {
+		unsigned frame_seq = thread_event_seq( &s->frame_event );
 		thread_state_ack( &s->engine_tstate );
 		s->engine_yield = 1;
 		if( thread_state_get( &s->engine_tstate ) == THREAD_RUNNING ) {
@@ -2973,7 +3033,13 @@ DBGS serprintf("PID[%5d] stream_player_thread::Starting\r\n", getpid() );
 		}
 		
 		if( s->engine_yield ) {
-			stream_yield_RT();
+			if( s->player == _stream_player_async ) {
+				// async decoders hand out frames without telling us, keep polling them
+				stream_yield_RT();
+			} else {
+				// nothing to decode into, wait for the sink to give a frame back
+				stream_wait_event( &s->frame_event, frame_seq );
+			}
 		} 
 	}
 DBGS serprintf("PID[%5d] stream_player_thread::Exiting\r\n", getpid() );	
@@ -3233,8 +3299,22 @@ static void _get_next_chunk( STREAM *s )
 DBGS serprintf("video end\r\n");
 						s->video_end = 1;
 					}
+					// decoders holding frames back get empty chunks until nothing comes out
+					if( s->video_dec && s->video_dec->drain && s->video_drain != 2 ) {
+						memset( &s->cdata_next, 0, sizeof( STREAM_CDATA ) );
+						s->cdata_next.valid = 1;
+						s->cdata_next.key   = 1;
+						s->cdata_next.time  = -1;
+						s->cdata_next.pos   = -1;
+						s->video_drain      = 1;
+					}
+				} else if( !s->stats.video_empty ) {
+					s->stats.video_empty = 1;
+					stream_stats_count( &s->stats.video_starved );
 				}
 			} else {
+				s->stats.video_empty  = 0;
+				s->stats.video_bytes += s->cdata_next.size;
 				stream_put_chunk_cache( &s->cc, s->cbe, &s->cdata_next );
 			}
 		}
@@ -3255,11 +3335,11 @@ DBGS serprintf("video end\r\n");
 		if( s->cdata_now.pos != -1 ) {
 			s->video_pos = s->cdata_now.pos;
 		}
-		if( s->video_dumper) {
+		if( s->video_dumper && s->cdata_now.size ) {
 			s->video_dumper->write( s, cbe_get_p( s->cbe ), &s->cdata_now );
 		}
 		// is there a pre_mangler, then call it!
-		if( s->video_mangler ) {
+		if( s->video_mangler && s->cdata_now.size ) {
 			s->video_mangler->pre( s, s->cbe, &s->cdata_now );
 		}	
 	}
@@ -3288,6 +3368,7 @@ static int _droppable( STREAM *s, int type )
 	if( s->drop > 0 && s->video->format == VIDEO_FORMAT_MJPG ) {
 		s->drop --;
 		frames_dropped ++;
+		stream_stats_count( &s->stats.video_dropped );
 		return 1;
 	}
 	
@@ -3298,6 +3379,7 @@ serprintf("b!");
 			s->drop --;
 			frames_B_dropped ++;
 		}
+		stream_stats_count( &s->stats.video_B_dropped );
 
 		return 1;
 	}
@@ -3346,7 +3428,9 @@ DBGQ2 serprintf("\r\nDEC[%2d]  DISP[%2d]  ", frame_q_count( &s->decode_q ), fram
 // *****************************************************************************
 static void _stream_player_sync( STREAM *s )
 {
+	unsigned chunk_seq;
 DECODE_AGAIN:
+	chunk_seq = thread_event_seq( &s->chunk_event );
 	if( s->video->valid && s->use_sink_frames ) {
 		pthread_mutex_lock( &s->video_sink_mutex );
 		_queue_sink_frames( s );
@@ -3379,7 +3463,8 @@ DECODE_AGAIN:
 
 	if( !s->cdata_now.valid ) {
 DBGV serprintf("!" );				
-		msec_sleep( 10 );
+		stream_wait_event( &s->chunk_event, chunk_seq );
+		s->engine_yield = 0;
 		return;
 	}
 
@@ -3516,6 +3601,7 @@ cdata_time  = s->cdata_now.time;
 		output_frames( s );
 	}
 
+	stream_stats_sample( s );
 	_print_debug( s );
 DBGV1 WAIT("W")
 
@@ -3543,19 +3629,29 @@ DBGV1 serprintf(" w ");
 	}
 	pthread_mutex_unlock(&s->video_done_mutex);
 #else
-	while( s->vcodec.done != 2 ) {
+	while( 1 ) {
+		unsigned frame_seq = thread_event_seq( &s->frame_event );
+		if( s->vcodec.done == 2 ) {
+			break;
+		}
 		if( _engine_abort( s ) ) {
 			return;
 		}
 		if( !s->paused )
 			_do_stuff( s );
-		stream_yield_RT();
+		// the decode thread signals when it is done
+		stream_wait_event( &s->frame_event, frame_seq );
 	}
 #endif
 SKIP_DECODE:
 	// get back the decoded frame
 	s->decode_frame = s->vcodec.decode_frame;
 
+	if( s->video_drain == 1 && (!s->decode_frame || !s->decode_frame->valid) ) {
+DBGS serprintf("video drained\r\n");
+		s->video_drain = 2;
+	}
+
 DBGV1 WAIT("E")
 DBGV1 serprintf("\r\n");
 
@@ -3954,6 +4050,7 @@ static void _seek_init( STREAM *s )
 	s->cdata_next.valid = 0;
 
 	s->cdata_sub.valid  = 0;
+	s->video_drain      = 0;
 
 	if ( s->video->needs_header ) {
 		s->video->header_sent = 0;
@@ -5083,6 +5180,7 @@ DECLARE_DEBUG_TOGGLE ("ssy", 	stream_no_sync  );
 DECLARE_DEBUG_COMMAND("sso", 	_stream_no_output  );
 DECLARE_DEBUG_TOGGLE ("spa", 	stream_no_parser  );
 DECLARE_DEBUG_PARAM  ("sps", 	stream_parser_sleep  );
+DECLARE_DEBUG_PARAM  ("set", 	stream_event_timeout  );
 DECLARE_DEBUG_COMMAND("spu", 	_stream_parser_pause );
 DECLARE_DEBUG_PARAM  ("spm", 	stream_parser_max  );
 DECLARE_DEBUG_PARAM  ("smb", 	stream_buffer_size  );
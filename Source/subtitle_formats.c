@@ -22,10 +22,10 @@
 #include "util.h"
 #include "i18n.h"
 #include "browse.h"
-#include "device_config.h"
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <stdlib.h>		// for some reason atoi() not from astdlib :(
 
 #ifdef CONFIG_SUBTITLES
@@ -95,12 +95,95 @@ serprintf("\r\n");
 DECLARE_DEBUG_COMMAND_VOID( "subd", _dump_formats ); 
 #endif
 
+// ************************************************************
+//
+//	_mem_open
+//
+// ************************************************************
+// a read only FILE on top of a buffer, so the parsers can use
+// the transcoded text without going through a temporary file
+#ifdef CONFIG_ANDROID
+// bionic has no fmemopen() before API 23, use funopen() instead
+typedef struct MEM_FILE {
+	const unsigned char *data;
+	int size;
+	int pos;
+} MEM_FILE;
+
+static int _mem_read( void *cookie, char *buf, int size )
+{
+	MEM_FILE *m = (MEM_FILE*)cookie;
+	int left = m->size - m->pos;
+	if( size > left )
+		size = left;
+	memcpy( buf, m->data + m->pos, size );
+	m->pos += size;
+	return size;
+}
+
+static fpos_t _mem_seek( void *cookie, fpos_t offset, int whence )
+{
+	MEM_FILE *m = (MEM_FILE*)cookie;
+	fpos_t pos;
+	switch( whence ) {
+	case SEEK_SET: pos = offset;           break;
+	case SEEK_CUR: pos = m->pos  + offset; break;
+	case SEEK_END: pos = m->size + offset; break;
+	default:       return -1;
+	}
+	if( pos < 0 || pos > m->size )
+		return -1;
+	m->pos = pos;
+	return pos;
+}
+
+static int _mem_close( void *cookie )
+{
+	afree( cookie );
+	return 0;
+}
+
+static FILE *_mem_open( const unsigned char *data, int size )
+{
+	MEM_FILE *m = amalloc( sizeof( MEM_FILE ) );
+	if( !m )
+		return NULL;
+	m->data = data;
+	m->size = size;
+	m->pos  = 0;
+	FILE *file = funopen( m, _mem_read, NULL, _mem_seek, _mem_close );
+	if( !file )
+		afree( m );
+	return file;
+}
+#else
+static FILE *_mem_open( const unsigned char *data, int size )
+{
+	return fmemopen( (void*)data, size, "r" );
+}
+#endif
+
+// ************************************************************
+//
+//	subtitle_open
+//
+// ************************************************************
+// opens the text of a subtitle file for the parsers, either
+// from the in memory UTF-8 copy or from the file itself
+FILE *subtitle_open( subt_orig *subs )
+{
+	if( subs->data ) {
+		return _mem_open( subs->data, subs->size );
+	}
+	return fopen( subs->filename, "r" );
+}
+
 /*************
  * Opens a given filename and if subtitle format is found
  * allocates room for new. Also extract metadata information if such
  * exists for format
  *  * ********************/
-static subt_orig *subtitle_parse_file( const char *filename, const char *org_name, const char *ext, const char *lang, int utf8, int delete )
+static subt_orig *subtitle_parse_file( const char *filename, const char *ext, const char *lang, int utf8, unsigned char *data, int size )
 {
 	subt_orig *new_title = NULL;
 
@@ -113,7 +196,7 @@ static subt_orig *subtitle_parse_file( const char *filename, const char *org_nam
 		return 0;
 	}
 		
-	FILE *file = fopen( filename, "r" );
+	FILE *file = data ? _mem_open( data, size ) : fopen( filename, "r" );
 	if ( !file ) {
 		DBG serprintf( "could not open file! %s\n", filename );
 		return NULL;
@@ -123,15 +206,16 @@ static subt_orig *subtitle_parse_file( const char *filename, const char *org_nam
 	if ( ff != NULL ) {
 		new_title = acalloc(1, sizeof( subt_orig ) );
 		new_title->filename = amalloc( strlen( filename ) + 1 );
-		new_title->org_name = amalloc( strlen( org_name ) + 1 );
+		new_title->org_name = amalloc( strlen( filename ) + 1 );
 		strcpy( new_title->filename, filename );
-		strcpy( new_title->org_name, org_name );
+		strcpy( new_title->org_name, filename );
 		strcpy( new_title->ext,  ext );
 		strcpy( new_title->lang, lang );
 		
 		new_title->format    = ff;
 		new_title->utf8      = utf8;
-		new_title->delete    = delete;
+		new_title->data      = data;
+		new_title->size      = size;
 		new_title->next      = 0;
 		new_title->lan_count = 0;
 		
@@ -242,10 +326,10 @@ DBG serprintf("ext [%s]  lang [%s] -> [%s]\n", title->ext, title->lang, sub_arra
 			}
 			count += i;
 		}
-		if( title->delete ) {
-DBG serprintf("sub: delete %s\n", title->filename );		
-			file_remove( title->filename );
-		}
+		// everything is parsed, drop the in memory copy
+		afree( title->data );
+		title->data = NULL;
+		title->size = 0;
 		title = title->next;
 	}
 
@@ -365,22 +449,50 @@ void subtitle_clean_error(uni_sub *subs)
 #define BOM_UTF8 0xBFBBEF
 
 #define BUF_MAX 1024
-#define TMP_FILE "/tmp/subXXXXXX"
 
 #define CHECK_MAX 256
 
-static int convert_to_utf8( char **filename, int *delete )
+// ************************************************************
+//
+//	_utf16_to_utf8
+//
+// ************************************************************
+// transcodes the rest of the file in one pass, all in RAM
+static unsigned char *_utf16_to_utf8( FILE *file, int swap, int *size )
+{
+	struct stat st;
+	if( fstat( fileno( file ), &st ) || st.st_size <= 2 ) {
+		return NULL;
+	}
+	int utf16_len = (st.st_size - 2) / 2;
+	unsigned short *utf16 = amalloc( utf16_len * 2 );
+	if( !utf16 ) {
+		return NULL;
+	}
+	utf16_len = fread( utf16, 2, utf16_len, file );
+	if( swap ) {
+		swap16_buf( (unsigned char*)utf16, utf16_len * 2 );
+	}
+	// worst case is 3 bytes per UTF-16 unit, plus the terminator
+	unsigned char *utf8 = amalloc( utf16_len * 3 + 1 );
+	if( utf8 ) {
+		*size = unicode_utf16_to_utf8( utf8, utf16, utf16_len );
+	}
+	afree( utf16 );
+	return utf8;
+}
+
+static int convert_to_utf8( const char *filename, unsigned char **data, int *size )
 {
 	int ret;
-	int tmp_fd = -1;
-	FILE *tmp_file = NULL;
 	FILE *file = NULL;
 
-	file = fopen( *filename, "r");
+	*data = NULL;
+	*size = 0;
+	file = fopen( filename, "r");
 	if (!file) {
 		return 0;
 	}
-	*delete = 0;
 	
 	// check for BOM
 	unsigned short bom = 0;
@@ -400,7 +512,9 @@ DBG serprintf("sub: UTF-8 by BOM!\n");
 		int len;
 		int count = 0;
 		while( (len = fread(buf, 1, BUF_MAX, file)) && count ++ < CHECK_MAX ) {
-			I18N_check_encoding_update( ctx, buf, len);
+			// stop reading at the first byte that is not valid UTF-8
+			if( I18N_check_encoding_update( ctx, buf, len) )
+				break;
 		}
 		int utf8;
 		I18N_check_encoding_finish( ctx, &utf8 );
@@ -415,57 +529,17 @@ DBG serprintf("sub: CODEPAGE!\n");
 	}
 DBG serprintf("sub: UTF-16!\n");
 
-#ifdef CONFIG_ANDROID
-	char template[256];
-	snprintf(template, 255, "/data/data/%s/files/sub", device_config_get_android_pkg_name());
-	tmp_fd = open(template, O_CREAT|O_RDWR, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP);
-	chmod(template, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP);
-#else
-	char template[] = TMP_FILE;
-	
-	tmp_fd = mkstemp(template);
-#endif
-
-	if (tmp_fd < 0) {
-		serprintf("failed to create temporary file: %s\n", template );
+	*data = _utf16_to_utf8( file, bom == BOM_LE, size );
+	if( !*data ) {
+		serprintf("sub: failed to convert %s to UTF-8\n", filename );
 		ret = 0;
 		goto end;
 	}
-DBG serprintf("sub: tmpfile: %s\n", template );
-
-	tmp_file = fdopen(tmp_fd, "w+");
-	if (!tmp_file) {
-		serprintf("failed to open temporary file for writing (%s:%i)\n", __FILE__, __LINE__);
-		ret = 0;
-		goto end;
-	}
-
-	unsigned short utf16[BUF_MAX];
-	unsigned char  utf8[BUF_MAX * 3];
-	while( 1 ) {
-		int utf16_len = fread( utf16, 2, BUF_MAX, file );
-		if( !utf16_len ) {
-			break;
-		}
-		if( bom == BOM_LE ) {
-			swap16_buf( (unsigned char*)utf16, utf16_len * 2 );
-		}
-		int utf8_len  = unicode_utf16_to_utf8( utf8, utf16, utf16_len );
-//serprintf("in %3d out %3d  %s\n", utf16_len, utf8_len, utf8 );	
-		fwrite( utf8, 1, utf8_len, tmp_file );
-	}
-	
-	afree( *filename );
-	*filename = astrdup( template );
-	*delete   = 1;
+DBG serprintf("sub: %d bytes of UTF-8 in memory\n", *size );
 	ret = 1;
 end:
 	if( file )
 		fclose( file );
-	if( tmp_file )
-		fclose( tmp_file );
-	if( tmp_fd > -1 )
-		close( tmp_fd );
 	return ret;
 }
 
@@ -581,17 +655,16 @@ DBG serprintf("checking path: %s\n", *path );
 	int i;
 	for ( i = 0; i < count; ++i ) {
 DBG serprintf("sub: check: %s\r\n", sub_files[i] );
-		// get ext and lang here as the filename could be mangled by utf16 conversion!
+		// get ext and lang from the name, e.g. movie.eng.srt
 		char ext[4]  = { 0 };
 		char lang[4] = { 0 };
 		strnZcpy( ext,  get_extension( sub_files[i] ), 3 );
 		strnZcpy( lang, get_extension( cut_extension( sub_files[i] )), 3 );
 
-		int delete = 0;
-		char *org_name = astrdup( sub_files[i] );
-		int utf8 = convert_to_utf8( &(sub_files[i]), &delete );
-		subtitle_file = subtitle_parse_file( sub_files[i], org_name, ext, lang, utf8, delete );
-		afree( org_name );
+		unsigned char *data;
+		int size;
+		int utf8 = convert_to_utf8( sub_files[i], &data, &size );
+		subtitle_file = subtitle_parse_file( sub_files[i], ext, lang, utf8, data, size );
 		if ( subtitle_file ) {
 			if ( !usable_files ) {
 				usable_files = acalloc(1, sizeof( subtitle_files ) );
@@ -605,10 +678,7 @@ DBG serprintf("sub: check: %s\r\n", sub_files[i] );
 			}
 			usable_files->count++;
 		} else {
-			if( delete ) {
-DBG serprintf("sub: delete %s\n", sub_files[i] );		
-				file_remove( sub_files[i] );
-			}
+			afree( data );
 		}
 		afree( sub_files[i] );
 	}
@@ -649,6 +719,7 @@ static void free_subs( subt_orig * fd )
 	while ( fd ) {
 		afree( fd->filename );
 		afree( fd->org_name );
+		afree( fd->data );
 		if ( fd->title_langs )
 			free_coding( fd->title_langs, fd->lan_count );
 		afree( fd->default_language );
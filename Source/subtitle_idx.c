@@ -144,7 +144,7 @@ serprintf( "IDX: Invalid filename\n" );
 		return 0;
 	}
 	
-	FILE *fd = fopen( spex->filename, "r" );
+	FILE *fd = subtitle_open( spex );
 	if ( !fd ) {
 serprintf( "IDX: cannot read %s\n", spex->filename );
 		return 0;
@@ -676,7 +676,7 @@ static uni_sub *parse_SMI( subt_orig *subs, int clean_tags )
 		DBG serprintf( "Subtitle: parseSMI: <NULL> filename>\n" );
 		return 0;
 	}
-	file = fopen( subs->filename, "r" );
+	file = subtitle_open( subs );
 	if ( !file ) {
 		DBG serprintf( "subtitle: parseSMI: could not open file %s\n", subs->filename );
 		return 0;
@@ -163,7 +163,7 @@ DBG serprintf( "SRT: Invalid parameter\n" );
 DBG serprintf( "SRT: Invalid filename parameter\n" );
 		goto CLEAR_ERROR;
 	}
-	fd = fopen( spex->filename, "r" );
+	fd = subtitle_open( spex );
 	if( !fd )
 		goto CLEAR_ERROR;
 	line = subtitle_get_next_line( line, LINE_LEN, fd );
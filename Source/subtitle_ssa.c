@@ -221,7 +221,7 @@ static uni_sub *parse_SSA( subt_orig *spex, int clean_tags )
 	if(!spex->filename){
 		return 0;
 	}
-	FILE *fd = fopen(spex->filename,"r");
+	FILE *fd = subtitle_open(spex);
 	if(!fd){
 		DBG serprintf("Subtitle: parse_SSA, could not open file %s\n",spex->filename);
 		return 0;
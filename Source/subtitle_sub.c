@@ -159,7 +159,7 @@ static uni_sub *parse_SUB( subt_orig *spex, int clean_tags )
 		return 0;
 	}
 	
-	FILE *fd = fopen( spex->filename, "r" );
+	FILE *fd = subtitle_open( spex );
 	if ( !fd ) {
 		DBG serprintf( "Subtitle:parseSUB: could not read file %s\n", spex->filename );
 		return 0;
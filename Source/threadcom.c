@@ -18,20 +18,54 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <sched.h>
+#include <sys/eventfd.h>
 
 #include "threadcom.h"
 #include "debug.h"
 #include "astdlib.h"
+#include "atime.h"
 #include "dataevent.h"
 #include "global.h"
 
 #define ERR	if (1)
 #define DBG	if (0)
 
+/*
+ * Messages go through a ring in the link, the eventfd is only the
+ * doorbell that wakes up the data_event loop. Posters claim slots with
+ * a compare and swap on head and never lock, the single reader (the
+ * callback) walks tail. A message takes one or more consecutive slots,
+ * it is published by the seq of its first slot:
+ *
+ *	seq == pos			free for the poster of pos
+ *	seq == pos + 1			message at pos ready to read
+ *	seq == pos + RING_SLOTS		read, free for the next lap
+ *
+ * The doorbell is written when 'rung' goes from 0 to 1 and reset when
+ * the reader finds the ring empty, so a burst costs one write and one
+ * read, whatever number of messages it has. The fd stays readable as
+ * long as there is something in the ring.
+ */
+#define RING_SLOTS	1024		// power of two
+#define RING_MASK	(RING_SLOTS - 1)
+#define SLOT_DATA	56
+
+typedef struct {
+	volatile unsigned	seq;
+	int			len;		// message length, first slot only
+	unsigned char		data[SLOT_DATA];
+} ring_slot_t;
+
 struct threadcom_link {
 	data_event_t		de;
-	int 			pipe[2];
+	int			efd;
+	volatile int		rung;
 	threadcom_event_t	event;
+	volatile unsigned	head;		// next position to claim
+	unsigned		tail;		// next position to read
+	ring_slot_t		ring[RING_SLOTS];
 };
 
 static void _event_callback(void* context) 
@@ -40,71 +74,133 @@ static void _event_callback(void* context)
 	link->event(link);
 }
 
-static inline int _post_event(threadcom_link_t* link, const void* data, ssize_t len)
+static inline unsigned _slots(ssize_t len)
 {
-	int ret;
-	
-	/* write the length first */
-	ret = write(link->pipe[1], &len, sizeof(len));
-	if (ret < 0) {
+	return len <= SLOT_DATA ? 1 : (len + SLOT_DATA - 1) / SLOT_DATA;
+}
+
+static inline int _ready(threadcom_link_t* link)
+{
+	return link->ring[link->tail & RING_MASK].seq == link->tail + 1;
+}
+
+static void _ring(threadcom_link_t* link)
+{
+	uint64_t one = 1;
+	if (write(link->efd, &one, sizeof(one)) < 0) {
 ERR		serprintf("threadcom_post_event: write failed (%s)\n", strerror(errno));
-		return 1;
 	}
-		
-	/* then write the data portion */
-	ret = write(link->pipe[1], data, len);
-	if (ret < 0) {
-ERR		serprintf("threadcom_post_event: write failed (%s)\n", strerror(errno));
+}
+
+/* the ring looked empty: reset the doorbell, unless something came in meanwhile */
+static void _quiet(threadcom_link_t* link)
+{
+	uint64_t cnt;
+
+	link->rung = 0;
+	__sync_synchronize();
+	read(link->efd, &cnt, sizeof(cnt));
+	__sync_synchronize();
+	if (_ready(link)) {
+		link->rung = 1;
+		_ring(link);
+	}
+}
+
+static inline int _post_event(threadcom_link_t* link, const void* data, ssize_t len)
+{
+	unsigned k = _slots(len);
+	unsigned pos, i;
+	int waits = 0;
+
+	if (k > RING_SLOTS) {
+ERR		serprintf("threadcom_post_event: event too large (%i)\n", len);
 		return 1;
 	}
 
+	/* claim k consecutive slots */
+	for (;;) {
+		pos = link->head;
+		for (i = 0; i < k; i++) {
+			if (link->ring[(pos + i) & RING_MASK].seq != pos + i)
+				break;
+		}
+		if (i == k) {
+			if (__sync_bool_compare_and_swap(&link->head, pos, pos + k))
+				break;
+		} else if ((int)(link->ring[(pos + i) & RING_MASK].seq - (pos + i)) < 0) {
+			/* full, the reader is a lap behind: wait like a full pipe would,
+			 * it is usually draining on another core right now */
+			if (waits++ < 100)
+				sched_yield();
+			else
+				msec_sleep(1);
+		}
+	}
+
+	const unsigned char *src = data;
+	ssize_t left = len;
+	for (i = 0; i < k; i++) {
+		int n = left < SLOT_DATA ? left : SLOT_DATA;
+		memcpy(link->ring[(pos + i) & RING_MASK].data, src, n);
+		src  += n;
+		left -= n;
+	}
+	link->ring[pos & RING_MASK].len = len;
+	__sync_synchronize();
+	link->ring[pos & RING_MASK].seq = pos + 1;
+
+	if (__sync_val_compare_and_swap(&link->rung, 0, 1) == 0)
+		_ring(link);
+
 	return 0;
 }
 
 static inline int _get_event(threadcom_link_t* link, void* data, ssize_t len)
 {
-	int ret;
-	size_t msg_len;
-	
-	/* 
-	 * read the length of the message. The read is non-blocking, 
-	 * so that we can exit without blocking if no message is in the pipe.
-	 * however, the rest of the function relies on blocking reads, so we
-	 * undo the O_NONBLOCK immediately.
-	 */
-	fcntl(link->pipe[0], F_SETFL, fcntl(link->pipe[0], F_GETFL)|O_NONBLOCK);
-	ret = read(link->pipe[0], &msg_len, sizeof(msg_len));
-	fcntl(link->pipe[0], F_SETFL, fcntl(link->pipe[0], F_GETFL)& ~O_NONBLOCK);
-	if (ret < 0) {
-		/* if the pipe is empty, exit immediately, however this is not an
-		 * error condition.*/
-		if (errno == EAGAIN)
+	unsigned pos = link->tail;
+	unsigned k, i;
+	int ret = 0;
+
+	if (!_ready(link)) {
+		/* no message in the ring is not an error condition */
+		if (link->rung)
+			_quiet(link);
+		if (!_ready(link))
 			return 1;
-
-ERR		serprintf("threadcom_get_event: read failed (%s)\n", strerror(errno));
-		return 1;
 	}
+	__sync_synchronize();
+
+	ssize_t msg_len = link->ring[pos & RING_MASK].len;
+	k = _slots(msg_len);
 
 	/* compare the sizes */
 	if (len < msg_len) {
-		char tmp;
 ERR		serprintf("threadcom_get_event: insufficient space for event data (%i < %i)\n",
 				len, msg_len);
-				
-		/* sigh. but it's better than falling out of format */
-		while (msg_len--)
-			read(link->pipe[0], &tmp, 1);
-
-		return 1;
-	}
-	
-	ret = read(link->pipe[0], data, msg_len);
-	if (ret < 0) {
-ERR		serprintf("threadcom_get_event: read failed (%s)\n", strerror(errno));
-		return 1;
+		/* drop it, better than falling out of format */
+		ret = 1;
+	} else {
+		unsigned char *dst = data;
+		for (i = 0; i < k; i++) {
+			int n = msg_len < SLOT_DATA ? msg_len : SLOT_DATA;
+			memcpy(dst, link->ring[(pos + i) & RING_MASK].data, n);
+			dst     += n;
+			msg_len -= n;
+		}
 	}
 
-	return 0;
+	/* hand the slots to the next lap */
+	__sync_synchronize();
+	for (i = 0; i < k; i++)
+		link->ring[(pos + i) & RING_MASK].seq = pos + i + RING_SLOTS;
+	link->tail = pos + k;
+
+	/* no callback for an empty ring */
+	if (!_ready(link))
+		_quiet(link);
+
+	return ret;
 }
 
 /**
@@ -112,15 +208,20 @@ ERR		serprintf("threadcom_get_event: read failed (%s)\n", strerror(errno));
  */
 threadcom_link_t* __threadcom_init(threadcom_link_t* link, threadcom_event_t event, data_event_t *data_events, const char* from)
 {
+	unsigned i;
+
 	memset(link, 0, sizeof(*link));
+	for (i = 0; i < RING_SLOTS; i++)
+		link->ring[i].seq = i;
 	
-	if (pipe(link->pipe) < 0) {
-ERR		serprintf("threadcom_create: error creating pipe handles: %s\n", strerror(errno));
+	link->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (link->efd < 0) {
+ERR		serprintf("threadcom_create: error creating eventfd: %s\n", strerror(errno));
 		goto out;
 	}
 	
-	/* we've got the pipe set up, register the data events now */
-	link->de.fd = link->pipe[0];
+	/* we've got the doorbell set up, register the data events now */
+	link->de.fd = link->efd;
 	link->de.read_func = _event_callback;
 	link->event = event;
 	if (__register_data_event(data_events, &link->de, link, from)) {
@@ -131,8 +232,7 @@ ERR		serprintf("threadcom_create: error registering data event\n");
 	return link;
 
  out_close:
- 	close(link->pipe[0]);
- 	close(link->pipe[1]);
+ 	close(link->efd);
  out:
  	return NULL;
 }
@@ -166,8 +266,7 @@ int __threadcom_release(threadcom_link_t* link)
 
 	unregister_data_event(&link->de);
 	
-	close(link->pipe[0]);
-	close(link->pipe[1]);
+	close(link->efd);
 
 	return 0;
 }
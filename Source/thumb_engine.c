@@ -0,0 +1,720 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "types.h"
+#include "global.h"
+#include "astdlib.h"
+#include "debug.h"
+#include "util.h"
+#include "image.h"
+#include "av.h"
+#include "athread.h"
+#include "stream_error.h"
+#include "codec_utils.h"
+#include "device_config.h"
+#include "thumb_engine.h"
+
+#if defined(CONFIG_VIDEO) && defined(CONFIG_FFMPEG_PARSER)
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ERR  if(1)
+#define DBG  if(Debug[DBG_THUMB])
+#define DBG2 if(Debug[DBG_THUMB] > 1)
+
+#define THUMB_TIME		(200 * 1000)	// same default as the STREAM thumbnails
+#define THUMB_MAX_KEYS		8		// keyframes tried before giving up
+#define THUMB_MAX_PACKETS	4096
+#define THUMB_FRAMES		4		// decoder pictures per job in the memory budget
+#define THUMB_IO_MEM		(4 * 1024 * 1024)	// demuxer and probing, the probesize as well
+#define THUMB_MAX_THREADS	16
+#define THUMB_DEFAULT_MEM	64		// MB
+#define THUMB_MAX_TILES		1024
+
+static int use_thumb_engine = 1;
+static int use_lowres       = 1;
+
+DECLARE_DEBUG_TOGGLE("the",  use_thumb_engine );
+DECLARE_DEBUG_TOGGLE("thlr", use_lowres );
+
+extern void av_log_cb(void*, int, const char*, va_list);
+extern int  stream_parser_ffmpeg_open_input( AVFormatContext **fmt, const char *url, AVDictionary **opts );
+
+typedef struct THUMB_BUDGET {
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	INT64		left;
+	int		users;
+	int		growing;	// users waiting in _grow()
+} THUMB_BUDGET;
+
+typedef struct THUMB_BATCH {
+	THUMB_JOB	*jobs;
+	int		count;
+	volatile int	next;
+	THUMB_BUDGET	budget;
+} THUMB_BATCH;
+
+typedef struct THUMB_CTX {
+	AVFormatContext	*fmt;
+	AVCodecContext	*vctx;
+	AVFrame		*frame;
+	AVStream	*st;
+	AVCodecParameters *par;
+	int		stream;
+	INT64		start_time;	// stream time base
+	INT64		duration;	// ms
+	INT64		time;		// ms of the decoded picture, -1 if unknown
+	int		rotation;
+} THUMB_CTX;
+
+static inline INT64 _ctx_time( THUMB_CTX *c, INT64 pts )
+{
+	return av_rescale_q( pts - c->start_time, c->st->time_base, (AVRational){ 1, 1000 } );
+}
+
+// ************************************************************
+//
+//	_reserve
+//
+// ************************************************************
+// a job larger than the whole budget still runs, alone
+static void _reserve( THUMB_BUDGET *b, INT64 size )
+{
+	if( !b )
+		return;
+	pthread_mutex_lock( &b->mutex );
+	while( b->users && size > b->left ) {
+		pthread_cond_wait( &b->cond, &b->mutex );
+	}
+	b->left -= size;
+	b->users++;
+	pthread_mutex_unlock( &b->mutex );
+}
+
+// ************************************************************
+//
+//	_grow
+//
+// ************************************************************
+// more for a job that already holds a share, when every user waits to
+// grow nobody would give anything back, then one of them goes over
+static void _grow( THUMB_BUDGET *b, INT64 size )
+{
+	if( !b )
+		return;
+	pthread_mutex_lock( &b->mutex );
+	b->growing++;
+	pthread_cond_broadcast( &b->cond );
+	while( size > b->left && b->users > b->growing ) {
+		pthread_cond_wait( &b->cond, &b->mutex );
+	}
+	b->growing--;
+	b->left -= size;
+	pthread_mutex_unlock( &b->mutex );
+}
+
+// ************************************************************
+//
+//	_release
+//
+// ************************************************************
+static void _release( THUMB_BUDGET *b, INT64 size )
+{
+	if( !b )
+		return;
+	pthread_mutex_lock( &b->mutex );
+	b->left += size;
+	b->users--;
+	pthread_cond_broadcast( &b->cond );
+	pthread_mutex_unlock( &b->mutex );
+}
+
+// ************************************************************
+//
+//	_map_pixfmt
+//
+// ************************************************************
+static int _map_pixfmt( int pix_fmt )
+{
+	switch( pix_fmt ) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		return PIXFMT_YUV420P;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		return PIXFMT_YUV422P;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return PIXFMT_YUV444P;
+	case AV_PIX_FMT_NV12:
+		return PIXFMT_NV12;
+	case AV_PIX_FMT_YUV420P10LE:
+		return PIXFMT_YUV420P10LE;
+	default:
+		return -1;
+	}
+}
+
+// ************************************************************
+//
+//	_fit
+//
+// ************************************************************
+// keeps the aspect, scales up only to reach a fixed width, even sizes for YUV_422
+static void _fit( int width, int height, int max_width, int max_height, int fixed_width, int *out_width, int *out_height )
+{
+	int w = width, h = height;
+
+	if( max_width > 0 && (w > max_width || (fixed_width && w < max_width)) ) {
+		h = (INT64)h * max_width / w;
+		w = max_width;
+	}
+	if( max_height > 0 && h > max_height ) {
+		w = (INT64)w * max_height / h;
+		h = max_height;
+	}
+	*out_width  = MAX( w & ~1, 2 );
+	*out_height = MAX( h & ~1, 2 );
+}
+
+// ************************************************************
+//
+//	_ctx_open
+//
+// ************************************************************
+// opens the file and picks the video stream, only its keyframes are demuxed
+static int _ctx_open( THUMB_CTX *c, const char *url )
+{
+	int i;
+
+	memset( c, 0, sizeof( THUMB_CTX ) );
+	c->stream = -1;
+	if( !use_thumb_engine || !url || url[0] != '/' ) {
+		return VE_FILE_ERROR;
+	}
+	av_log_set_callback( av_log_cb );
+	// probing stays within the I/O share of the budget
+	AVDictionary *opts = NULL;
+	av_dict_set_int( &opts, "probesize", THUMB_IO_MEM, 0 );
+	int err = stream_parser_ffmpeg_open_input( &c->fmt, url, &opts );
+	av_dict_free( &opts );
+	if( err ) {
+DBG serprintf("THUMB: cannot open %s\r\n", url );
+		return VE_FILE_ERROR;
+	}
+	for( i = 0; i < c->fmt->nb_streams; i++ ) {
+		AVStream *st = c->fmt->streams[i];
+		if( c->stream == -1 && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !(st->disposition & AV_DISPOSITION_ATTACHED_PIC) ) {
+			c->stream = i;
+			st->discard = AVDISCARD_NONKEY;
+		} else {
+			st->discard = AVDISCARD_ALL;
+		}
+	}
+	if( c->stream == -1 ) {
+		return VE_VIDEO_NOT_SUPPORTED;
+	}
+	c->st  = c->fmt->streams[c->stream];
+	c->par = c->st->codecpar;
+	if( c->par->width <= 0 || c->par->height <= 0 ) {
+		return VE_VIDEO_NOT_SUPPORTED;
+	}
+	c->start_time = c->st->start_time != AV_NOPTS_VALUE ? c->st->start_time : 0;
+	c->duration   = c->fmt->duration != AV_NOPTS_VALUE ? c->fmt->duration * 1000 / AV_TIME_BASE : 0;
+
+	AVDictionaryEntry *rotate = av_dict_get( c->st->metadata, "rotate", NULL, 0 );
+	if( rotate ) {
+		c->rotation = ((atoi( rotate->value ) % 360) + 360) % 360;
+	}
+	return VE_NO_ERROR;
+}
+
+// ************************************************************
+//
+//	_ctx_open_decoder
+//
+// ************************************************************
+// out_width/out_height is the largest picture that will be made from it
+static int _ctx_open_decoder( THUMB_CTX *c, int out_width, int out_height )
+{
+	AVCodec *codec = (AVCodec*)avcodec_find_decoder( c->par->codec_id );
+
+	if( !codec ) {
+		return VE_VIDEO_NOT_SUPPORTED;
+	}
+	if( !(c->vctx = avcodec_alloc_context3( codec )) || avcodec_parameters_to_context( c->vctx, c->par ) < 0 ) {
+		return VE_ERROR;
+	}
+	// the jobs run in parallel, not the slices of one picture
+	c->vctx->thread_count     = 1;
+	c->vctx->skip_loop_filter = AVDISCARD_ALL;
+	if( use_lowres ) {
+		// decode at 1/2, 1/4, 1/8 size when the thumbnail is small enough
+		while( c->vctx->lowres < codec->max_lowres &&
+		       (c->par->width >> (c->vctx->lowres + 1)) >= out_width && (c->par->height >> (c->vctx->lowres + 1)) >= out_height ) {
+			c->vctx->lowres++;
+		}
+	}
+	if( avcodec_open2( c->vctx, codec, NULL ) < 0 || !(c->frame = av_frame_alloc()) ) {
+		return VE_VIDEO_CODEC_ERROR;
+	}
+	return VE_NO_ERROR;
+}
+
+// ************************************************************
+//
+//	_ctx_seek
+//
+// ************************************************************
+// to the keyframe at or before time, not before min_time, -1 for none
+static int _ctx_seek( THUMB_CTX *c, INT64 time, INT64 min_time )
+{
+	INT64 ts  = c->start_time + av_rescale_q( time, (AVRational){ 1, 1000 }, c->st->time_base );
+	INT64 min = min_time < 0 ? INT64_MIN : c->start_time + av_rescale_q( min_time, (AVRational){ 1, 1000 }, c->st->time_base );
+
+	return avformat_seek_file( c->fmt, c->stream, min, ts, ts, 0 ) < 0;
+}
+
+// ************************************************************
+//
+//	_ctx_decode
+//
+// ************************************************************
+// one keyframe after min_time in, drain, one picture out
+static int _ctx_decode( THUMB_CTX *c, INT64 min_time )
+{
+	AVPacket packet = { 0 };
+	int keys = 0, packets = 0, got = 0;
+
+	while( !got && keys < THUMB_MAX_KEYS && packets++ < THUMB_MAX_PACKETS && av_read_frame( c->fmt, &packet ) >= 0 ) {
+		if( packet.stream_index == c->stream && (packet.flags & AV_PKT_FLAG_KEY) &&
+		    (min_time < 0 || packet.pts == AV_NOPTS_VALUE || _ctx_time( c, packet.pts ) > min_time) ) {
+			keys++;
+			if( avcodec_send_packet( c->vctx, &packet ) >= 0 && avcodec_send_packet( c->vctx, NULL ) >= 0 ) {
+				got = avcodec_receive_frame( c->vctx, c->frame ) >= 0;
+			}
+			// ready for the next keyframe, the drain left the decoder at EOF
+			avcodec_flush_buffers( c->vctx );
+		}
+		av_packet_unref( &packet );
+	}
+	if( !got ) {
+DBG serprintf("THUMB: no picture in %d keyframes\r\n", keys );
+		return VE_VIDEO_CODEC_ERROR;
+	}
+	c->time = c->frame->pts != AV_NOPTS_VALUE ? _ctx_time( c, c->frame->pts ) : -1;
+	return VE_NO_ERROR;
+}
+
+// ************************************************************
+//
+//	_ctx_convert
+//
+// ************************************************************
+// the decoded picture into dst->window
+static int _ctx_convert( THUMB_CTX *c, IMAGE *dst )
+{
+	int pixfmt = _map_pixfmt( c->frame->format );
+	if( pixfmt < 0 ) {
+ERR serprintf("THUMB: pixel format %d not supported\r\n", c->frame->format );
+		return VE_VIDEO_NOT_SUPPORTED;
+	}
+	if( codec_convert_scaled( pixfmt, c->frame->data, c->frame->linesize, c->frame->width, c->frame->height, dst ) ) {
+		return VE_VIDEO_NOT_SUPPORTED;
+	}
+	return VE_NO_ERROR;
+}
+
+// ************************************************************
+//
+//	_ctx_close
+//
+// ************************************************************
+static void _ctx_close( THUMB_CTX *c )
+{
+	av_frame_free( &c->frame );
+	avcodec_free_context( &c->vctx );
+	avformat_close_input( &c->fmt );
+}
+
+// ************************************************************
+//
+//	_get
+//
+// ************************************************************
+static int _get( THUMB_JOB *job, THUMB_BUDGET *budget )
+{
+	THUMB_CTX c;
+	INT64 reserved = 0;
+	int start = atime();
+
+	job->img      = NULL;
+	job->time_out = -1;
+	job->duration = 0;
+	job->rotation = 0;
+
+	if( job->colorspace != AV_IMAGE_YUV_422 && job->colorspace != AV_IMAGE_BGRA_32 && job->colorspace != AV_IMAGE_RGBX_32 ) {
+		job->error = VE_ERROR;
+		return 1;
+	}
+	// the demuxer and probing first, the decoder once the size is known
+	reserved = THUMB_IO_MEM;
+	_reserve( budget, reserved );
+
+	if( (job->error = _ctx_open( &c, job->url )) ) {
+		goto end;
+	}
+	job->duration = c.duration;
+	job->rotation = c.rotation;
+
+	int out_width, out_height;
+	_fit( c.par->width, c.par->height, job->max_width, job->max_height, job->fixed_width, &out_width, &out_height );
+
+	INT64 dec_mem = (INT64)c.par->width * c.par->height * 3 / 2 * THUMB_FRAMES + out_width * out_height * 4;
+	_grow( budget, dec_mem );
+	reserved += dec_mem;
+
+	if( (job->error = _ctx_open_decoder( &c, out_width, out_height )) ) {
+		goto end;
+	}
+
+	// the keyframe at or before the thumbnail time
+	if( c.duration > 0 ) {
+		INT64 time = (job->time != -1 && job->time <= c.duration) ? job->time : MIN( THUMB_TIME, c.duration / 2 );
+		if( time && _ctx_seek( &c, time, -1 ) ) {
+DBG serprintf("THUMB: seek to %lld failed, first keyframe\r\n", time );
+		}
+	} else {
+		INT64 size = c.fmt->pb ? avio_size( c.fmt->pb ) : -1;
+		if( size > 0 && avformat_seek_file( c.fmt, -1, INT64_MIN, size / 2, size / 2, AVSEEK_FLAG_BYTE ) < 0 ) {
+DBG serprintf("THUMB: seek to pos %lld failed, first keyframe\r\n", size / 2 );
+		}
+	}
+
+	if( (job->error = _ctx_decode( &c, -1 )) ) {
+		goto end;
+	}
+	job->time_out = c.time;
+
+	// lowres pictures keep the aspect, the limits apply again
+	_fit( c.frame->width, c.frame->height, job->max_width, job->max_height, job->fixed_width, &out_width, &out_height );
+	if( !(job->img = image_alloc( out_width, out_height, job->colorspace )) ) {
+		job->error = VE_ERROR;
+		goto end;
+	}
+	job->img->window = (RECT){ 0, 0, out_width, out_height };
+	if( (job->error = _ctx_convert( &c, job->img )) ) {
+		image_free( job->img );
+		job->img = NULL;
+		goto end;
+	}
+DBG serprintf("THUMB: %s at %d: %dx%d (lowres %d) -> %dx%d  took %d\r\n", job->url, job->time_out,
+		c.par->width, c.par->height, c.vctx->lowres, out_width, out_height, atime() - start );
+
+end:
+	_ctx_close( &c );
+	_release( budget, reserved );
+	return job->error != VE_NO_ERROR;
+}
+
+// ************************************************************
+//
+//	thumb_engine_get
+//
+// ************************************************************
+int thumb_engine_get( THUMB_JOB *job )
+{
+	return _get( job, NULL );
+}
+
+// ************************************************************
+//
+//	thumb_engine_strip
+//
+// ************************************************************
+// tile i shows the keyframe at or before the middle of the i-th of count
+// equal parts of the file. the file is read once from front to back,
+// seeks only go forward and a keyframe is never used twice
+int thumb_engine_strip( THUMB_STRIP *strip )
+{
+	THUMB_CTX c;
+	int i, start = atime();
+
+	strip->img    = NULL;
+	strip->times  = NULL;
+	strip->filled = 0;
+
+	if( strip->count <= 0 || strip->count > THUMB_MAX_TILES ||
+	    (strip->colorspace != AV_IMAGE_YUV_422 && strip->colorspace != AV_IMAGE_BGRA_32 && strip->colorspace != AV_IMAGE_RGBX_32) ) {
+		strip->error = VE_ERROR;
+		return 1;
+	}
+	if( (strip->error = _ctx_open( &c, strip->url )) ) {
+		goto end;
+	}
+	strip->duration = c.duration;
+	strip->rotation = c.rotation;
+	if( c.duration <= 0 ) {
+		strip->error = VE_ERROR;
+		goto end;
+	}
+
+	int tile_width, tile_height;
+	_fit( c.par->width, c.par->height, strip->tile_width, strip->tile_height, 0, &tile_width, &tile_height );
+	if( (strip->error = _ctx_open_decoder( &c, tile_width, tile_height )) ) {
+		goto end;
+	}
+
+	int columns = strip->columns > 0 ? MIN( strip->columns, strip->count ) : strip->count;
+	int rows    = (strip->count + columns - 1) / columns;
+	strip->tile_width  = tile_width;
+	strip->tile_height = tile_height;
+	strip->columns     = columns;
+	strip->rows        = rows;
+	if( !(strip->img = image_alloc( columns * tile_width, rows * tile_height, strip->colorspace )) ||
+	    !(strip->times = acalloc( strip->count, sizeof( int ) )) ) {
+		strip->error = VE_ERROR;
+		goto end;
+	}
+	// tiles that are never filled stay black
+	strip->img->window = (RECT){ 0, 0, strip->img->width, strip->img->height };
+	if( strip->colorspace == AV_IMAGE_YUV_422 ) {
+		image_fill_window( strip->img, YUV_BLACK );
+	} else {
+		// opaque black, the alpha byte is the top one in both layouts
+		int y;
+		for( y = 0; y < strip->img->height; y++ ) {
+			memset32( (uint32_t*)(strip->img->data[0] + y * strip->img->linestep[0]), 0xff000000, strip->img->width );
+		}
+	}
+
+	INT64 last = -1;
+	for( i = 0; i < strip->count; i++ ) {
+		INT64 time = c.duration * (2 * i + 1) / (2 * strip->count);
+		strip->times[i] = -1;
+		if( time > last ) {
+			// without a keyframe in (last, time] lavf fails and we read on
+			_ctx_seek( &c, time, last < 0 ? -1 : last + 1 );
+		}
+		if( _ctx_decode( &c, last ) ) {
+			break;
+		}
+		strip->img->window = (RECT){ (i % columns) * tile_width, (i / columns) * tile_height, tile_width, tile_height };
+		if( _ctx_convert( &c, strip->img ) ) {
+			break;
+		}
+		strip->times[i] = c.time;
+		strip->filled++;
+		if( c.time >= 0 ) {
+			last = c.time;
+		}
+	}
+	strip->img->window = (RECT){ 0, 0, strip->img->width, strip->img->height };
+	strip->error = strip->filled ? VE_NO_ERROR : VE_VIDEO_CODEC_ERROR;
+DBG serprintf("THUMB: strip of %s: %d/%d tiles %dx%d (lowres %d)  took %d\r\n", strip->url, strip->filled, strip->count,
+		tile_width, tile_height, c.vctx->lowres, atime() - start );
+
+end:
+	_ctx_close( &c );
+	if( strip->error != VE_NO_ERROR ) {
+		if( strip->img ) {
+			image_free( strip->img );
+			strip->img = NULL;
+		}
+		afree( strip->times );
+		strip->times = NULL;
+	}
+	return strip->error != VE_NO_ERROR;
+}
+
+// ************************************************************
+//
+//	_worker
+//
+// ************************************************************
+static void *_worker( void *arg )
+{
+	THUMB_BATCH *b = (THUMB_BATCH*)arg;
+	int i;
+
+	while( (i = __sync_fetch_and_add( &b->next, 1 )) < b->count ) {
+		_get( &b->jobs[i], &b->budget );
+	}
+	return NULL;
+}
+
+// ************************************************************
+//
+//	thumb_engine_run
+//
+// ************************************************************
+// returns the number of failed jobs, the calling thread is one of the workers
+int thumb_engine_run( THUMB_JOB *jobs, int count, int threads, int max_mem )
+{
+	pthread_t handles[THUMB_MAX_THREADS];
+	THUMB_BATCH b;
+	int i, started = 0, failed = 0;
+	int start = atime();
+
+	if( count <= 0 ) {
+		return 0;
+	}
+	if( threads <= 0 ) {
+		threads = device_get_cpu_count();
+	}
+	threads = MAX( MIN( MIN( threads, count ), THUMB_MAX_THREADS ), 1 );
+	if( max_mem <= 0 ) {
+		max_mem = THUMB_DEFAULT_MEM;
+	}
+
+	memset( &b, 0, sizeof( b ) );
+	b.jobs  = jobs;
+	b.count = count;
+	b.budget.left = (INT64)max_mem * 1024 * 1024;
+	pthread_mutex_init( &b.budget.mutex, NULL );
+	pthread_cond_init( &b.budget.cond, NULL );
+
+	for( i = 1; i < threads; i++ ) {
+		if( thread_create( &handles[started], _worker, &b, 0, "thumb engine" ) ) {
+ERR serprintf("THUMB: cannot start worker %d\r\n", i );
+			break;
+		}
+		started++;
+	}
+	_worker( &b );
+	for( i = 0; i < started; i++ ) {
+		pthread_join( handles[i], NULL );
+	}
+
+	pthread_cond_destroy( &b.budget.cond );
+	pthread_mutex_destroy( &b.budget.mutex );
+
+	for( i = 0; i < count; i++ ) {
+		failed += jobs[i].error != VE_NO_ERROR;
+	}
+DBG serprintf("THUMB: %d jobs, %d failed, %d threads, %d MB  took %d\r\n", count, failed, started + 1, max_mem, atime() - start );
+	return failed;
+}
+
+#ifdef DEBUG_MSG
+// ***************************************************************
+//
+// 	make_thumbs
+//
+// ***************************************************************
+static void make_thumbs( int argc, char *argv[] )
+{
+	int count = argc - 1;
+	if( count <= 0 ) {
+		return;
+	}
+	THUMB_JOB *jobs = acalloc( count, sizeof( THUMB_JOB ) );
+	if( !jobs ) {
+		return;
+	}
+	int i;
+	for( i = 0; i < count; i++ ) {
+		jobs[i].url        = argv[i + 1];
+		jobs[i].time       = -1;
+		jobs[i].colorspace = AV_IMAGE_YUV_422;
+		jobs[i].max_width  = 512;
+	}
+	int start = atime();
+	int failed = thumb_engine_run( jobs, count, 0, 0 );
+serprintf("%d thumbs, %d failed, took %d\n", count, failed, atime() - start );
+	for( i = 0; i < count; i++ ) {
+		if( jobs[i].img ) {
+serprintf("%s: %dx%d at %d\n", jobs[i].url, jobs[i].img->width, jobs[i].img->height, jobs[i].time_out );
+			image_free( jobs[i].img );
+		} else {
+serprintf("%s: error %d\n", jobs[i].url, jobs[i].error );
+		}
+	}
+	afree( jobs );
+}
+DECLARE_DEBUG_COMMAND("mkts", make_thumbs );
+
+// ***************************************************************
+//
+// 	make_strip
+//
+// ***************************************************************
+static void make_strip( int argc, char *argv[] )
+{
+	if( argc < 2 ) {
+serprintf("%s file [count] [tile_width]\n", argv[0] );
+		return;
+	}
+	THUMB_STRIP strip = {
+		.url        = argv[1],
+		.count      = argc > 2 ? atoi( argv[2] ) : 10,
+		.tile_width = argc > 3 ? atoi( argv[3] ) : 160,
+		.columns    = 5,
+		.colorspace = AV_IMAGE_BGRA_32,
+	};
+	int start = atime();
+	if( thumb_engine_strip( &strip ) ) {
+serprintf("error %d\n", strip.error );
+		return;
+	}
+serprintf("%d/%d tiles %dx%d in %dx%d, took %d\n", strip.filled, strip.count, strip.tile_width, strip.tile_height,
+		strip.img->width, strip.img->height, atime() - start );
+	int i;
+	for( i = 0; i < strip.count; i++ ) {
+serprintf("%3d: %d\n", i, strip.times[i] );
+	}
+	image_free( strip.img );
+	afree( strip.times );
+}
+DECLARE_DEBUG_COMMAND("mkst", make_strip );
+#endif
+
+#else
+
+int thumb_engine_get( THUMB_JOB *job )
+{
+	job->img   = NULL;
+	job->error = VE_VIDEO_NOT_SUPPORTED;
+	return 1;
+}
+
+int thumb_engine_strip( THUMB_STRIP *strip )
+{
+	strip->img    = NULL;
+	strip->times  = NULL;
+	strip->filled = 0;
+	strip->error  = VE_VIDEO_NOT_SUPPORTED;
+	return 1;
+}
+
+int thumb_engine_run( THUMB_JOB *jobs, int count, int threads, int max_mem )
+{
+	int i;
+	for( i = 0; i < count; i++ ) {
+		thumb_engine_get( &jobs[i] );
+	}
+	return count;
+}
+
+#endif	// CONFIG_VIDEO && CONFIG_FFMPEG_PARSER
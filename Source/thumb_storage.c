@@ -26,6 +26,7 @@
 #include "stream.h"
 #include "util.h"
 #include "app_av.h"
+#include "thumb_engine.h"
 
 #include <errno.h>
 #include <string.h>
@@ -177,6 +178,19 @@ IMAGE *thumb_get_image_from_url(STREAM_URL *src, int etype, int *stream_error, i
 
 DBG serprintf( "%s %s\r\n", __FUNCTION__, cut_extension( src->url ) );
 
+	// local files do not need a whole STREAM for one keyframe
+	THUMB_JOB job = {
+		.url         = src->url,
+		.time        = thumb_time,
+		.colorspace  = AV_IMAGE_YUV_422,
+		.max_width   = ANDROID_THUMB_WIDTH,
+		.fixed_width = 1,	// as wide as the thumbnails of the STREAM path
+	};
+	if( !thumb_engine_get( &job ) ) {
+		*stream_error = VE_NO_ERROR;
+		return job.img;
+	}
+
         if( ! ( stream  = stream_new() ) ) {
 ERR serprintf("%s : cannot create stream\r\n", __FUNCTION__);
                 goto ErrorExit;
@@ -38,9 +38,11 @@
  to use in different threads.
 */
 
-/* Note: Elements are stored as a sorted linked list and data is used as the object pool.
-   An id of -1 denotes an unused element. The linked list is formed as a ring where dummy 
-   is the first and last element. Since dummy.timeout == INT32_MAX, it can serve as a sentinel.
+/* Note: data is the object pool, unused elements have an id of -1 and are chained on free.
+   Active elements are kept in heap, a binary min-heap on timeout, so adding, removing
+   and re-arming are O(log n) and the next timeout is heap[0]. On equal timeouts the
+   latest inserted fires first. The id encodes the slot in data, id % size, so
+   removing by id does not search.
 */
 
 /**
@@ -60,63 +62,119 @@ static BOOL inited = FALSE;
 // Initializes the given Timers struct. 
 void Timers_init( Timers *obj )
 {
-	obj->dummy.id = -1;
-	obj->dummy.next = &obj->dummy;
-	obj->dummy.timeout = INT32_MAX;
+	obj->free = NULL;
+	obj->cnt  = 0;
 
 	int i;
-	for( i = 0; i < obj->size; i++ ) {
-		obj->data[i].id = -1;
+	for( i = obj->size - 1; i >= 0; i-- ) {
+		obj->data[i].id   = -1;
+		obj->data[i].next = obj->free;
+		obj->free = obj->data + i;
 	}
 	if( obj == &gui_timers ) {
 		inited = TRUE;
 	}
 }
 
-// helper function to insert a timer into the linked list, keeping it sorted
-static void _insert( Timers *obj, Timer *nt )
+// whether a fires before b
+static inline int _before( const Timer *a, const Timer *b )
+{
+	return a->timeout < b->timeout || ( a->timeout == b->timeout && (int)(a->stamp - b->stamp) > 0 );
+}
+
+static inline void _place( Timers *obj, Timer *t, int pos )
+{
+	obj->heap[pos] = t;
+	t->pos = pos;
+}
+
+static void _sift_up( Timers *obj, Timer *t, int pos )
+{
+	while( pos > 0 ) {
+		int parent = ( pos - 1 ) / 2;
+		if( !_before( t, obj->heap[parent] ) )
+			break;
+		_place( obj, obj->heap[parent], pos );
+		pos = parent;
+	}
+	_place( obj, t, pos );
+}
+
+static void _sift_down( Timers *obj, Timer *t, int pos )
 {
-	Timer *before = &obj->dummy;
-	while( before->next->timeout < nt->timeout ) {
-		before = before->next;
+	for( ;; ) {
+		int child = 2 * pos + 1;
+		if( child >= obj->cnt )
+			break;
+		if( child + 1 < obj->cnt && _before( obj->heap[child + 1], obj->heap[child] ) )
+			child++;
+		if( !_before( obj->heap[child], t ) )
+			break;
+		_place( obj, obj->heap[child], pos );
+		pos = child;
 	}
-	nt->next = before->next;
-	before->next= nt;
-	obj->cnt++;
+	_place( obj, t, pos );
 }
 
-// helper function to remove a timer from the linked list
-static void _remove( Timers *obj, Timer *before )
+// helper function to insert a timer into the heap
+static void _insert( Timers *obj, Timer *nt )
 {
-	before->next = before->next->next;
-	obj->cnt--;
+	nt->stamp = obj->stamp++;
+	_sift_up( obj, nt, obj->cnt++ );
+}
+
+// helper function to remove a timer from the heap
+static void _remove( Timers *obj, Timer *t )
+{
+	Timer *last = obj->heap[--obj->cnt];
+	int pos = t->pos;
+
+	if( last == t )
+		return;
+	if( pos > 0 && _before( last, obj->heap[( pos - 1 ) / 2] ) )
+		_sift_up( obj, last, pos );
+	else
+		_sift_down( obj, last, pos );
+}
+
+// helper function to give an element back to the pool
+static void _release( Timers *obj, Timer *t )
+{
+	t->id   = -1;
+	t->next = obj->free;
+	obj->free = t;
+}
+
+// helper function to find an active timer by id
+static Timer *_find( Timers *obj, int id )
+{
+	if( id <= 0 )
+		return NULL;
+	Timer *t = obj->data + id % obj->size;
+	return t->id == id ? t : NULL;
 }
 
 // inits and adds a timer element, does housekeeping
 static int Timers_internalAdd( Timers *obj, void (*onTimeout_nolistener)(), void (*onTimeout)(void*), 
 			void *listener, int interval, int delay, TimerMode mode, const char* caller )
 {
-	static int id_counter = 1;	// ID counter should start at 1 to prevent wrong remove
-					// of timer with ID 0 when ID is not initialize to -1
-
 	pthread_mutex_lock( &obj->mutex );
 
 	int res= -1;
 	if( obj->cnt < obj->size ) {
 		ULONG tm = atime();
 
-		// find an unused element
-		Timer *nt = NULL;
-		int i;
-		for( i = 0; i < obj->size; i++ ) {
-			if( obj->data[i].id == -1 ) {  // an id of -1 marks an unused element
-				nt = obj->data + i;
-				break;
-			}
-		}
+		// take an unused element
+		Timer *nt = obj->free;
+		obj->free = nt->next;
+
+		// ids start at size to prevent wrong remove of timer with ID 0
+		// when ID is not initialized to -1, the slot is id % size
+		unsigned gens = INT32_MAX / obj->size - 1;
+		int slot = nt - obj->data;
 
 		// fill out the timer struct
-		nt->id		    = id_counter++;
+		nt->id		    = ( obj->seq++ % gens + 1 ) * obj->size + slot;
 		nt->timeout	    = tm + delay;
 		nt->interval	    = mode == TIMER_SINGLE ? -1 : interval;
 		nt->callback	    = onTimeout_nolistener;
@@ -294,14 +352,10 @@ void Timers_remove(Timers *obj, int *id )
 
 	pthread_mutex_lock( &obj->mutex );
 
-	Timer *before = &obj->dummy;
-	while( before->next->timeout < INT32_MAX ) {
-		if( before->next->id == *id ) {
-			before->next->id = -1;
-			_remove( obj, before );
-			break;
-		}
-		before = before->next;
+	Timer *t = _find( obj, *id );
+	if( t ) {
+		_remove( obj, t );
+		_release( obj, t );
 	}
 
 	*id = -1;
@@ -321,27 +375,30 @@ void Timers_trigger( Timers *obj )
 {
 	ULONG tm = atime();
 
-	Timer *before = &obj->dummy;
-
 	pthread_mutex_lock( &obj->mutex );
 
-	while( before->next->timeout <= tm ) {
-		Timer *first = before->next;
+	while( obj->cnt && obj->heap[0]->timeout <= tm ) {
+		Timer *first = obj->heap[0];
+
+		// the element may be reused as soon as we unlock
+		void (*callback)()		= first->callback;
+		void (*callback_ctx)(void *)	= first->callback_ctx;
+		void *ctx			= first->ctx;
 
 		if( first->interval > 0 ) {
-			_remove( obj, before );
 			first->timeout = tm + first->interval;
-			_insert( obj, first );
+			first->stamp   = obj->stamp++;
+			_sift_down( obj, first, 0 );
 		} else {
-			before->next->id = -1;
-			_remove( obj, before );
+			_remove( obj, first );
+			_release( obj, first );
 		}
 
 		pthread_mutex_unlock( &obj->mutex );
-		if( first->callback )
-			first->callback();
-		else if( first->callback_ctx )
-			first->callback_ctx( first->ctx );
+		if( callback )
+			callback();
+		else if( callback_ctx )
+			callback_ctx( ctx );
 		pthread_mutex_lock( &obj->mutex );
 	}
 
@@ -352,7 +409,7 @@ void Timers_trigger( Timers *obj )
 int Timers_nextTimeout( Timers *obj ) {
 	pthread_mutex_lock( &obj->mutex );
 
-	int res = obj->cnt != 0 ? obj->dummy.next->timeout : 0;
+	int res = obj->cnt != 0 ? obj->heap[0]->timeout : 0;
 
 	pthread_mutex_unlock( &obj->mutex );
 
@@ -364,13 +421,12 @@ int Timers_haveListener(Timers *obj, void *listener)
 {
 	if( !inited ) return 0;
 
-	Timer *before = &obj->dummy;
-	while( before->next->timeout < INT32_MAX ) {
-		if( before->next->ctx == listener ) {
-			serprintf( "Timers_haveListener: listener exists, was added by %s\n", before->next->caller );
+	int i;
+	for( i = 0; i < obj->cnt; i++ ) {
+		if( obj->heap[i]->ctx == listener ) {
+			serprintf( "Timers_haveListener: listener exists, was added by %s\n", obj->heap[i]->caller );
 			return 1;
 		}
-		before = before->next;
 	}
 	return 0;
 }
@@ -381,10 +437,11 @@ static void Timers_dump( Timers *obj )
 {
 	serprintf("Timers (%i):\n", obj->cnt);
 
-	Timer *cur = obj->dummy.next;
-	while( cur->timeout < INT32_MAX ) {
+	// heap order, heap[0] is next
+	int i;
+	for( i = 0; i < obj->cnt; i++ ) {
+		Timer *cur = obj->heap[i];
 		serprintf("  id: %5i  int %8d  next_to %8d  cb %08X  ctx %08X  [%s]\n", cur->id, cur->interval, cur->timeout,  cur->callback?cur->callback:cur->callback_ctx, cur->ctx, cur->caller);
-		cur = cur->next;
 	}
 	serprintf("\n");
 }
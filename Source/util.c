@@ -29,6 +29,8 @@
 #include <stdio.h>
 #include <signal.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #define ERR	if (0)
 #define DBG	if (0)
@@ -495,6 +497,60 @@ int adjust_oom(pid_t pid, int value)
 	return 0;
 }
 
+//------------------------------------------------------------------------
+//	amalloc_mirror
+//
+//	maps the same size bytes twice, back to back: ptr[size + n] is
+//	ptr[n], so a ring buffer never has to copy around its wrap point.
+//	size must be a multiple of the page size, free with afree_mirror
+//------------------------------------------------------------------------
+void *amalloc_mirror( int size, const char *name )
+{
+#ifdef __NR_memfd_create
+	if( size <= 0 || size % sysconf( _SC_PAGESIZE ) ) {
+		return NULL;
+	}
+
+	int fd = syscall( __NR_memfd_create, name, 0 );
+	if( fd == -1 ) {
+		ERR serprintf("memfd failed: %s\n", strerror(errno) );
+		return NULL;
+	}
+
+	UCHAR *ptr = NULL;
+	if( ftruncate( fd, size ) ) {
+		ERR serprintf("ftruncate %d failed: %s\n", size, strerror(errno) );
+		goto Exit;
+	}
+
+	// reserve the address space for both views, then map the pages into it
+	ptr = mmap( 0, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if( ptr == MAP_FAILED ) {
+		ptr = NULL;
+		goto Exit;
+	}
+	if( mmap( ptr,        size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) == MAP_FAILED ||
+	    mmap( ptr + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) == MAP_FAILED ) {
+		ERR serprintf("mirror mmap failed: %s\n", strerror(errno) );
+		munmap( ptr, 2 * size );
+		ptr = NULL;
+	}
+Exit:
+	// the mappings keep the pages alive
+	close( fd );
+	return ptr;
+#else
+	return NULL;
+#endif
+}
+
+void afree_mirror( void *ptr, int size )
+{
+	if( ptr ) {
+		munmap( ptr, 2 * size );
+	}
+}
+
 // remove a trailing newline
 void chomp(char* str)
 {
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "global.h"
+#include "debug.h"
+#include "x86_simd.h"
+
+#ifdef CONFIG_X86_SIMD
+
+#include <immintrin.h>
+
+// every kernel carries its own target, so the rest of the tree
+// keeps the default -march and we decide at runtime what we can use
+#define TARGET_SSE2	__attribute__((target("sse2")))
+#define TARGET_AVX2	__attribute__((target("avx2")))
+
+static int simd_level = -1;
+static int simd_max   = X86_SIMD_AVX2;
+DECLARE_DEBUG_PARAM("x86l", simd_max );
+
+// ************************************************************
+//
+//	x86_simd_level
+//
+// ************************************************************
+int x86_simd_level( void )
+{
+	if( simd_level < 0 ) {
+		int level = X86_SIMD_NONE;
+		__builtin_cpu_init();
+		if( __builtin_cpu_supports( "sse2" ) )
+			level = X86_SIMD_SSE2;
+		if( __builtin_cpu_supports( "avx2" ) )
+			level = X86_SIMD_AVX2;
+		simd_level = level;
+	}
+	return simd_level < simd_max ? simd_level : simd_max;
+}
+
+// ************************************************************
+//
+//	YUV -> RGB32
+//
+// ************************************************************
+/*
+	same math as convertYUVtoBGRA32() and friends:
+
+	r = y + v
+	g = y - (int)( 0.39465 * u + 0.58060 * v )
+	b = y + 2 * u
+
+	the g term is done in single precision float with separate mul/add,
+	for u, v in [-128, 127] it truncates to exactly the same integer as
+	the double precision scalar code (checked for all 65536 pairs)
+*/
+
+// u, v: 8 x int16 chroma (-128 already applied)
+static inline TARGET_SSE2 void _sse2_chroma( __m128i u, __m128i v, __m128i *cr, __m128i *cg, __m128i *cb )
+{
+	const __m128 ku = _mm_set1_ps( 0.39465f );
+	const __m128 kv = _mm_set1_ps( 0.58060f );
+
+	__m128 ulo = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( u, u ), 16 ) );
+	__m128 uhi = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( u, u ), 16 ) );
+	__m128 vlo = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+	__m128 vhi = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 ) );
+
+	__m128i glo = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( ulo, ku ), _mm_mul_ps( vlo, kv ) ) );
+	__m128i ghi = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( uhi, ku ), _mm_mul_ps( vhi, kv ) ) );
+
+	*cr = v;
+	*cg = _mm_packs_epi32( glo, ghi );
+	*cb = _mm_add_epi16( u, u );
+}
+
+// 16 pixel of one line, y: 16 x uint8, c*: 8 x int16, one per pixel pair
+static inline TARGET_SSE2 void _sse2_store16( uint32_t *dst, __m128i y, __m128i cr, __m128i cg, __m128i cb, int bgra )
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i k16  = _mm_set1_epi16( 16 );
+
+	__m128i ylo = _mm_sub_epi16( _mm_unpacklo_epi8( y, zero ), k16 );
+	__m128i yhi = _mm_sub_epi16( _mm_unpackhi_epi8( y, zero ), k16 );
+
+	// packus does the clamp to 0..255
+	__m128i r = _mm_packus_epi16( _mm_add_epi16( ylo, _mm_unpacklo_epi16( cr, cr ) ), _mm_add_epi16( yhi, _mm_unpackhi_epi16( cr, cr ) ) );
+	__m128i g = _mm_packus_epi16( _mm_sub_epi16( ylo, _mm_unpacklo_epi16( cg, cg ) ), _mm_sub_epi16( yhi, _mm_unpackhi_epi16( cg, cg ) ) );
+	__m128i b = _mm_packus_epi16( _mm_add_epi16( ylo, _mm_unpacklo_epi16( cb, cb ) ), _mm_add_epi16( yhi, _mm_unpackhi_epi16( cb, cb ) ) );
+
+	__m128i c0, c2, c3;
+	if( bgra ) {
+		c0 = b; c2 = r; c3 = _mm_set1_epi8( -1 );
+	} else {
+		c0 = r; c2 = b; c3 = zero;
+	}
+	__m128i t0 = _mm_unpacklo_epi8( c0, g );
+	__m128i t1 = _mm_unpackhi_epi8( c0, g );
+	__m128i t2 = _mm_unpacklo_epi8( c2, c3 );
+	__m128i t3 = _mm_unpackhi_epi8( c2, c3 );
+
+	_mm_storeu_si128( (__m128i*)(dst +  0), _mm_unpacklo_epi16( t0, t2 ) );
+	_mm_storeu_si128( (__m128i*)(dst +  4), _mm_unpackhi_epi16( t0, t2 ) );
+	_mm_storeu_si128( (__m128i*)(dst +  8), _mm_unpacklo_epi16( t1, t3 ) );
+	_mm_storeu_si128( (__m128i*)(dst + 12), _mm_unpackhi_epi16( t1, t3 ) );
+}
+
+// same as the SSE2 version, every 128 bit lane does its own 16 pixel:
+// lane 0 pixel 0..7 and 16..23, lane 1 pixel 8..15 and 24..31, sorted out on store
+static inline TARGET_AVX2 void _avx2_chroma( __m256i u, __m256i v, __m256i *cr, __m256i *cg, __m256i *cb )
+{
+	const __m256 ku = _mm256_set1_ps( 0.39465f );
+	const __m256 kv = _mm256_set1_ps( 0.58060f );
+
+	__m256 ulo = _mm256_cvtepi32_ps( _mm256_srai_epi32( _mm256_unpacklo_epi16( u, u ), 16 ) );
+	__m256 uhi = _mm256_cvtepi32_ps( _mm256_srai_epi32( _mm256_unpackhi_epi16( u, u ), 16 ) );
+	__m256 vlo = _mm256_cvtepi32_ps( _mm256_srai_epi32( _mm256_unpacklo_epi16( v, v ), 16 ) );
+	__m256 vhi = _mm256_cvtepi32_ps( _mm256_srai_epi32( _mm256_unpackhi_epi16( v, v ), 16 ) );
+
+	__m256i glo = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( ulo, ku ), _mm256_mul_ps( vlo, kv ) ) );
+	__m256i ghi = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( uhi, ku ), _mm256_mul_ps( vhi, kv ) ) );
+
+	*cr = v;
+	*cg = _mm256_packs_epi32( glo, ghi );
+	*cb = _mm256_add_epi16( u, u );
+}
+
+static inline TARGET_AVX2 void _avx2_store32( uint32_t *dst, __m256i y, __m256i cr, __m256i cg, __m256i cb, int bgra )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i k16  = _mm256_set1_epi16( 16 );
+
+	__m256i ylo = _mm256_sub_epi16( _mm256_unpacklo_epi8( y, zero ), k16 );
+	__m256i yhi = _mm256_sub_epi16( _mm256_unpackhi_epi8( y, zero ), k16 );
+
+	__m256i r = _mm256_packus_epi16( _mm256_add_epi16( ylo, _mm256_unpacklo_epi16( cr, cr ) ), _mm256_add_epi16( yhi, _mm256_unpackhi_epi16( cr, cr ) ) );
+	__m256i g = _mm256_packus_epi16( _mm256_sub_epi16( ylo, _mm256_unpacklo_epi16( cg, cg ) ), _mm256_sub_epi16( yhi, _mm256_unpackhi_epi16( cg, cg ) ) );
+	__m256i b = _mm256_packus_epi16( _mm256_add_epi16( ylo, _mm256_unpacklo_epi16( cb, cb ) ), _mm256_add_epi16( yhi, _mm256_unpackhi_epi16( cb, cb ) ) );
+
+	__m256i c0, c2, c3;
+	if( bgra ) {
+		c0 = b; c2 = r; c3 = _mm256_set1_epi8( -1 );
+	} else {
+		c0 = r; c2 = b; c3 = zero;
+	}
+	__m256i t0 = _mm256_unpacklo_epi8( c0, g );
+	__m256i t1 = _mm256_unpackhi_epi8( c0, g );
+	__m256i t2 = _mm256_unpacklo_epi8( c2, c3 );
+	__m256i t3 = _mm256_unpackhi_epi8( c2, c3 );
+
+	__m256i o0 = _mm256_unpacklo_epi16( t0, t2 );
+	__m256i o1 = _mm256_unpackhi_epi16( t0, t2 );
+	__m256i o2 = _mm256_unpacklo_epi16( t1, t3 );
+	__m256i o3 = _mm256_unpackhi_epi16( t1, t3 );
+
+	_mm256_storeu_si256( (__m256i*)(dst +  0), _mm256_permute2x128_si256( o0, o1, 0x20 ) );
+	_mm256_storeu_si256( (__m256i*)(dst +  8), _mm256_permute2x128_si256( o2, o3, 0x20 ) );
+	_mm256_storeu_si256( (__m256i*)(dst + 16), _mm256_permute2x128_si256( o0, o1, 0x31 ) );
+	_mm256_storeu_si256( (__m256i*)(dst + 24), _mm256_permute2x128_si256( o2, o3, 0x31 ) );
+}
+
+static TARGET_SSE2 int _sse2_yuv420_to_rgb32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *u, const uint8_t *v, int width, int linesize, int x, int bgra )
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i k128 = _mm_set1_epi16( 128 );
+
+	for( ; x + 16 <= width; x += 16 ) {
+		__m128i cu = _mm_sub_epi16( _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*)(u + x / 2) ), zero ), k128 );
+		__m128i cv = _mm_sub_epi16( _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*)(v + x / 2) ), zero ), k128 );
+		__m128i cr, cg, cb;
+		_sse2_chroma( cu, cv, &cr, &cg, &cb );
+		_sse2_store16( dst + x,            _mm_loadu_si128( (const __m128i*)(y1 + x) ), cr, cg, cb, bgra );
+		_sse2_store16( dst + linesize + x, _mm_loadu_si128( (const __m128i*)(y2 + x) ), cr, cg, cb, bgra );
+	}
+	return x;
+}
+
+static TARGET_AVX2 int _avx2_yuv420_to_rgb32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *u, const uint8_t *v, int width, int linesize, int x, int bgra )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i k128 = _mm256_set1_epi16( 128 );
+
+	for( ; x + 32 <= width; x += 32 ) {
+		// chroma 0..7 to lane 0, 8..15 to lane 1
+		__m256i u8 = _mm256_permute4x64_epi64( _mm256_castsi128_si256( _mm_loadu_si128( (const __m128i*)(u + x / 2) ) ), 0x50 );
+		__m256i v8 = _mm256_permute4x64_epi64( _mm256_castsi128_si256( _mm_loadu_si128( (const __m128i*)(v + x / 2) ) ), 0x50 );
+		__m256i cr, cg, cb;
+		_avx2_chroma( _mm256_sub_epi16( _mm256_unpacklo_epi8( u8, zero ), k128 ), _mm256_sub_epi16( _mm256_unpacklo_epi8( v8, zero ), k128 ), &cr, &cg, &cb );
+		_avx2_store32( dst + x,            _mm256_loadu_si256( (const __m256i*)(y1 + x) ), cr, cg, cb, bgra );
+		_avx2_store32( dst + linesize + x, _mm256_loadu_si256( (const __m256i*)(y2 + x) ), cr, cg, cb, bgra );
+	}
+	return x;
+}
+
+static TARGET_SSE2 int _sse2_nv12_to_rgb32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *uv, int width, int linesize, int x, int bgra )
+{
+	const __m128i mask = _mm_set1_epi16( 0xff );
+	const __m128i k128 = _mm_set1_epi16( 128 );
+
+	for( ; x + 16 <= width; x += 16 ) {
+		__m128i c = _mm_loadu_si128( (const __m128i*)(uv + x) );
+		__m128i cr, cg, cb;
+		_sse2_chroma( _mm_sub_epi16( _mm_and_si128( c, mask ), k128 ), _mm_sub_epi16( _mm_srli_epi16( c, 8 ), k128 ), &cr, &cg, &cb );
+		_sse2_store16( dst + x,            _mm_loadu_si128( (const __m128i*)(y1 + x) ), cr, cg, cb, bgra );
+		_sse2_store16( dst + linesize + x, _mm_loadu_si128( (const __m128i*)(y2 + x) ), cr, cg, cb, bgra );
+	}
+	return x;
+}
+
+static TARGET_AVX2 int _avx2_nv12_to_rgb32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *uv, int width, int linesize, int x, int bgra )
+{
+	const __m256i mask = _mm256_set1_epi16( 0xff );
+	const __m256i k128 = _mm256_set1_epi16( 128 );
+
+	for( ; x + 32 <= width; x += 32 ) {
+		// UV pairs 0..7 are in lane 0 and 8..15 in lane 1 already
+		__m256i c = _mm256_loadu_si256( (const __m256i*)(uv + x) );
+		__m256i cr, cg, cb;
+		_avx2_chroma( _mm256_sub_epi16( _mm256_and_si256( c, mask ), k128 ), _mm256_sub_epi16( _mm256_srli_epi16( c, 8 ), k128 ), &cr, &cg, &cb );
+		_avx2_store32( dst + x,            _mm256_loadu_si256( (const __m256i*)(y1 + x) ), cr, cg, cb, bgra );
+		_avx2_store32( dst + linesize + x, _mm256_loadu_si256( (const __m256i*)(y2 + x) ), cr, cg, cb, bgra );
+	}
+	return x;
+}
+
+static int _yuv420_to_rgb32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *u, const uint8_t *v, int width, int linesize, int bgra )
+{
+	int level = x86_simd_level();
+	int x = 0;
+	if( level >= X86_SIMD_AVX2 )
+		x = _avx2_yuv420_to_rgb32( dst, y1, y2, u, v, width, linesize, x, bgra );
+	if( level >= X86_SIMD_SSE2 )
+		x = _sse2_yuv420_to_rgb32( dst, y1, y2, u, v, width, linesize, x, bgra );
+	return x;
+}
+
+static int _nv12_to_rgb32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *uv, int width, int linesize, int bgra )
+{
+	int level = x86_simd_level();
+	int x = 0;
+	if( level >= X86_SIMD_AVX2 )
+		x = _avx2_nv12_to_rgb32( dst, y1, y2, uv, width, linesize, x, bgra );
+	if( level >= X86_SIMD_SSE2 )
+		x = _sse2_nv12_to_rgb32( dst, y1, y2, uv, width, linesize, x, bgra );
+	return x;
+}
+
+int x86_yuv420_to_BGRA32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *u, const uint8_t *v, int width, int linesize )
+{
+	return _yuv420_to_rgb32( dst, y1, y2, u, v, width, linesize, 1 );
+}
+
+int x86_yuv420_to_RGBX32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *u, const uint8_t *v, int width, int linesize )
+{
+	return _yuv420_to_rgb32( dst, y1, y2, u, v, width, linesize, 0 );
+}
+
+int x86_nv12_to_BGRA32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *uv, int width, int linesize )
+{
+	return _nv12_to_rgb32( dst, y1, y2, uv, width, linesize, 1 );
+}
+
+int x86_nv12_to_RGBX32( uint32_t *dst, const uint8_t *y1, const uint8_t *y2, const uint8_t *uv, int width, int linesize )
+{
+	return _nv12_to_rgb32( dst, y1, y2, uv, width, linesize, 0 );
+}
+
+// ************************************************************
+//
+//	x86_interleave_uv
+//
+// ************************************************************
+static TARGET_SSE2 int _sse2_interleave_uv( uint8_t *dst, const uint8_t *u, const uint8_t *v, int count, int x )
+{
+	for( ; x + 16 <= count; x += 16 ) {
+		__m128i cu = _mm_loadu_si128( (const __m128i*)(u + x) );
+		__m128i cv = _mm_loadu_si128( (const __m128i*)(v + x) );
+		_mm_storeu_si128( (__m128i*)(dst + 2 * x),      _mm_unpacklo_epi8( cu, cv ) );
+		_mm_storeu_si128( (__m128i*)(dst + 2 * x + 16), _mm_unpackhi_epi8( cu, cv ) );
+	}
+	return x;
+}
+
+static TARGET_AVX2 int _avx2_interleave_uv( uint8_t *dst, const uint8_t *u, const uint8_t *v, int count, int x )
+{
+	for( ; x + 32 <= count; x += 32 ) {
+		__m256i cu = _mm256_loadu_si256( (const __m256i*)(u + x) );
+		__m256i cv = _mm256_loadu_si256( (const __m256i*)(v + x) );
+		__m256i lo = _mm256_unpacklo_epi8( cu, cv );
+		__m256i hi = _mm256_unpackhi_epi8( cu, cv );
+		_mm256_storeu_si256( (__m256i*)(dst + 2 * x),      _mm256_permute2x128_si256( lo, hi, 0x20 ) );
+		_mm256_storeu_si256( (__m256i*)(dst + 2 * x + 32), _mm256_permute2x128_si256( lo, hi, 0x31 ) );
+	}
+	return x;
+}
+
+int x86_interleave_uv( uint8_t *dst, const uint8_t *u, const uint8_t *v, int count )
+{
+	int level = x86_simd_level();
+	int x = 0;
+	if( level >= X86_SIMD_AVX2 )
+		x = _avx2_interleave_uv( dst, u, v, count, x );
+	if( level >= X86_SIMD_SSE2 )
+		x = _sse2_interleave_uv( dst, u, v, count, x );
+	return x;
+}
+
+// ************************************************************
+//
+//	x86_scale_420P10b_Y
+//
+// ************************************************************
+// (A * 220 + 16384) >> 10 == (A * 55 + 4096) >> 8, which stays in 16 bit for A < 1024
+static TARGET_SSE2 int _sse2_scale_420P10b_Y( uint8_t *dst, const uint16_t *src, int count, int x )
+{
+	const __m128i k55   = _mm_set1_epi16( 55 );
+	const __m128i k4096 = _mm_set1_epi16( 4096 );
+
+	for( ; x + 16 <= count; x += 16 ) {
+		__m128i a = _mm_loadu_si128( (const __m128i*)(src + x) );
+		__m128i b = _mm_loadu_si128( (const __m128i*)(src + x + 8) );
+		a = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( a, k55 ), k4096 ), 8 );
+		b = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( b, k55 ), k4096 ), 8 );
+		_mm_storeu_si128( (__m128i*)(dst + x), _mm_packus_epi16( a, b ) );
+	}
+	return x;
+}
+
+static TARGET_AVX2 int _avx2_scale_420P10b_Y( uint8_t *dst, const uint16_t *src, int count, int x )
+{
+	const __m256i k55   = _mm256_set1_epi16( 55 );
+	const __m256i k4096 = _mm256_set1_epi16( 4096 );
+
+	for( ; x + 32 <= count; x += 32 ) {
+		__m256i a = _mm256_loadu_si256( (const __m256i*)(src + x) );
+		__m256i b = _mm256_loadu_si256( (const __m256i*)(src + x + 16) );
+		a = _mm256_srli_epi16( _mm256_add_epi16( _mm256_mullo_epi16( a, k55 ), k4096 ), 8 );
+		b = _mm256_srli_epi16( _mm256_add_epi16( _mm256_mullo_epi16( b, k55 ), k4096 ), 8 );
+		_mm256_storeu_si256( (__m256i*)(dst + x), _mm256_permute4x64_epi64( _mm256_packus_epi16( a, b ), 0xD8 ) );
+	}
+	return x;
+}
+
+int x86_scale_420P10b_Y( uint8_t *dst, const uint16_t *src, int count )
+{
+	int level = x86_simd_level();
+	int x = 0;
+	if( level >= X86_SIMD_AVX2 )
+		x = _avx2_scale_420P10b_Y( dst, src, count, x );
+	if( level >= X86_SIMD_SSE2 )
+		x = _sse2_scale_420P10b_Y( dst, src, count, x );
+	return x;
+}
+
+// ************************************************************
+//
+//	x86_copy_pack_shift
+//
+// ************************************************************
+static TARGET_SSE2 int _sse2_copy_pack_shift( uint16_t *dst, const uint16_t *srcV, const uint16_t *srcU, int count, int x )
+{
+	for( ; x + 8 <= count; x += 8 ) {
+		__m128i v = _mm_srli_epi16( _mm_loadu_si128( (const __m128i*)(srcV + x) ), 2 );
+		__m128i u = _mm_srli_epi16( _mm_loadu_si128( (const __m128i*)(srcU + x) ), 2 );
+		_mm_storeu_si128( (__m128i*)(dst + x), _mm_or_si128( _mm_slli_epi16( v, 8 ), u ) );
+	}
+	return x;
+}
+
+static TARGET_AVX2 int _avx2_copy_pack_shift( uint16_t *dst, const uint16_t *srcV, const uint16_t *srcU, int count, int x )
+{
+	for( ; x + 16 <= count; x += 16 ) {
+		__m256i v = _mm256_srli_epi16( _mm256_loadu_si256( (const __m256i*)(srcV + x) ), 2 );
+		__m256i u = _mm256_srli_epi16( _mm256_loadu_si256( (const __m256i*)(srcU + x) ), 2 );
+		_mm256_storeu_si256( (__m256i*)(dst + x), _mm256_or_si256( _mm256_slli_epi16( v, 8 ), u ) );
+	}
+	return x;
+}
+
+int x86_copy_pack_shift( uint16_t *dst, const uint16_t *srcV, const uint16_t *srcU, int count )
+{
+	int level = x86_simd_level();
+	int x = 0;
+	if( level >= X86_SIMD_AVX2 )
+		x = _avx2_copy_pack_shift( dst, srcV, srcU, count, x );
+	if( level >= X86_SIMD_SSE2 )
+		x = _sse2_copy_pack_shift( dst, srcV, srcU, count, x );
+	return x;
+}
+
+#endif
@@ -110,12 +110,12 @@ CSRC_AVOS_CORE = \
 	av.c av_dump.c bmp.c frame_q.c\
 	image.c image_resize.c\
 	rect.c  \
-	file_info.c\
+	file_info.c media_cache.c\
 	linked_list.c  \
 	browse.c ac_av.c object.c\
 	sysfs_ll.c \
-	thumb_storage.c thumb_stream.c \
-	pixel_utils.c pixel_utils_neon.c \
+	thumb_storage.c thumb_stream.c thumb_engine.c \
+	pixel_utils.c pixel_utils_neon.c slice_pool.c \
 	device_config.c
 
 CSRC_AVOS_CORE += mainloop.c dataevent.c \
@@ -133,7 +133,7 @@ CSRC_STREAM_CORE = \
 	stream_config.c \
 	stream_alloc.c \
 	stream_dumper.c \
-	stream_global.c stream_sync.c  
+	stream_global.c stream_sync.c stream_stats.c
 
 CSRC_STREAM_MISC = \
 	mpeg2.c h264.c mpg4.c realvideo.c wmv.c downmix.c pts_reorder.c hevc.c
@@ -149,7 +149,7 @@ CSRC_STREAM_PARSER = \
 	
 CSRC_STREAM_CODEC = \
 	codec_yuv.c \
-	codec_ssa.c codec_textsub.c vobsub.c codec_vobsub.c codec_utils.c  \
+	codec_ssa.c codec_textsub.c vobsub.c codec_vobsub.c codec_utils.c x86_yuv.c \
 	codec_ffsub.c
 
 CSRC_STREAM_SINK = \
@@ -178,6 +178,9 @@ CSRC_APP = \
 		
 CSRC_CLI = cli.c cli_video.c fb.c platform.c
 
+# headless benchmark, see avbench.c
+CSRC_BENCH = avbench.c
+
 ifeq ($(CLI),ON)
 CSRC_APP += $(CSRC_CLI)
 endif
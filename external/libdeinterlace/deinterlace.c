@@ -360,7 +360,10 @@ static inline void XDeintBand8x8C( uint8_t *dst, int i_dst,
  * Public functions
  *****************************************************************************/
 
-void RenderX( unsigned char *p_outpic, unsigned char *p_pic, int width, int height, int dst_linesize, int src_linesize )
+/* RenderXBand: 8 line band number band of a width x height picture,
+ * p_outpic/p_pic point to the first line of that band. The last band
+ * gets the remaining lines, so rendering every band gives RenderX() */
+void RenderXBand( unsigned char *p_outpic, unsigned char *p_pic, int width, int height, int band, int dst_linesize, int src_linesize )
 {
         const int i_mby = ( height + 7 )/8 - 1;
         const int i_mbx = width/8;
@@ -371,22 +374,17 @@ void RenderX( unsigned char *p_outpic, unsigned char *p_pic, int width, int heig
         const int i_dst = dst_linesize;
         const int i_src = src_linesize;
 
-        int y, x;
+        uint8_t *dst = p_outpic;
+        uint8_t *src = p_pic;
+        int x;
 
-        for( y = 0; y < i_mby; y++ )
+        if( band < i_mby )
         {
-            uint8_t *dst = &p_outpic[8*y*i_dst];
-            uint8_t *src = &p_pic[8*y*i_src];
-
-                XDeintBand8x8C( dst, i_dst, src, i_src, i_mbx, i_modx );
+            XDeintBand8x8C( dst, i_dst, src, i_src, i_mbx, i_modx );
         }
-
-        /* Last line (C only)*/
-        if( i_mody )
+        else if( band == i_mby && i_mody )
         {
-            uint8_t *dst = &p_outpic[8*y*i_dst];
-            uint8_t *src = &p_pic[8*y*i_src];
-
+            /* Last line (C only)*/
             for( x = 0; x < i_mbx; x++ )
             {
                 XDeintNxN( dst, i_dst, src, i_src, 8, i_mody );
@@ -398,5 +396,13 @@ void RenderX( unsigned char *p_outpic, unsigned char *p_pic, int width, int heig
             if( i_modx )
                 XDeintNxN( dst, i_dst, src, i_src, i_modx, i_mody );
         }
+}
+
+void RenderX( unsigned char *p_outpic, unsigned char *p_pic, int width, int height, int dst_linesize, int src_linesize )
+{
+        const int i_bands = ( height + 7 )/8;
+        int y;
 
+        for( y = 0; y < i_bands; y++ )
+            RenderXBand( &p_outpic[8*y*dst_linesize], &p_pic[8*y*src_linesize], width, height, y, dst_linesize, src_linesize );
 }
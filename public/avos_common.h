@@ -61,6 +61,16 @@ typedef struct avos_apic {
 	uint8_t data[];
 } avos_apic_t __attribute__((aligned(1)));
 
+// a sprite sheet of count tiles, row by row, times[i] in ms, -1 if the tile is empty
+typedef struct avos_thumb_strip {
+	avos_bgra_bitmap_t bitmap;
+	uint32_t tile_width;
+	uint32_t tile_height;
+	uint32_t columns;
+	uint32_t count;
+	int32_t times[];
+} avos_thumb_strip_t __attribute__((aligned(1)));
+
 enum {
 	AVOS_MSG_TYPE_INT = 0,
 	AVOS_MSG_TYPE_INT64,
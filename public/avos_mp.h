@@ -63,6 +63,8 @@ typedef struct avos_mp_handle_t {
 	int (*setavspeed)	(avos_mp_t *mp, float speed);
 	// audio specific
 	int (*setnextrack)	(avos_mp_t *mp, const char *path);
+	// video: per stage times, queue depths and drops as text, one line per group
+	int (*getstats)		(avos_mp_t *mp, char *buf, int size);
 } avos_mp_handle_t;
 
 const avos_mp_handle_t *avos_mp_get_handle();
@@ -36,6 +36,7 @@ typedef struct avos_mr_handle {
 	const char *(*extractmetadata) (avos_mr_t *mr, uint32_t id);
 	int (*getframe)		(avos_mr_t *mr, int time_ms, avos_bgra_bitmap_t **pframe);
 	int (*getapic)		(avos_mr_t *mr, avos_apic_t **papic);
+	int (*getframes)	(avos_mr_t *mr, int count, int tile_width, int tile_height, int columns, avos_thumb_strip_t **pstrip);
 } avos_mr_handle_t;
 
 const avos_mr_handle_t *avos_mr_get_handle();
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Source/util.c"
+#include "../Source/cbe.c"
+
+void *stream_malloc_dma( size_t size )
+{
+	return malloc( size );
+}
+
+void stream_free_dma( UCHAR **ptr, size_t size )
+{
+	free( *ptr );
+	*ptr = NULL;
+}
+
+// feed NAL sized writes through the CBE the way the parsers do and
+// skip them like the decoder, with and without the mirrored buffer
+
+#define CBE_SIZE	(1024 * 1536 * 4)
+#define TOTAL		(2048LL * 1024 * 1024)
+
+static double _now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double _run( int mirror, const unsigned char *src, int max_write )
+{
+	cbe_use_mirror = mirror;
+	CBE *cbe = cbe_new( CBE_SIZE, CBE_SIZE, 0 );
+	if( !cbe ) {
+		printf("cannot alloc cbe\n");
+		exit( 1 );
+	}
+	if( cbe->mirror != mirror ) {
+		printf("mirror %d not available\n", mirror );
+	}
+
+	long long done = 0;
+	unsigned int seed = 42;
+	unsigned int sum = 0;
+	double start = _now();
+	while( done < TOTAL ) {
+		int size = 1 + rand_r( &seed ) % max_write;
+		cbe_write( cbe, src, size );
+		// touch the chunk contiguously like a decoder would
+		sum += cbe_get_p( cbe )[size - 1];
+		cbe_skip( cbe, size );
+		done += size;
+	}
+	double t = _now() - start;
+	cbe_delete( &cbe );
+
+	return done / t + ( sum & 0 );
+}
+
+int main( int argc, char *argv[] )
+{
+	int max_write = argc > 1 ? atoi( argv[1] ) : 256 * 1024;
+	unsigned char *src = malloc( max_write );
+	memset( src, 0x5A, max_write );
+
+	double copy   = _run( 0, src, max_write );
+	double mirror = _run( 1, src, max_write );
+
+	printf("cbe copy:   %8.1f MB/s\n", copy   / ( 1024 * 1024 ) );
+	printf("cbe mirror: %8.1f MB/s\n", mirror / ( 1024 * 1024 ) );
+	printf("speedup:    %8.2f\n", mirror / copy );
+
+	free( src );
+	return 0;
+}
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Source/x86_yuv.c"
+#include "../Source/downmix.c"
+
+const int Debug[DBG_MAX_ENTRIES];
+
+// run the downmix and the S16 conversion with and without the SSE2 kernels
+// and compare against the per sample code they replaced, the output has to be bit exact
+
+#define SAMPLES	1029	// more than a few blocks and not a multiple of the vector size
+
+// ******************************************
+//
+//	reference: downmix.c before the kernels
+//
+// ******************************************
+static void ref_downmix( uint16_t *pcm, uint8_t *src, int samples, int channels, int bits, int *map )
+{
+	if ( no_downmix || !pcm || !src || channels > 8 ) {
+		return;
+	}
+	
+	int shift = (bits == 32) ? 16 : (bits == 24 ) ? 8 : 0;
+	int i;
+	for( i = 0; i < samples; i ++ ) {
+		int32_t ch[9] = { 0 };
+		if( channels == 1 ) {
+			if( bits == 16 ) {
+				ch[map[0]] = getS16LE( src ); src += 2;
+			} else if( bits == 24 ) {
+				ch[map[0]] = getS24LE( src ); src += 3;
+			} else if( bits == 32 ) {
+				ch[map[0]] = getS32LE( src ); src += 4;
+			} 
+			*pcm++ = clamp( ch[CH_FL] >> shift );
+			*pcm++ = clamp( ch[CH_FL] >> shift );
+		} else {
+			int c;
+			for( c = 0; c < channels; c++ ) {
+				if( bits == 16 ) {
+					ch[map[c]] = getS16LE( src ); src += 2;
+				} else if( bits == 24 ) {
+					ch[map[c]] = getS24LE( src ); src += 3;
+				} else if( bits == 32 ) {
+					ch[map[c]] = getS32LE( src ); src += 4;
+				}
+			}
+			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) >> shift ); // left
+			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) >> shift ); // right
+		}
+	}
+}
+
+static void ref_downmix_planar( uint16_t *pcm, uint8_t *_src[], int samples, int channels, int bits, int *map )
+{
+	if ( no_downmix || !pcm || !_src || channels > 8 ) {
+		return;
+	}
+	
+	uint8_t *src[8];
+	int c;
+	for( c = 0; c < channels; c++ ) {
+		src[c] = _src[c];
+	}
+
+	int shift = (bits == 32) ? 16 : (bits == 24 ) ? 8 : 0;
+	int i;
+
+	for( i = 0; i < samples; i ++ ) {
+		int32_t ch[9] = { 0 };
+		if( channels == 1 ) {
+			if( bits == 16 ) {
+				ch[map[0]] = getS16LE( src[0] ); src[0] += 2;
+			} else if( bits == 24 ) {
+				ch[map[0]] = getS24LE( src[0] ); src[0] += 3;
+			} else if( bits == 32 ) {
+				ch[map[0]] = getS32LE( src[0] ); src[0] += 4;
+			} 
+			*pcm++ = clamp( ch[CH_FL] >> shift );
+			*pcm++ = clamp( ch[CH_FL] >> shift );
+		} else {
+			int c;
+			for( c = 0; c < channels; c++ ) {
+				if( bits == 16 ) {
+					ch[map[c]] = getS16LE( src[c] ); src[c] += 2;
+				} else if( bits == 24 ) {
+					ch[map[c]] = getS24LE( src[c] ); src[c] += 3;
+				} else if( bits == 32 ) {
+					ch[map[c]] = getS32LE( src[c] ); src[c] += 4;
+				}
+			}
+			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) >> shift ); // left
+			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) >> shift ); // right
+		}
+	}
+}
+
+static void ref_downmix_float( uint16_t *pcm, uint8_t *src, int samples, int channels, int bits, int *map )
+{
+	if ( no_downmix || !pcm || !src || channels > 8 ) {
+		return;
+	}
+	
+	int i;
+	for( i = 0; i < samples; i ++ ) {
+		int32_t ch[9] = { 0 };
+		if( channels == 1 ) {
+			if( bits == 32 ) {
+				ch[map[0]] = clamp( lrintf( *(float*)src * (1 << 15))); src += 4;
+			} else if ( bits == 64 ) {
+				ch[map[0]] = clamp( lrintf( *(double*)src * (1 << 15))); src += 8;
+			}
+			*pcm++ = clamp( ch[CH_FL] );
+			*pcm++ = clamp( ch[CH_FL] );
+		} else {
+			int c;
+			for( c = 0; c < channels; c++ ) {
+				if( bits == 32 ) {
+					ch[map[c]] = clamp( lrintf( *(float*)src * (1 << 15))); src += 4;
+				} else if( bits == 64 ) {
+					ch[map[c]] = clamp( lrintf( *(double*)src * (1 << 15))); src += 8;
+				}  
+			}
+			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) ); // left
+			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) ); // right
+		}
+	}
+}
+
+static void ref_downmix_float_planar( uint16_t *pcm, uint8_t *_src[], int samples, int channels, int bits, int *map )
+{
+	if ( no_downmix || !pcm || !_src || channels > 8 ) {
+		return;
+	}
+	
+	uint8_t *src[8];
+	int c;
+	for( c = 0; c < channels; c++ ) {
+		src[c] = _src[c];
+	}
+
+	int i;
+	for( i = 0; i < samples; i ++ ) {
+		int32_t ch[9] = { 0 };
+		if( channels == 1 ) {
+			if( bits == 32 ) {
+				ch[map[0]] = clamp( lrintf( *(float*)src[0] * (1 << 15))); src[0] += 4;
+			} else if ( bits == 64 ) {
+				ch[map[0]] = clamp( lrintf( *(double*)src[0] * (1 << 15))); src[0] += 8;
+			}
+			*pcm++ = clamp( ch[CH_FL] );
+			*pcm++ = clamp( ch[CH_FL] );
+		} else {
+			int c;
+			for( c = 0; c < channels; c++ ) {
+				if( bits == 32 ) {
+					ch[map[c]] = clamp( lrintf( *(float*)src[c] * (1 << 15))); src[c] += 4; 
+				} else if( bits == 64 ) {
+					ch[map[c]] = clamp( lrintf( *(double*)src[c] * (1 << 15))); src[c] += 8;
+				}  
+			}
+			*pcm++ = clamp( (ch[CH_FL] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BL] + ch[CH_SL]) ); // left
+			*pcm++ = clamp( (ch[CH_FR] + ch[CH_CTR] + ch[CH_SUB] + ch[CH_BR] + ch[CH_SR]) ); // right
+		}
+	}
+}
+
+// reference: convert_to_S16() and the loops of convert() in codec_ffmpeg_audio.c
+static int16_t ref_convert_to_S16( uint8_t *src, int bits, int shift, int fmt )
+{
+	int16_t res = 0;
+	int32_t resi = 0;
+	switch( fmt ) {
+		case PCM_FMT_FLT:
+			res = clamp(lrintf( *(float*)src * (1 << 15)));
+			break;
+		case PCM_FMT_DBL:
+			res = clamp(lrintf( *(double*)src * (1 << 15)));
+			break;
+		case PCM_FMT_U8:
+			res = get8(src);
+			break;
+		case PCM_FMT_S16:
+			res = getS16LE(src);
+			break;
+		case PCM_FMT_S32:
+			if( bits == 16 )
+				resi = getS16LE( src );
+			else if ( bits == 24 )
+				resi = getS24LE( src );
+			else if ( bits == 32 )
+				resi = getS32LE(src);
+			res = clamp( resi >> shift );
+			break;
+	}
+	return res;
+}
+
+static void ref_convert( int16_t *dest, int dst_channels, uint8_t *data[], int planar, int samples, int channels, int fmt, int bytes )
+{
+	int bits  = bytes * 8;
+	int shift = (bits == 32) ? 16 : (bits == 24 ) ? 8 : 0;
+	int i, j;
+	for( i = 0; i < samples; i++ ) {
+		for( j = 0; j < channels; j++ ) {
+			uint8_t *src = planar ? data[j] + i * bytes : data[0] + (i * channels + j) * bytes;
+			*dest++ = ref_convert_to_S16( src, bits, shift, fmt );
+		}
+		for( j = channels; j < dst_channels; j++ ) {
+			*dest++ = 0;
+		}
+	}
+}
+
+static void _rand_fill( uint8_t *p, int size, int fmt )
+{
+	int i;
+	if( fmt == PCM_FMT_FLT ) {
+		float *f = (float*)p;
+		for( i = 0; i < size / 4; i++ ) {
+			// mostly in range, some overshoot, some exact halves for the rounding
+			switch( rand() % 8 ) {
+			case 0:  f[i] = (float)((rand() % 65536) - 32768) / 32768.f + 0.5f / 32768.f; break;
+			case 1:  f[i] = ((float)rand() / RAND_MAX - 0.5f) * 8.f; break;
+			case 2:  f[i] = (rand() & 1) ? 1.f : -1.f; break;
+			default: f[i] = ((float)rand() / RAND_MAX - 0.5f) * 2.f; break;
+			}
+		}
+		// a few that lrintf() does not just round
+		f[7] = 1e10f; f[100] = -1e10f; f[333] = 0.f / 0.f;
+	} else if( fmt == PCM_FMT_DBL ) {
+		double *d = (double*)p;
+		for( i = 0; i < size / 8; i++ ) {
+			d[i] = ((double)rand() / RAND_MAX - 0.5) * 2.5;
+		}
+	} else {
+		for( i = 0; i < size; i++ ) {
+			p[i] = rand();
+		}
+	}
+}
+
+static int _compare( const char *name, int level, int channels, const void *ref, const void *out, int size )
+{
+	if( !memcmp( ref, out, size ) ) {
+		return 0;
+	}
+	const int16_t *r = ref, *o = out;
+	int i;
+	for( i = 0; i < size / 2 && r[i] == o[i]; i++ )
+		;
+	printf( "%-20s level %d  ch %d: mismatch at sample %d (%d != %d)\n", name, level, channels, i, o[i], r[i] );
+	return 1;
+}
+
+int main( int argc, char *argv[] )
+{
+	static const struct { int fmt, bits; const char *name; } fmts[] = {
+		{ PCM_FMT_U8,   8, "U8"  },
+		{ PCM_FMT_S16, 16, "S16" },
+		{ PCM_FMT_S24, 24, "S24" },
+		{ PCM_FMT_S32, 32, "S32" },
+		{ PCM_FMT_FLT, 32, "FLT" },
+		{ PCM_FMT_DBL, 64, "DBL" },
+	};
+	static int maps[3][8] = {
+		{ CH_FL, CH_FR, CH_CTR, CH_SUB, CH_BL, CH_BR, CH_SL, CH_SR },
+		{ CH_FR, CH_FL, CH_SUB, CH_CTR, CH_SR, CH_SL, CH_BR, CH_BL },
+		{ CH_FL, CH_FL, CH_UNMAPPED, CH_CTR, CH_BR, CH_BR, CH_SR, CH_CTR },	// doubles, the last one wins
+	};
+	int size = SAMPLES * 8 * 8;
+	uint8_t *inter = malloc( size );
+	uint8_t *plane[8];
+	int16_t *ref = malloc( SAMPLES * 8 * 2 );
+	int16_t *out = malloc( SAMPLES * 8 * 2 );
+	int errors = 0;
+	int top = x86_simd_level();
+	int f, c, m, i, level;
+
+	srand( 1 );
+	for( c = 0; c < 8; c++ ) {
+		plane[c] = malloc( SAMPLES * 8 );
+	}
+
+	for( level = X86_SIMD_NONE; level <= top; level++ ) {
+		simd_max = level;
+		for( f = 0; f < sizeof( fmts ) / sizeof( fmts[0] ); f++ ) {
+			int fmt  = fmts[f].fmt;
+			int bits = fmts[f].bits;
+			int flt  = fmt == PCM_FMT_FLT || fmt == PCM_FMT_DBL;
+			_rand_fill( inter, size, fmt );
+			for( c = 0; c < 8; c++ ) {
+				_rand_fill( plane[c], SAMPLES * 8, fmt );
+			}
+
+			for( c = 1; c <= 8; c++ ) {
+				for( m = 0; m < 3; m++ ) {
+					memset( ref, 0x55, SAMPLES * 4 );
+					memset( out, 0xaa, SAMPLES * 4 );
+					if( flt ) {
+						ref_downmix_float( (uint16_t*)ref, inter, SAMPLES, c, bits, maps[m] );
+						downmix_float( (uint16_t*)out, inter, SAMPLES, c, bits, maps[m] );
+					} else {
+						ref_downmix( (uint16_t*)ref, inter, SAMPLES, c, bits, maps[m] );
+						downmix( (uint16_t*)out, inter, SAMPLES, c, bits, maps[m] );
+					}
+					errors += _compare( fmts[f].name, level, c, ref, out, SAMPLES * 4 );
+
+					memset( ref, 0x55, SAMPLES * 4 );
+					memset( out, 0xaa, SAMPLES * 4 );
+					if( flt ) {
+						ref_downmix_float_planar( (uint16_t*)ref, plane, SAMPLES, c, bits, maps[m] );
+						downmix_float_planar( (uint16_t*)out, plane, SAMPLES, c, bits, maps[m] );
+					} else {
+						ref_downmix_planar( (uint16_t*)ref, plane, SAMPLES, c, bits, maps[m] );
+						downmix_planar( (uint16_t*)out, plane, SAMPLES, c, bits, maps[m] );
+					}
+					errors += _compare( fmts[f].name, level, c, ref, out, SAMPLES * 4 );
+				}
+
+				// S16 conversion, same channel count and upmixed to 8,
+				// only the formats lavc has
+				int d;
+				for( d = 0; d < 2 && fmt != PCM_FMT_S24; d++ ) {
+					int dst = d ? 8 : c;
+					for( i = 0; i < 2; i++ ) {
+						uint8_t *src[8] = { inter };
+						if( i ) {
+							memcpy( src, plane, sizeof( src ) );
+						}
+						memset( ref, 0x55, SAMPLES * dst * 2 );
+						memset( out, 0xaa, SAMPLES * dst * 2 );
+						ref_convert( ref, dst, src, i, SAMPLES, c, fmt, bits / 8 );
+						pcm_convert_S16( out, dst, src, i, SAMPLES, c, fmt );
+						errors += _compare( i ? "convert planar" : "convert", level, c, ref, out, SAMPLES * dst * 2 );
+					}
+				}
+			}
+		}
+		printf( "level %d done\n", level );
+	}
+
+	printf( "%s\n", errors ? "FAILED" : "OK" );
+	return errors ? 1 : 0;
+}
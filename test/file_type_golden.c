@@ -0,0 +1,263 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Source/util.c"
+#include "../Source/file_type.c"
+
+const int Debug[DBG_MAX_ENTRIES];
+
+// browse.c pulls in too much, the path lookups are not tested here
+const char *get_extension( const char *name_ext )
+{
+	const char *dot = strrchr( name_ext, '.' );
+	return dot ? dot + 1 : "";
+}
+
+// every extension and mime type of file_type[] in several spellings plus
+// random strings through the hashes and through the table scans they
+// replaced, the results have to be the same, then time both
+
+#define RANDOM	200000
+
+// ******************************************
+//
+//	reference: file_type.c before the hashes
+//
+// ******************************************
+static int ref_file_type_from_ext( const char *ext, int *_type, int *_etype, const char **_mime, int *_probe ) 
+{
+	if( !ext || *ext == '\0' )
+		return 1;
+		
+	int i;
+	for( i = 0; i < sizeof( file_type ) / sizeof( FILE_TYPE ); i++ ) {
+		if( !strcmpNC( ext, file_type[i].ext ) ) {
+			if( file_type[i].is_allowed && !file_type[i].is_allowed( file_type[i].type, file_type[i].etype ) ) {
+				continue;
+			}
+			if( _type )
+				*_type = file_type[i].type;
+			if( _etype )
+				*_etype = file_type[i].etype;
+			if( _mime ) {
+				if( file_type[i].mime_type && file_type[i].mime_type[0] )
+					*_mime = file_type[i].mime_type[0];
+				else
+					*_mime = "";
+			}
+			if( _probe )
+				*_probe = file_type[i].probe;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int ref_file_type_from_mime_type(const char *mime_type, int *type, int *etype)
+{
+	if (mime_type == NULL)
+		return 1;
+	
+	int i;
+	for( i = 0; i < sizeof( file_type ) / sizeof( FILE_TYPE ); i++ ) {
+		int j = 0;
+		while ( file_type[i].mime_type && file_type[i].mime_type[j] ) {
+			if ( !strcmp(mime_type, file_type[i].mime_type[j]) ) {
+				if ( type ) {
+					*type = file_type[i].type;
+				}
+				if ( etype ) {
+					*etype = file_type[i].etype;
+				}
+				return 0;
+			}
+			++j;
+		}
+	}
+	
+	if( type )
+		*type = TYPE_UNKNOWN;
+	if( etype )
+		*etype = ETYPE_NONE;
+	return 1;
+}
+
+static FILETYPE_REG* ref_filetype_get_reg( int type )
+{
+	FILETYPE_REG *p = _filetype_reg;
+	while( p ) {
+		if( type == p->type ) {
+			return p;
+		}
+		p = p->next;
+	}
+	return NULL;
+}
+
+// ******************************************
+//
+//	compare
+//
+// ******************************************
+static int _ext( const char *ext )
+{
+	int t[2] = { -1, -1 }, e[2] = { -1, -1 }, p[2] = { -1, -1 }, r[2];
+	const char *m[2] = { NULL, NULL };
+
+	r[0] = get_file_type_from_ext( ext, t, e, m, p );
+	r[1] = ref_file_type_from_ext( ext, t + 1, e + 1, m + 1, p + 1 );
+	if( r[0] != r[1] || t[0] != t[1] || e[0] != e[1] || m[0] != m[1] || p[0] != p[1] ) {
+		printf( "ext '%s': %d %d/%d %s %d != %d %d/%d %s %d\n", ext,
+			r[0], t[0], e[0], m[0] ? m[0] : "-", p[0], r[1], t[1], e[1], m[1] ? m[1] : "-", p[1] );
+		return 1;
+	}
+	return 0;
+}
+
+static int _mime( const char *mime )
+{
+	int t[2] = { -1, -1 }, e[2] = { -1, -1 }, r[2];
+
+	r[0] = get_file_type_from_mime_type( mime, t, e );
+	r[1] = ref_file_type_from_mime_type( mime, t + 1, e + 1 );
+	if( r[0] != r[1] || t[0] != t[1] || e[0] != e[1] ) {
+		printf( "mime '%s': %d %d/%d != %d %d/%d\n", mime, r[0], t[0], e[0], r[1], t[1], e[1] );
+		return 1;
+	}
+	return 0;
+}
+
+static void _random( char *s, int len, const char *chars )
+{
+	int n = strlen( chars );
+	while( len-- )
+		*s++ = chars[rand() % n];
+	*s = '\0';
+}
+
+static int _consistency( void )
+{
+	char buf[256];
+	int i, j, k, err = 0, checks = 0;
+
+	for( i = 0; i < FILE_TYPES; i++ ) {
+		const char *ext = file_type[i].ext;
+		err |= _ext( ext );
+		for( k = 0; ext[k]; k++ )
+			buf[k] = tolower( ext[k] );
+		buf[k] = '\0';
+		err |= _ext( buf );
+		buf[0] = toupper( buf[0] );
+		err |= _ext( buf );
+		strcpy( buf, ext );
+		strcat( buf, "X" );
+		err |= _ext( buf );
+		buf[strlen( ext ) - 1] = '\0';
+		err |= _ext( buf );
+		checks += 5;
+		for( j = 0; file_type[i].mime_type && file_type[i].mime_type[j]; j++ ) {
+			const char *mime = file_type[i].mime_type[j];
+			err |= _mime( mime );
+			for( k = 0; mime[k]; k++ )
+				buf[k] = toupper( mime[k] );
+			buf[k] = '\0';
+			err |= _mime( buf );
+			strcpy( buf, mime );
+			strcat( buf, ";" );
+			err |= _mime( buf );
+			checks += 3;
+		}
+	}
+	err |= _ext( "" ) | _ext( NULL ) | _mime( "" ) | _mime( NULL );
+
+	srand( 1 );
+	for( i = 0; i < RANDOM && !err; i++ ) {
+		_random( buf, 1 + rand() % 5, "aAbBcCdDeEfFgGhHiIjJkKlLmMnNoOpPqQrRsStTuUvVwWxXyYzZ0123456789-_" );
+		err |= _ext( buf );
+		_random( buf, 5 + rand() % 20, "abcdefghijklmnopqrstuvwxyz/-." );
+		err |= _mime( buf );
+		checks += 2;
+	}
+
+	// later registrations of a type lose, out of range types still work
+	static FILETYPE_REG regs[] = {
+		{ TYPE_VID, NULL, "vid",  NULL, NULL },
+		{ TYPE_AUD, NULL, "aud",  NULL, NULL },
+		{ TYPE_VID, NULL, "vid2", NULL, NULL },
+		{ TYPE_ANY + 1, NULL, "out",  NULL, NULL },
+		{ -1,       NULL, "neg",  NULL, NULL },
+	};
+	for( i = 0; i < sizeof( regs ) / sizeof( regs[0] ); i++ )
+		filetype_register( regs + i );
+	for( i = -2; i <= TYPE_ANY + 2; i++ ) {
+		if( filetype_get_reg( i ) != ref_filetype_get_reg( i ) ) {
+			printf( "reg %d differs\n", i );
+			err = 1;
+		}
+	}
+
+	if( !err )
+		printf( "%d lookups match, %d table entries\n", checks, (int)FILE_TYPES );
+	return err;
+}
+
+static double _now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// what a rescan does: mostly known extensions, some unknown ones
+static void _bench( void )
+{
+	static const char *exts[] = { "mkv", "MP4", "avi", "jpg", "Mp3", "srt", "txt", "nfo", "flac", "ts" };
+	int i, n = 2000000, sum = 0, t, e;
+
+	double t0 = _now();
+	for( i = 0; i < n; i++ )
+		sum += ref_file_type_from_ext( exts[i % 10], &t, &e, NULL, NULL ) + t;
+	double t1 = _now();
+	for( i = 0; i < n; i++ )
+		sum += get_file_type_from_ext( exts[i % 10], &t, &e, NULL, NULL ) + t;
+	double t2 = _now();
+	for( i = 0; i < n; i++ )
+		sum += ref_file_type_from_mime_type( "video/x-matroska", &t, &e );
+	double t3 = _now();
+	for( i = 0; i < n; i++ )
+		sum += get_file_type_from_mime_type( "video/x-matroska", &t, &e );
+	double t4 = _now();
+
+	printf( "ext: scan %6.1f ns  hash %6.1f ns, mime: scan %6.1f ns  hash %6.1f ns (%d)\n",
+		(t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n, (t3 - t2) * 1e9 / n, (t4 - t3) * 1e9 / n, sum & 1 );
+}
+
+int main( int argc, char *argv[] )
+{
+	if( _consistency() ) {
+		printf( "FAILED\n" );
+		return 1;
+	}
+	_bench();
+	printf( "OK\n" );
+	return 0;
+}
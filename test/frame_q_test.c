@@ -0,0 +1,340 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Source/util.c"
+#include "../Source/frame_q.c"
+
+// run random queue operations on FRAME_Q and on the list walking
+// implementation it replaced, results and queue contents have to match,
+// then time the calls the player thread makes per frame
+
+#define FRAMES	24
+#define QUEUES	3
+#define OPS	2000000
+
+// ******************************************
+//
+//	reference: frame_q.c before the tail pointer and count
+//
+// ******************************************
+typedef struct REF_Q {
+	char tag[16];
+	VIDEO_FRAME *head;
+} REF_Q;
+
+static int ref_frame_q_count( REF_Q *q )
+{
+	VIDEO_FRAME *frame = q->head;
+	
+	int count = 0;
+	while( frame ) {
+		count ++;
+		frame = frame->next;
+	}
+	return count;
+}
+
+static VIDEO_FRAME *ref_frame_q_get( REF_Q *q )
+{
+	VIDEO_FRAME *frame = q->head;
+	
+	if( frame ) {
+		q->head = frame->next;
+	}
+	
+	return frame;
+}
+
+static VIDEO_FRAME *ref_frame_q_get_unlocked( REF_Q *q )
+{
+	VIDEO_FRAME **prev = NULL;
+	VIDEO_FRAME *frame = q->head;
+	
+	while( frame ) {
+		if( !(frame->locked) ) {
+			if( prev )
+				*prev = frame->next;
+			else
+				q->head = frame->next;
+				
+			return frame;
+		}
+		prev = &frame->next;
+		frame = frame->next;
+	}
+	return NULL;
+}
+
+static VIDEO_FRAME *ref_frame_q_get_index( REF_Q *q, int index )
+{
+	VIDEO_FRAME **prev = NULL;
+	VIDEO_FRAME *frame = q->head;
+	
+	while( frame ) {
+		if( frame->index == index ) {
+			if( prev )
+				*prev = frame->next;
+			else
+				q->head = frame->next;
+				
+			return frame;
+		}
+		prev = &frame->next;
+		frame = frame->next;
+	}
+	return NULL;
+}
+
+static VIDEO_FRAME *ref_frame_q_peek( REF_Q *q )
+{
+	VIDEO_FRAME *frame = q->head;
+	
+	if( frame ) {
+	}
+	
+	return frame;
+}
+
+static int ref_frame_q_put( REF_Q *q, VIDEO_FRAME *frame )
+{
+	
+	if( !frame )
+		return 1;
+		
+	if( !q->head ) {
+		q->head = frame;
+		frame->next = NULL;
+		return 0;
+	}
+
+	VIDEO_FRAME *now = q->head;
+	
+	if( now == frame ) {
+		return 1;
+	}
+	while( now->next ) {
+		now = now->next;	
+		if( now == frame ) {
+			return 1;
+		}
+	}
+	now->next   = frame;
+	frame->next = NULL;
+	
+	return 0;
+}
+
+static void ref_frame_q_put_head( REF_Q *q, VIDEO_FRAME *frame )
+{
+	if( !frame )
+		return;
+		
+	if( !q->head ) {
+		q->head = frame;
+		frame->next = NULL;
+		return;
+	}
+
+	VIDEO_FRAME *now = q->head;
+	q->head = frame;
+	frame->next = now;
+}
+
+static void ref_frame_q_flush( REF_Q *q )
+{
+	q->head = NULL;
+}
+
+static double _now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int _index( VIDEO_FRAME *f )
+{
+	return f ? f->index : -1;
+}
+
+static int _check( FRAME_Q *q, REF_Q *r, int op )
+{
+	VIDEO_FRAME *f = q->head, *g = r->head, *last = NULL;
+	int n = 0;
+	while( f && g ) {
+		if( f->index != g->index ) {
+			printf( "op %d: [%s] order differs at %d: %d != %d\n", op, q->tag, n, f->index, g->index );
+			return 1;
+		}
+		last = f;
+		f = f->next;
+		g = g->next;
+		n++;
+	}
+	if( f || g ) {
+		printf( "op %d: [%s] length differs\n", op, q->tag );
+		return 1;
+	}
+	if( frame_q_count( q ) != n || ref_frame_q_count( r ) != n || q->tail != last ) {
+		printf( "op %d: [%s] count %d/%d tail %d, walked %d, last %d\n", op, q->tag,
+			frame_q_count( q ), ref_frame_q_count( r ), _index( q->tail ), n, _index( last ) );
+		return 1;
+	}
+	return 0;
+}
+
+static int _consistency( void )
+{
+	static VIDEO_FRAME nf[FRAMES], rf[FRAMES];
+	FRAME_Q q[QUEUES];
+	REF_Q   r[QUEUES];
+	int owner[FRAMES];
+	int i, k, op;
+
+	for( k = 0; k < QUEUES; k++ ) {
+		frame_q_init( q + k, "q" );
+		q[k].tag[1] = '0' + k;
+		memset( r + k, 0, sizeof( REF_Q ) );
+		strcpy( r[k].tag, q[k].tag );
+	}
+	for( i = 0; i < FRAMES; i++ ) {
+		nf[i].index = rf[i].index = i;
+		owner[i] = -1;
+	}
+
+	srand( 1 );
+	for( op = 0; op < OPS; op++ ) {
+		i = rand() % FRAMES;
+		k = rand() % QUEUES;
+		int ret = 0, ref = 0;
+		switch( rand() % 9 ) {
+		case 0:
+		case 1:
+			// a frame in another queue is a caller bug the old code did not catch either
+			if( owner[i] == -1 || owner[i] == k ) {
+				ret = frame_q_put( q + k, nf + i );
+				ref = ref_frame_q_put( r + k, rf + i );
+				owner[i] = k;
+			}
+			break;
+		case 2:
+			if( owner[i] == -1 ) {
+				frame_q_put_head( q + k, nf + i );
+				ref_frame_q_put_head( r + k, rf + i );
+				owner[i] = k;
+			}
+			break;
+		case 3: {
+			VIDEO_FRAME *f = frame_q_get( q + k ), *g = ref_frame_q_get( r + k );
+			ret = _index( f ); ref = _index( g );
+			if( f ) owner[f->index] = -1;
+			break;
+		}
+		case 4: {
+			VIDEO_FRAME *f = frame_q_get_unlocked( q + k ), *g = ref_frame_q_get_unlocked( r + k );
+			ret = _index( f ); ref = _index( g );
+			if( f ) owner[f->index] = -1;
+			break;
+		}
+		case 5: {
+			VIDEO_FRAME *f = frame_q_get_index( q + k, i ), *g = ref_frame_q_get_index( r + k, i );
+			ret = _index( f ); ref = _index( g );
+			if( f ) owner[f->index] = -1;
+			break;
+		}
+		case 6:
+			ret = _index( frame_q_peek( q + k ) );
+			ref = _index( ref_frame_q_peek( r + k ) );
+			break;
+		case 7:
+			nf[i].locked = rf[i].locked = !rf[i].locked;
+			break;
+		case 8:
+			if( rand() % 16 == 0 ) {
+				frame_q_flush( q + k );
+				ref_frame_q_flush( r + k );
+				for( i = 0; i < FRAMES; i++ ) {
+					if( owner[i] == k )
+						owner[i] = -1;
+				}
+			}
+			break;
+		}
+		if( ret != ref ) {
+			printf( "op %d: result %d != %d\n", op, ret, ref );
+			return 1;
+		}
+		for( k = 0; k < QUEUES; k++ ) {
+			if( _check( q + k, r + k, op ) )
+				return 1;
+		}
+	}
+	printf( "%d random operations match\n", OPS );
+	return 0;
+}
+
+// what the engine does per frame: a few counts, take one from the front, put one back
+static void _bench( int frames )
+{
+	VIDEO_FRAME *nf = calloc( frames, sizeof( VIDEO_FRAME ) );
+	VIDEO_FRAME *rf = calloc( frames, sizeof( VIDEO_FRAME ) );
+	FRAME_Q q;
+	REF_Q r = { "ref", NULL };
+	int i, n = 1000000, sum = 0;
+
+	frame_q_init( &q, "bench" );
+	for( i = 0; i < frames; i++ ) {
+		nf[i].index = rf[i].index = i;
+		frame_q_put( &q, nf + i );
+		ref_frame_q_put( &r, rf + i );
+	}
+
+	double t0 = _now();
+	for( i = 0; i < n; i++ ) {
+		sum += ref_frame_q_count( &r ) + ref_frame_q_count( &r ) + ref_frame_q_count( &r );
+		ref_frame_q_put( &r, ref_frame_q_get( &r ) );
+	}
+	double t1 = _now();
+	for( i = 0; i < n; i++ ) {
+		sum += frame_q_count( &q ) + frame_q_count( &q ) + frame_q_count( &q );
+		frame_q_put( &q, frame_q_get( &q ) );
+	}
+	double t2 = _now();
+
+	printf( "%3d frames: list walk %6.1f ns  constant %6.1f ns per frame (%d)\n",
+		frames, (t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n, sum & 1 );
+	free( nf );
+	free( rf );
+}
+
+int main( int argc, char *argv[] )
+{
+	if( _consistency() ) {
+		printf( "FAILED\n" );
+		return 1;
+	}
+	_bench( 4 );
+	_bench( 16 );
+	_bench( 32 );
+	printf( "OK\n" );
+	return 0;
+}
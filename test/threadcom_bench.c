@@ -0,0 +1,231 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "../Source/dataevent.c"
+#include "../Source/threadcom.c"
+
+const int Debug[DBG_MAX_ENTRIES];
+
+// producers post numbered events, a receiver thread services them through
+// data events like the mainloop does and checks that every producer's
+// events arrive complete and in order, on the ring and on the pipe it
+// replaced. the pipe splits length and payload into two writes, so it
+// only gets one producer.
+
+#define EVENTS	1000000
+#define MAX_PRODUCERS	4
+
+// ******************************************
+//
+//	reference: threadcom.c before the ring
+//
+// ******************************************
+typedef struct ref_link {
+	data_event_t		de;
+	int 			pipe[2];
+	void			(*event)(struct ref_link *link);
+} ref_link_t;
+
+static void ref_event_callback(void* context) 
+{
+	ref_link_t* link = context;
+	link->event(link);
+}
+
+static int ref_post_event(ref_link_t* link, const void* data, ssize_t len)
+{
+	if (write(link->pipe[1], &len, sizeof(len)) < 0)
+		return 1;
+	if (write(link->pipe[1], data, len) < 0)
+		return 1;
+	return 0;
+}
+
+static int ref_get_event(ref_link_t* link, void* data, ssize_t len)
+{
+	int ret;
+	size_t msg_len;
+	
+	fcntl(link->pipe[0], F_SETFL, fcntl(link->pipe[0], F_GETFL)|O_NONBLOCK);
+	ret = read(link->pipe[0], &msg_len, sizeof(msg_len));
+	fcntl(link->pipe[0], F_SETFL, fcntl(link->pipe[0], F_GETFL)& ~O_NONBLOCK);
+	if (ret < 0)
+		return 1;
+
+	if (len < msg_len) {
+		char tmp;
+		while (msg_len--)
+			read(link->pipe[0], &tmp, 1);
+		return 1;
+	}
+	
+	if (read(link->pipe[0], data, msg_len) < 0)
+		return 1;
+
+	return 0;
+}
+
+// ******************************************
+//
+//	both sides
+//
+// ******************************************
+typedef struct {
+	int	producer;
+	int	seq;
+	char	payload[200];
+} EVENT;
+
+static data_event_t events = {
+	.next = &events,
+	.prev = &events,
+	.fd = -1,
+};
+
+static threadcom_link_t	*ring;
+static ref_link_t	pipe_link;
+
+static int		producers;
+static int		size;		// bytes posted per event
+static int		received;
+static int		wakeups;
+static int		errors;
+static int		next_seq[MAX_PRODUCERS];
+
+static void _check( EVENT *e )
+{
+	if( e->producer < 0 || e->producer >= producers || e->seq != next_seq[e->producer] ) {
+		if( errors++ < 5 )
+			printf( "event %d: producer %d seq %d, expected %d\n", received, e->producer, e->seq,
+				e->producer >= 0 && e->producer < producers ? next_seq[e->producer] : -1 );
+	} else {
+		next_seq[e->producer]++;
+	}
+	received++;
+}
+
+static void _ring_event( threadcom_link_t *link )
+{
+	EVENT e;
+	wakeups++;
+	while( !threadcom_get_event( link, &e, sizeof( e ) ) )
+		_check( &e );
+}
+
+static void _pipe_event( ref_link_t *link )
+{
+	EVENT e;
+	wakeups++;
+	while( !ref_get_event( link, &e, sizeof( e ) ) )
+		_check( &e );
+}
+
+static void *_producer( void *arg )
+{
+	EVENT e;
+	int i, n = EVENTS / producers;
+
+	memset( &e, 0, sizeof( e ) );
+	e.producer = (intptr_t)arg;
+	for( i = 0; i < n; i++ ) {
+		e.seq = i;
+		if( ring )
+			threadcom_post_event( ring, &e, size );
+		else
+			ref_post_event( &pipe_link, &e, size );
+	}
+	return NULL;
+}
+
+static double _now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int _run( int use_ring, int nproducers, int nsize )
+{
+	pthread_t threads[MAX_PRODUCERS];
+	int i, total;
+
+	producers = nproducers;
+	size      = nsize;
+	received  = wakeups = errors = 0;
+	memset( next_seq, 0, sizeof( next_seq ) );
+	total = EVENTS / producers * producers;
+
+	if( use_ring ) {
+		ring = threadcom_create( _ring_event, &events );
+	} else {
+		ring = NULL;
+		memset( &pipe_link, 0, sizeof( pipe_link ) );
+		pipe( pipe_link.pipe );
+		pipe_link.de.fd = pipe_link.pipe[0];
+		pipe_link.de.read_func = ref_event_callback;
+		pipe_link.event = _pipe_event;
+		register_data_event( &events, &pipe_link.de, &pipe_link );
+	}
+
+	double t0 = _now();
+	for( i = 0; i < producers; i++ )
+		pthread_create( threads + i, NULL, _producer, (void*)(intptr_t)i );
+	while( received < total ) {
+		struct timeval tv = { 1, 0 };
+		service_data_events( &events, &tv );
+	}
+	double t1 = _now();
+	for( i = 0; i < producers; i++ )
+		pthread_join( threads[i], NULL );
+
+	if( use_ring ) {
+		threadcom_destroy( ring );
+		ring = NULL;
+	} else {
+		unregister_data_event( &pipe_link.de );
+		close( pipe_link.pipe[0] );
+		close( pipe_link.pipe[1] );
+	}
+
+	printf( "%s %d producer(s) %3d bytes: %6.2f M events/s, %8d wakeups, %.1f events per wakeup\n",
+		use_ring ? "ring" : "pipe", producers, size, total / (t1 - t0) / 1e6, wakeups, (double)total / wakeups );
+	if( errors )
+		printf( "%d events out of order\n", errors );
+	return errors;
+}
+
+int main( int argc, char *argv[] )
+{
+	int ret = 0;
+
+	ret |= _run( 0, 1, 16 );
+	ret |= _run( 1, 1, 16 );
+	ret |= _run( 0, 1, sizeof( EVENT ) );
+	ret |= _run( 1, 1, sizeof( EVENT ) );
+	ret |= _run( 1, MAX_PRODUCERS, 16 );
+	ret |= _run( 1, MAX_PRODUCERS, sizeof( EVENT ) );
+
+	printf( ret ? "FAILED\n" : "OK\n" );
+	return ret;
+}
@@ -0,0 +1,362 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+static int now_ms;
+
+int  atime( void )		{ return now_ms; }
+void mainloop_wakeup( void )	{ }
+
+#include "../Source/util.c"
+#include "../Source/timers.c"
+
+Timers gui_timers;
+
+// run random adds, removes and triggers with thousands of timers on the
+// heap and on the sorted list it replaced, callbacks have to fire in the
+// same order, then time adding, removing and re-arming
+
+#define TIMERS	4096
+#define TOKENS	6000
+#define OPS	100000
+
+// ******************************************
+//
+//	reference: timers.c before the heap
+//
+// ******************************************
+typedef struct RefTimer {
+	int id;
+	int timeout;
+	int interval;
+	void *ctx;
+	void (*callback_ctx)(void *ctx);
+	struct RefTimer *next;
+} RefTimer;
+
+typedef struct RefTimers {
+	RefTimer *data;
+	RefTimer dummy;
+	int size, cnt;
+} RefTimers;
+
+static void ref_init( RefTimers *obj )
+{
+	obj->dummy.id = -1;
+	obj->dummy.next = &obj->dummy;
+	obj->dummy.timeout = INT32_MAX;
+
+	int i;
+	for( i = 0; i < obj->size; i++ ) {
+		obj->data[i].id = -1;
+	}
+}
+
+static void ref_insert( RefTimers *obj, RefTimer *nt )
+{
+	RefTimer *before = &obj->dummy;
+	while( before->next->timeout < nt->timeout ) {
+		before = before->next;
+	}
+	nt->next = before->next;
+	before->next= nt;
+	obj->cnt++;
+}
+
+static void ref_remove_next( RefTimers *obj, RefTimer *before )
+{
+	before->next = before->next->next;
+	obj->cnt--;
+}
+
+static int ref_add( RefTimers *obj, void (*onTimeout)(void*), void *listener, int interval, int delay, TimerMode mode )
+{
+	static int id_counter = 1;
+
+	int res= -1;
+	if( obj->cnt < obj->size ) {
+		ULONG tm = atime();
+
+		RefTimer *nt = NULL;
+		int i;
+		for( i = 0; i < obj->size; i++ ) {
+			if( obj->data[i].id == -1 ) {
+				nt = obj->data + i;
+				break;
+			}
+		}
+
+		nt->id		    = id_counter++;
+		nt->timeout	    = tm + delay;
+		nt->interval	    = mode == TIMER_SINGLE ? -1 : interval;
+		nt->callback_ctx    = onTimeout;
+		nt->ctx		    = listener;
+		
+		ref_insert( obj, nt );
+
+		res = nt->id;
+	}
+	return res;
+}
+
+static void ref_remove( RefTimers *obj, int *id )
+{
+	if( !id || *id == -1 ) {
+		return;
+	}
+
+	RefTimer *before = &obj->dummy;
+	while( before->next->timeout < INT32_MAX ) {
+		if( before->next->id == *id ) {
+			before->next->id = -1;
+			ref_remove_next( obj, before );
+			break;
+		}
+		before = before->next;
+	}
+
+	*id = -1;
+}
+
+static void ref_trigger( RefTimers *obj )
+{
+	ULONG tm = atime();
+
+	RefTimer *before = &obj->dummy;
+
+	while( before->next->timeout <= tm ) {
+		RefTimer *first = before->next;
+
+		if( first->interval > 0 ) {
+			ref_remove_next( obj, before );
+			first->timeout = tm + first->interval;
+			ref_insert( obj, first );
+		} else {
+			before->next->id = -1;
+			ref_remove_next( obj, before );
+		}
+
+		if( first->callback_ctx )
+			first->callback_ctx( first->ctx );
+	}
+}
+
+static int ref_next_timeout( RefTimers *obj )
+{
+	return obj->cnt != 0 ? obj->dummy.next->timeout : 0;
+}
+
+// ******************************************
+//
+//	both sides
+//
+// ******************************************
+static Timers		heap;
+static RefTimers	list;
+static int		heap_id[TOKENS], list_id[TOKENS];
+
+static int		side;		// 0 heap, 1 list
+static int		*fired[2];
+static int		fired_num[2];
+
+static void _fired( void *ctx )
+{
+	int token = (intptr_t)ctx;
+
+	fired[side][fired_num[side]++] = token;
+
+	// callbacks remove other timers
+	if( token % 13 == 0 && token + 1 < TOKENS ) {
+		if( side )
+			ref_remove( &list, &list_id[token + 1] );
+		else
+			Timers_remove( &heap, &heap_id[token + 1] );
+	}
+}
+
+static void _empty( void *ctx )
+{
+}
+
+static double _now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _setup( int size )
+{
+	heap.data = calloc( size, sizeof( Timer ) );
+	heap.heap = calloc( size, sizeof( Timer* ) );
+	heap.size = size;
+	pthread_mutex_init( &heap.mutex, NULL );
+	Timers_init( &heap );
+
+	list.data = calloc( size, sizeof( RefTimer ) );
+	list.size = size;
+	list.cnt  = 0;
+	ref_init( &list );
+}
+
+static void _teardown( void )
+{
+	free( heap.data );
+	free( heap.heap );
+	free( list.data );
+	memset( &heap, 0, sizeof( heap ) );
+	memset( &list, 0, sizeof( list ) );
+}
+
+static int _consistency( void )
+{
+	int i, op, total = 0;
+
+	_setup( TIMERS );
+	for( i = 0; i < TOKENS; i++ )
+		heap_id[i] = list_id[i] = -1;
+	fired[0] = malloc( TIMERS * sizeof( int ) * 16 );
+	fired[1] = malloc( TIMERS * sizeof( int ) * 16 );
+
+	srand( 1 );
+	now_ms = 1000;
+	for( op = 0; op < OPS; op++ ) {
+		int token    = rand() % TOKENS;
+		int interval = 1 + rand() % 2000;
+		int delay    = rand() % 2000;
+		int a, b;
+
+		switch( rand() % 10 ) {
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+			Timers_remove( &heap, &heap_id[token] );
+			ref_remove( &list, &list_id[token] );
+			if( rand() % 2 ) {
+				TimerMode mode = rand() % 2 ? TIMER_SINGLE : TIMER_REPEATED;
+				heap_id[token] = __Timers_AddWithParam( &heap, _fired, (void*)(intptr_t)token, interval, mode, "stress" );
+				list_id[token] = ref_add( &list, _fired, (void*)(intptr_t)token, interval, interval, mode );
+			} else {
+				heap_id[token] = __Timers_DelayedAddWithParam( &heap, _fired, (void*)(intptr_t)token, interval, delay, "stress" );
+				list_id[token] = ref_add( &list, _fired, (void*)(intptr_t)token, interval, delay, TIMER_REPEATED );
+			}
+			if( ( heap_id[token] == -1 ) != ( list_id[token] == -1 ) ) {
+				printf( "op %d: add of %d failed on one side only\n", op, token );
+				return 1;
+			}
+			break;
+		case 4:
+		case 5:
+			Timers_remove( &heap, &heap_id[token] );
+			ref_remove( &list, &list_id[token] );
+			break;
+		default:
+			now_ms += rand() % 5;
+			fired_num[0] = fired_num[1] = 0;
+			side = 0;
+			Timers_trigger( &heap );
+			side = 1;
+			ref_trigger( &list );
+			if( fired_num[0] != fired_num[1] ) {
+				printf( "op %d: %d callbacks != %d\n", op, fired_num[0], fired_num[1] );
+				return 1;
+			}
+			for( i = 0; i < fired_num[0]; i++ ) {
+				if( fired[0][i] != fired[1][i] ) {
+					printf( "op %d: callback %d is %d != %d\n", op, i, fired[0][i], fired[1][i] );
+					return 1;
+				}
+			}
+			total += fired_num[0];
+			break;
+		}
+
+		a = Timers_nextTimeout( &heap );
+		b = ref_next_timeout( &list );
+		if( a != b || heap.cnt != list.cnt ) {
+			printf( "op %d: next timeout %d != %d, count %d != %d\n", op, a, b, heap.cnt, list.cnt );
+			return 1;
+		}
+	}
+	printf( "%d random operations match, %d callbacks, %d timers left\n", OPS, total, heap.cnt );
+	free( fired[0] );
+	free( fired[1] );
+	_teardown();
+	return 0;
+}
+
+// n periodic timers, then re-arm through trigger and add/remove one timer
+static void _bench( int n )
+{
+	int i, rounds = 2000, calls = 20000;
+	double t0, t1, t2, t3, t4;
+
+	_setup( n + 1 );
+	now_ms = 0;
+	srand( 2 );
+	for( i = 0; i < n; i++ ) {
+		int interval = 100 + rand() % 1000;
+		__Timers_AddWithParam( &heap, _empty, NULL, interval, TIMER_REPEATED, "bench" );
+		ref_add( &list, _empty, NULL, interval, interval, TIMER_REPEATED );
+	}
+
+	t0 = _now();
+	for( i = 0; i < rounds; i++ ) {
+		now_ms++;
+		ref_trigger( &list );
+	}
+	t1 = _now();
+	now_ms -= rounds;
+	for( i = 0; i < rounds; i++ ) {
+		now_ms++;
+		Timers_trigger( &heap );
+	}
+	t2 = _now();
+	for( i = 0; i < calls; i++ ) {
+		int id = ref_add( &list, _empty, NULL, 1 + i % 1000, 1 + i % 1000, TIMER_SINGLE );
+		ref_remove( &list, &id );
+	}
+	t3 = _now();
+	for( i = 0; i < calls; i++ ) {
+		int id = __Timers_AddWithParam( &heap, _empty, NULL, 1 + i % 1000, TIMER_SINGLE, "bench" );
+		Timers_remove( &heap, &id );
+	}
+	t4 = _now();
+
+	printf( "%5d timers: trigger list %7.1f us heap %6.1f us per ms, add+remove list %7.1f ns heap %6.1f ns\n",
+		n, (t1 - t0) * 1e6 / rounds, (t2 - t1) * 1e6 / rounds, (t3 - t2) * 1e9 / calls, (t4 - t3) * 1e9 / calls );
+	_teardown();
+}
+
+int main( int argc, char *argv[] )
+{
+	if( _consistency() ) {
+		printf( "FAILED\n" );
+		return 1;
+	}
+	_bench( 32 );
+	_bench( 1000 );
+	_bench( 5000 );
+	printf( "OK\n" );
+	return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2017 Archos SA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Source/x86_yuv.c"
+#include "../Source/codec_utils.c"
+#include "../Source/slice_pool.c"
+#include "../external/libdeinterlace/deinterlace.c"
+
+int time_update_time( void )
+{
+	return 0;
+}
+
+// run the pixel converters with the x86 kernels on every level
+// and compare against the scalar path, the output has to be bit exact,
+// then check that the sliced multi threaded conversion matches a single pass
+// and the fused deinterlace+convert matches deinterlacing the whole picture first
+
+#define W	1926	// not a multiple of the vector size, to get the scalar tails
+#define H	72	// leaves a short last stripe for the slice pool
+
+static unsigned char *_rand_plane( int size, int mask )
+{
+	// the deinterlacer reads a little past the last line
+	unsigned char *p = calloc( 1, size + 16 * W );
+	int i;
+	for( i = 0; i < size; i++ ) {
+		p[i] = rand() & mask;
+	}
+	return p;
+}
+
+static int _compare( const char *name, int level, unsigned char *ref, unsigned char *out, int size )
+{
+	if( !memcmp( ref, out, size ) ) {
+		return 0;
+	}
+	int i;
+	for( i = 0; i < size && ref[i] == out[i]; i++ )
+		;
+	printf( "%-20s level %d: mismatch at byte %d (%02X != %02X)\n", name, level, i, out[i], ref[i] );
+	return 1;
+}
+
+int main( int argc, char *argv[] )
+{
+	int errors = 0;
+	int top = x86_simd_level();
+	int level;
+
+	srand( 1 );
+
+	// 8 bit 420P, every U/V value pair shows up in the chroma planes
+	unsigned char *y8 = _rand_plane( W * H, 0xff );
+	unsigned char *u8 = _rand_plane( W / 2 * H / 2, 0xff );
+	unsigned char *v8 = _rand_plane( W / 2 * H / 2, 0xff );
+	unsigned char *uv = _rand_plane( W * H / 2, 0xff );
+	int i;
+	for( i = 0; i < W / 2 * H / 2 && i < 65536; i++ ) {
+		u8[i] = i & 0xff;
+		v8[i] = i >> 8;
+	}
+	for( i = 0; i < W * H / 2 && i < 2 * 65536; i += 2 ) {
+		uv[i]     = (i / 2) & 0xff;
+		uv[i + 1] = (i / 2) >> 8;
+	}
+
+	// 10 bit 420P
+	uint16_t *y10 = (uint16_t*)_rand_plane( W * H * 2, 0xff );
+	uint16_t *u10 = (uint16_t*)_rand_plane( W * H / 2, 0xff );
+	uint16_t *v10 = (uint16_t*)_rand_plane( W * H / 2, 0xff );
+	for( i = 0; i < W * H; i++ )
+		y10[i] &= 0x3ff;
+	for( i = 0; i < W * H / 4; i++ ) {
+		u10[i] &= 0x3ff;
+		v10[i] &= 0x3ff;
+	}
+
+	unsigned char *src420[3]  = { y8, u8, v8 };
+	int            line420[3] = { W, W / 2, W / 2 };
+	unsigned char *srcnv12[2]  = { y8, uv };
+	int            linenv12[2] = { W, W };
+	unsigned char *src10[3]  = { (unsigned char*)y10, (unsigned char*)u10, (unsigned char*)v10 };
+	int            line10[3] = { W * 2, W, W };
+
+	int rgb_size = W * H * 4;
+	int nv12_size = W * H * 3 / 2;
+	unsigned char *ref = calloc( 1, rgb_size );
+	unsigned char *out = calloc( 1, rgb_size );
+
+	for( level = X86_SIMD_SSE2; level <= top; level++ ) {
+		int cs;
+		for( cs = 0; cs < 2; cs++ ) {
+			int colorspace = cs ? AV_IMAGE_RGBX_32 : AV_IMAGE_BGRA_32;
+
+			use_x86_simd = 0;
+			convert_420P_to_RGB( colorspace, src420, line420, W, H, 0, ref, W, 0, NULL );
+			use_x86_simd = 1;
+			simd_max = level;
+			convert_420P_to_RGB( colorspace, src420, line420, W, H, 0, out, W, 0, NULL );
+			errors += _compare( cs ? "420P_to_RGBX32" : "420P_to_BGRA32", level, ref, out, rgb_size );
+
+			use_x86_simd = 0;
+			convert_NV12_to_RGB( colorspace, srcnv12, linenv12, W, H, 0, ref, W );
+			use_x86_simd = 1;
+			convert_NV12_to_RGB( colorspace, srcnv12, linenv12, W, H, 0, out, W );
+			errors += _compare( cs ? "NV12_to_RGBX32" : "NV12_to_BGRA32", level, ref, out, rgb_size );
+		}
+
+		use_x86_simd = 0;
+		convert_420P_to_NV12( src420, line420, W, H, 0, ref, W, ref + W * H, W );
+		use_x86_simd = 1;
+		convert_420P_to_NV12( src420, line420, W, H, 0, out, W, out + W * H, W );
+		errors += _compare( "420P_to_NV12", level, ref, out, nv12_size );
+
+		use_x86_simd = 0;
+		convert_420P10b_to_NV12( src10, line10, W, H, 0, ref, W, ref + W * H, W );
+		use_x86_simd = 1;
+		convert_420P10b_to_NV12( src10, line10, W, H, 0, out, W, out + W * H, W );
+		errors += _compare( "420P10b_to_NV12", level, ref, out, nv12_size );
+
+		printf( "level %d done\n", level );
+	}
+
+	VIDEO_FRAME fref, fout;
+	memset( &fref, 0, sizeof( fref ) );
+	memset( &fout, 0, sizeof( fout ) );
+	fref.colorspace  = fout.colorspace  = AV_IMAGE_NV12;
+	fref.linestep[0] = fout.linestep[0] = W;
+	fref.linestep[1] = fout.linestep[1] = W;
+	fref.data[0] = ref;
+	fref.data[1] = ref + W * H;
+	fout.data[0] = out;
+	fout.data[1] = out + W * H;
+
+	void *mt = codec_convert_mt_init( 4 );
+	for( i = 0; i < 100; i++ ) {
+		memset( out, 0, nv12_size );
+		codec_convert_pixel_format( PIXFMT_YUV420P10LE, src10, line10, W, H, &fref );
+		codec_convert_mt( mt, PIXFMT_YUV420P10LE, src10, line10, W, H, &fout );
+		if( _compare( "convert_mt", 0, ref, out, nv12_size ) ) {
+			errors++;
+			break;
+		}
+	}
+	codec_convert_mt_exit( mt );
+	printf( "convert_mt done\n" );
+
+	// deinterlace: whole picture into planes, then convert
+	unsigned char *dy = malloc( W * H );
+	unsigned char *du = malloc( W / 2 * H / 2 );
+	unsigned char *dv = malloc( W / 2 * H / 2 );
+	unsigned char *deint[3] = { dy, du, dv };
+	int            deint_line[3] = { W, W / 2, W / 2 };
+	RenderX( dy, y8, W, H, W, W );
+	RenderX( du, u8, W / 2, H / 2, W / 2, W / 2 );
+	RenderX( dv, v8, W / 2, H / 2, W / 2, W / 2 );
+
+	CODEC_SCRATCH scratch = { 0 };
+	memset( ref, 0, rgb_size );
+	memset( out, 0, rgb_size );
+	convert_420P_to_RGB( AV_IMAGE_BGRA_32, deint, deint_line, W, H, 0, ref, W, 0, NULL );
+	convert_420P_to_RGB( AV_IMAGE_BGRA_32, src420, line420, W, H, 0, out, W, 1, &scratch );
+	errors += _compare( "deint_420P_to_BGRA32", 0, ref, out, rgb_size );
+	memset( out, 0, rgb_size );
+	convert_420P_to_RGB( AV_IMAGE_BGRA_32, src420, line420, W, H, 0, out, W, 1, NULL );
+	errors += _compare( "deint_420P_to_BGRA32", 0, ref, out, rgb_size );
+	codec_scratch_free( &scratch );
+
+	unsigned char *yv12_ref[3] = { ref, ref + W * H, ref + W * H * 5 / 4 };
+	unsigned char *yv12_out[3] = { out, out + W * H, out + W * H * 5 / 4 };
+	int            yv12_line[3] = { W, W / 2, W / 2 };
+	convert_420P_to_YV12( deint, deint_line, W, H, 0, yv12_ref, yv12_line, 0 );
+	convert_420P_to_YV12( src420, line420, W, H, 0, yv12_out, yv12_line, 1 );
+	errors += _compare( "deint_420P_to_YV12", 0, ref, out, W * H * 3 / 2 );
+	printf( "deinterlace done\n" );
+
+	printf( "%s\n", errors ? "FAILED" : "OK" );
+	return errors ? 1 : 0;
+}